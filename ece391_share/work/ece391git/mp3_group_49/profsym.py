@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+"""
+Flat profiles from the output of the prof program.
+
+prof prints one line per sampled address,
+    prof <count> <pid> <u|k> <eip in hex>
+and a summary line naming the pid of the profiled command.  Save the
+console output to a file and run, from this directory:
+
+    ./profsym.py -k student-distrib/bootimg -u syscalls/cat.exe log.txt
+
+Kernel samples are looked up in the kernel image, user samples of the
+profiled command in the -u program (syscalls/ keeps the linked .exe
+files around for this).  User samples of other processes are only
+counted per pid.
+"""
+
+import argparse
+import bisect
+import subprocess
+import sys
+
+
+def load_symbols(elf):
+    """Sorted (address, name) of the text symbols of an ELF file."""
+    out = subprocess.run(["nm", "-n", "--defined-only", elf],
+                         check=True, capture_output=True, text=True).stdout
+    syms = []
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) == 3 and parts[1] in "tTwW":
+            syms.append((int(parts[0], 16), parts[2]))
+    return syms
+
+
+def lookup(syms, addrs, eip):
+    """Name of the function holding eip, or the raw address."""
+    i = bisect.bisect_right(addrs, eip) - 1
+    if i < 0:
+        return "0x%x" % eip
+    return syms[i][1]
+
+
+def parse(log):
+    """Sample lines as (count, pid, user, eip), and the command's pid."""
+    hits = []
+    command_pid = None
+    for line in log:
+        parts = line.split()
+        if len(parts) < 2 or parts[0] != "prof":
+            continue
+        if parts[1] == "total":
+            if "pid" in parts:
+                command_pid = int(parts[parts.index("pid") + 1])
+            continue
+        count, pid, mode, eip = parts[1:5]
+        hits.append((int(count), int(pid), mode == "u", int(eip, 16)))
+    return hits, command_pid
+
+
+def report(title, totals, all_samples):
+    """Print one flat profile, busiest function first."""
+    samples = sum(totals.values())
+    if not samples:
+        return
+    print("%s: %d samples, %.1f%% of all" % (title, samples, 100.0 * samples / all_samples))
+    print("     %   samples  function")
+    for name, count in sorted(totals.items(), key=lambda kv: (-kv[1], kv[0])):
+        print("%6.2f %9d  %s" % (100.0 * count / samples, count, name))
+    print()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("-k", "--kernel", default="student-distrib/bootimg",
+                        help="kernel image with symbols")
+    parser.add_argument("-u", "--user", help="ELF of the profiled command")
+    parser.add_argument("log", nargs="?", type=argparse.FileType("r"), default=sys.stdin,
+                        help="console output of prof (default stdin)")
+    args = parser.parse_args()
+
+    hits, command_pid = parse(args.log)
+    if not hits:
+        sys.exit("no prof lines found")
+
+    ksyms = load_symbols(args.kernel)
+    kaddrs = [a for a, _ in ksyms]
+    usyms = load_symbols(args.user) if args.user else []
+    uaddrs = [a for a, _ in usyms]
+
+    kernel, user, other = {}, {}, {}
+    for count, pid, is_user, eip in hits:
+        if not is_user:
+            name = lookup(ksyms, kaddrs, eip)
+            if pid == 0:
+                name += " [idle]"
+            kernel[name] = kernel.get(name, 0) + count
+        elif pid == command_pid and usyms:
+            name = lookup(usyms, uaddrs, eip)
+            user[name] = user.get(name, 0) + count
+        else:
+            name = "pid %d" % pid
+            other[name] = other.get(name, 0) + count
+
+    all_samples = sum(count for count, _, _, _ in hits)
+    report("kernel", kernel, all_samples)
+    report("user, pid %s" % command_pid, user, all_samples)
+    report("user, other processes", other, all_samples)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,155 @@
+#include "clocksource.h"
+#include "lib.h"
+#include "timepage.h"
+
+#include "drivers/pit.h"
+#include "interrupts/apic.h"
+#include "interrupts/interrupts.h"
+#include "syscall/sched.h"
+
+#define LOW_BYTE            0xFF
+#define HIGH_SHIFT          8
+
+#define NSEC_PER_MSEC       (NSEC_PER_SEC / MSEC_PER_SEC)
+
+/* PIT counts in the calibration window */
+#define CALIBRATE_LATCH     (PIT_BASE_FREQ / (MSEC_PER_SEC / CALIBRATE_MS))
+
+/* give up on channel 2 after this many polls, about 10 times the window */
+#define CALIBRATE_POLLS     100000
+
+uint32_t tsc_khz = 0;
+
+/* TSC at calibration, the zero of CLOCK_MONOTONIC */
+static uint64_t tsc_base;
+
+/* APIC timer counts per tick, 0 without a usable APIC */
+static uint32_t lapic_per_tick = 0;
+
+/*
+ * init_clocksource
+ * DESCRIPTION: time CALIBRATE_MS of PIT channel 2 with the TSC and,
+ *              if there is one, the local APIC timer
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: sets tsc_khz; call after init_paging and before
+ *               init_time_page, which publishes tsc_khz
+ */
+void init_clocksource()
+{
+    int32_t have_lapic = (init_lapic() == FSUCCESS);
+    uint32_t flags;
+    uint32_t polls;
+    uint32_t lapic_counts = 0;
+    uint64_t start, end;
+
+    cli_and_save(flags);
+
+    /* gate channel 2 on with the speaker off, then load the one-shot */
+    outb((inb(PIT_GATE_PORT) & ~PIT_SPEAKER) | PIT_GATE2, PIT_GATE_PORT);
+    outb(PIT_MODE_ONESHOT2, PIT_COMMAND);
+    outb(CALIBRATE_LATCH & LOW_BYTE, PIT_CHANNEL2);
+    outb((CALIBRATE_LATCH >> HIGH_SHIFT) & LOW_BYTE, PIT_CHANNEL2);
+
+    if (have_lapic)
+        lapic_timer_count_start();
+    start = rdtsc();
+
+    /* OUT2 goes high once the count runs out */
+    for (polls = 0; polls < CALIBRATE_POLLS; polls++) {
+        if (inb(PIT_GATE_PORT) & PIT_OUT2)
+            break;
+    }
+
+    end = rdtsc();
+    if (have_lapic)
+        lapic_counts = lapic_timer_count_elapsed();
+
+    restore_flags(flags);
+
+    tsc_base = end;
+    if (polls == CALIBRATE_POLLS) {
+        printf("clocksource: PIT channel 2 never expired, no TSC clock\n");
+        return;
+    }
+
+    /* the window is at most a few hundred million cycles, 32 bits do */
+    tsc_khz = (uint32_t)(end - start) / CALIBRATE_MS;
+    lapic_per_tick = lapic_counts / (CALIBRATE_MS * HZ / MSEC_PER_SEC);
+    printf("clocksource: TSC %d kHz, APIC timer %d per tick\n", tsc_khz, lapic_per_tick);
+}
+
+/*
+ * lapic_tick
+ * DESCRIPTION: the tick when the APIC timer drives it, same as handle_pit
+ * INPUTS: irq -- LAPIC_TIMER_IRQ
+ *         dev -- not used
+ * OUTPUTS: none
+ * RETURN VALUE: IRQ_HANDLED
+ * SIDE EFFECTS: advances jiffies and charges the running task's slice
+ */
+static int32_t lapic_tick(uint32_t irq, void* dev)
+{
+    timer_tick();
+    sched_tick();
+    return IRQ_HANDLED;
+}
+
+/*
+ * start_tick
+ * DESCRIPTION: start the HZ tick, on the APIC timer if calibration
+ *              found one and on the PIT otherwise
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: call after init_timers and init_time_page
+ */
+void start_tick()
+{
+    if (lapic_per_tick && request_irq(LAPIC_TIMER_IRQ, lapic_tick, NULL) == FSUCCESS) {
+        lapic_timer_periodic(lapic_per_tick);
+        return;
+    }
+
+    init_pit();
+}
+
+/*
+ * clock_read
+ * DESCRIPTION: read the time with TSC resolution
+ * INPUTS: clock -- CLOCK_MONOTONIC or CLOCK_REALTIME
+ * OUTPUTS: ts -- the time
+ * RETURN VALUE: 0 on success, -1 on an unknown clock
+ * SIDE EFFECTS: falls back to tick resolution if there is no TSC rate
+ */
+int32_t clock_read(int32_t clock, timespec_t* ts)
+{
+    uint64_t count;
+    uint64_t part;
+    uint32_t cycles_left, msec_left;
+
+    if (clock != CLOCK_MONOTONIC && clock != CLOCK_REALTIME)
+        return FFAIL;
+
+    if (tsc_khz) {
+        /* cycles -> whole ms and the cycles left over */
+        count = rdtsc() - tsc_base;
+        cycles_left = div64_32(&count, tsc_khz);
+        /* ms -> seconds and the ms left over */
+        msec_left = div64_32(&count, MSEC_PER_SEC);
+
+        part = (uint64_t)cycles_left * NSEC_PER_MSEC;
+        (void)div64_32(&part, tsc_khz);
+
+        ts->tv_sec = (uint32_t)count;
+        ts->tv_nsec = msec_left * NSEC_PER_MSEC + (uint32_t)part;
+    } else {
+        ticks_to_timespec(jiffies, ts);
+    }
+
+    if (clock == CLOCK_REALTIME)
+        ts->tv_sec += time_page->wall_sec;
+
+    return FSUCCESS;
+}
@@ -0,0 +1,43 @@
+/*
+ * Clock sources: the TSC for reading the time, the local APIC timer
+ * for the tick
+ *
+ * At boot the TSC rate, and the APIC timer rate if there is one, are
+ * measured against PIT channel 2, which counts a fixed 1.193182MHz
+ * crystal and needs no interrupt.  From then on the TSC gives time
+ * since boot in nanoseconds; clock_read turns cycles into a timespec
+ * with 32 bit divides only, there is no libgcc for 64 bit ones.  The
+ * tick runs off the APIC timer when the cpu has one and off PIT
+ * channel 0 otherwise.
+ *
+ * References Used:
+ *      Linux arch/x86/kernel/tsc.c (pit_calibrate_tsc)
+ *      https://wiki.osdev.org/APIC_timer
+ */
+
+#ifndef CLOCKSOURCE_H
+#define CLOCKSOURCE_H
+
+#include "types.h"
+#include "timer.h"
+
+/* clocks for clock_read */
+#define CLOCK_REALTIME      0       /* seconds since 1970 */
+#define CLOCK_MONOTONIC     1       /* time since boot */
+
+/* length of the calibration window */
+#define CALIBRATE_MS        10
+
+/* TSC cycles per millisecond, 0 if calibration failed */
+extern uint32_t tsc_khz;
+
+/* measure the TSC and APIC timer against the PIT; interrupts may be on */
+void init_clocksource(void);
+
+/* start the HZ tick on the best timer there is */
+void start_tick(void);
+
+/* read a clock with TSC resolution, -1 on an unknown clock */
+int32_t clock_read(int32_t clock, timespec_t* ts);
+
+#endif /* CLOCKSOURCE_H */
@@ -1,19 +1,28 @@
 #include "keyboard.h"
 
 #include <lib.h>
-#include <interrupts/i8259.h>
+#include <interrupts/interrupts.h>
+#include <interrupts/tasklet.h>
+#include <syscall/sched.h>
 
 /* KEYBOARD FUNCTIONS */
 
-static int is_extended = 0;     /*  */
-static int is_released = 0;     /* key up */
-static int is_lcontrol = 0;     /* ctrl key check */
-static int is_lshift = 0;       /* shift key checks */
-static int is_rshift = 0;
-static int is_caps = 0;         /* caps lock check */
+static int is_extended = 0;     /* last scancode was EXTENDED_CODE */
+static uint16_t modifiers = 0;  /* KEY_* modifier bits held right now */
 
-static int8_t last_key;
-static volatile int data_available = 0;
+/*
+ * events from handle_keyboard to the readers; head only moves in the
+ * interrupt handler, tail only in readers, so no lock is needed
+ */
+static key_event_t key_ring[KEY_RING_SIZE];
+static volatile uint32_t key_head = 0;   /* next slot to fill */
+static volatile uint32_t key_tail = 0;   /* next slot to read */
+
+static volatile int32_t key_bh_pending = 0;  /* keyboard_bottom_half queued */
+static volatile int32_t clear_pending = 0;   /* CTRL + L seen */
+static volatile int32_t view_pending = 0;    /* scrollback lines paged, not applied yet */
+static volatile int32_t live_pending = 0;    /* a key typed, go back to the live screen */
+static wait_queue_t key_wq;              /* tasks waiting for a key */
 
 // The normal letters numbers and punctuation symbols in scan set 1
 static const char normal_map[] = {
@@ -46,121 +55,202 @@ static const char shift_map[] = {
 };
 
 
+/* key_to_ascii
+ * Inputs: code - make code, release bit stripped
+ * Outputs: none
+ * Return Value: the character the key types with the current
+ *               modifiers, 0 if it types none
+ * Function: applies shift and caps lock to the scan set 1 maps
+ */
+static int8_t key_to_ascii(uint8_t code) {
+    int8_t c;
+
+    if (code >= sizeof(normal_map))
+        return 0;
+
+    c = normal_map[code];
+    if (is_extended || !c)
+        return 0;
+
+    if ((modifiers & KEY_CAPS) && c >= 'a' && c <= 'z') {
+        /* caps and shift = default, caps and no shift = capitalize */
+        if (!(modifiers & (KEY_LSHIFT | KEY_RSHIFT)))
+            c -= 'a' - 'A';
+    } else if (modifiers & (KEY_LSHIFT | KEY_RSHIFT)) {
+        c = shift_map[code];
+    }
+    return c;
+}
+
 /* handle_keyboard
- * Inputs: None
+ * Inputs: irq - KBD_IRQ
+ *         dev - not used
  * Outputs: none
- * Return Value: 0 on success
- * Function: reads input from keyboard and interprets values baseed on toggle keys
+ * Return Value: IRQ_HANDLED
+ * Function: top half; decodes the scancode into a key event right
+ *           away and appends it to the ring, dropping it if the ring
+ *           is full.  Waking readers is left to keyboard_bottom_half
  */
-void handle_keyboard() {
+int32_t handle_keyboard(uint32_t irq, void* dev) {
     unsigned char scancode;
+    key_event_t* ev;
+    uint8_t code;
+    int released;
 
     /* receive keyboard activity */
     scancode = inb(DATA);
-    send_eoi(KBD_IRQ);
 
-    /* determine activity type */
-    if (scancode & RELEASE_CODE) {
-        is_released = 1;    // don't return since there isn't a second code
-    } else if (scancode == EXTENDED_CODE) {
+    if (scancode == EXTENDED_CODE) {
         is_extended = 1;
-        return;
+        return IRQ_HANDLED;
     }
+    code = scancode & ~RELEASE_CODE;
+    released = scancode & RELEASE_CODE;
 
-    /* key up event for special keys */
-    if (is_released) {
-        switch (scancode ^ RELEASE_CODE) {
+    /* track the modifiers, extended codes are the right hand copies and arrows */
+    if (!is_extended) {
+        switch (code) {
             case LCTRL:
-                is_lcontrol = 0;
+                modifiers = released ? modifiers & ~KEY_LCTRL : modifiers | KEY_LCTRL;
                 break;
             case LSHIFT:
-                is_lshift = 0;
+                modifiers = released ? modifiers & ~KEY_LSHIFT : modifiers | KEY_LSHIFT;
                 break;
             case RSHIFT:
-                is_rshift = 0;
+                modifiers = released ? modifiers & ~KEY_RSHIFT : modifiers | KEY_RSHIFT;
+                break;
+            case CAPS:
+                if (!released)
+                    modifiers ^= KEY_CAPS;
                 break;
         }
-        is_released = 0;
-        return;
     }
 
-    if (is_extended) {
-        is_extended = 0;
-        return;
+    /* SHIFT + PAGE UP / DOWN page through the scrollback, readers never see them */
+    if (is_extended && (code == PAGE_UP || code == PAGE_DOWN) &&
+        (modifiers & (KEY_LSHIFT | KEY_RSHIFT))) {
+        if (!released)
+            view_pending += (code == PAGE_UP) ? SCROLLBACK_LINES : -SCROLLBACK_LINES;
+    } else if (key_head - key_tail < KEY_RING_SIZE) {
+        ev = &key_ring[key_head & KEY_RING_MASK];
+        ev->tsc = rdtsc();
+        ev->scancode = code;
+        ev->ascii = key_to_ascii(code);
+        ev->flags = modifiers;
+        if (released)
+            ev->flags |= KEY_RELEASE;
+        if (is_extended)
+            ev->flags |= KEY_EXTENDED;
+
+        /* CTRL + L clears the screen, too slow for the top half */
+        if (!released && (modifiers & KEY_LCTRL) && ev->ascii == 'l')
+            clear_pending = 1;
+        /* typing snaps the screen back from the scrollback */
+        if (!released && ev->ascii)
+            live_pending = 1;
+
+        barrier();
+        key_head++;
     }
+    is_extended = 0;
 
-    if (!is_extended && !is_released) {
-        if  (normal_map[scancode]) {
-            if (is_lcontrol){
-                /* CTRL + L clears the screen */
-                if (normal_map[scancode] == 'l') {
-                    int x = get_cursor_x();
-                    int y = get_cursor_y();
-                    for (; y > 0; y--) {
-                        scroll_one_unit_down();
-                    }
-                    set_cursor_position(x, 0);
-                }
-            } else {
-                if (is_caps && (normal_map[scancode] >= 'a' && normal_map[scancode] <= 'z')){
-                    /* capitalize chars */
-                    if (is_lshift || is_rshift){
-                        /* caps and shift = default */
-                        last_key = normal_map[scancode];
-                    }else{
-                        /* caps and no shift = capitalize */
-                        last_key = normal_map[scancode]-('a'-'A');
-                    }
-                }else if (is_lshift || is_rshift){
-                    /* just shift */
-                    last_key = shift_map[scancode];
-                }else{
-                    last_key = normal_map[scancode];
-                }
-                data_available = 1;
-            }
-        }
-        else {
-            /* key down event for special keys */
-            switch (scancode) {
-                case LCTRL:
-                    is_lcontrol = 1;
-                    break;
-                case LSHIFT:
-                    is_lshift = 1;
-                    break;
-                case RSHIFT:
-                    is_rshift = 1;
-                    break;
-                case CAPS:
-                    is_caps = !is_caps;
-                    break;
-            }
+    if (!key_bh_pending) {
+        key_bh_pending = 1;
+        if (tasklet_schedule(keyboard_bottom_half, 0))
+            key_bh_pending = 0;
+    }
+    return IRQ_HANDLED;
+}
+
+/* keyboard_bottom_half
+ * Inputs: data - not used
+ * Outputs: none
+ * Return Value: none
+ * Function: wakes up readers of the key ring, clears the screen
+ *           for CTRL + L and moves the scrollback view, runs with
+ *           interrupts enabled
+ */
+void keyboard_bottom_half(uint32_t data) {
+    uint32_t flags;
+    int32_t lines;
+
+    key_bh_pending = 0;
+
+    cli_and_save(flags);
+    lines = live_pending ? CONSOLE_VIEW_LIVE : view_pending;
+    view_pending = 0;
+    live_pending = 0;
+    restore_flags(flags);
+    if (lines)
+        console_scroll_view(lines);
+
+    if (clear_pending) {
+        int x = get_cursor_x();
+        int y = get_cursor_y();
+
+        clear_pending = 0;
+        for (; y > 0; y--) {
+            scroll_one_unit_down();
         }
+        set_cursor_position(x, 0);
     }
+
+    wake_up(&key_wq);
+}
+
+/* keyboard_read_events
+ * Inputs: n - room in buf, in events
+ *         nonblock - return 0 right away instead of waiting
+ * Outputs: buf - the oldest events, in order
+ * Return Value: number of events taken out of the ring
+ * Side effects: sleeps until there is at least one event unless
+ *               nonblock is set
+ * Function: drains up to n key events in one go
+ */
+int32_t keyboard_read_events(key_event_t* buf, int32_t n, int32_t nonblock) {
+    int32_t count = 0;
+
+    if (!nonblock) {
+        /* about to block, put the prompt and echo on the screen first */
+        if (key_head == key_tail)
+            console_flush();
+        wait_event(&key_wq, key_head != key_tail);
+    }
+
+    while (count < n && key_tail != key_head) {
+        buf[count++] = key_ring[key_tail & KEY_RING_MASK];
+        barrier();
+        key_tail++;
+    }
+    return count;
 }
 
 /* keyboard_get_key
- * Inputs: None
+ * Inputs: nonblock - return 0 instead of waiting for a key
  * Outputs: none
- * Return Value: the last key inputted
- * Side effects: waits for a key to be pressed
- * Function: returns the last key that was pressed
+ * Return Value: the next character typed, 0 if nonblock is set and
+ *               none has been typed
+ * Side effects: sleeps until a key is pressed unless nonblock; events
+ *               that type no character (releases, modifiers, CTRL
+ *               combinations) are consumed and skipped
+ * Function: returns the next key press that types a character
  */
-int8_t keyboard_get_key() {
-    /* wait for key press */
-    while (!data_available);
-    /* clear flag and return */
-    data_available = 0;
-    return last_key;
+int8_t keyboard_get_key(int32_t nonblock) {
+    key_event_t ev;
+
+    while (keyboard_read_events(&ev, 1, nonblock)) {
+        if (ev.ascii && !(ev.flags & (KEY_RELEASE | KEY_LCTRL)))
+            return ev.ascii;
+    }
+    return 0;
 }
 
 /* init_keyboard
  * Inputs: None
  * Outputs: none
  * Return Value: void
- * Function: enables the interrupt request for keyboard
+ * Function: hooks handle_keyboard up to the keyboard's IRQ line
  */
 void init_keyboard() {
-    enable_irq(KBD_IRQ);
+    (void)request_irq(KBD_IRQ, handle_keyboard, NULL);
 }
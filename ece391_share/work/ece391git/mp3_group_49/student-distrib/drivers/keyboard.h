@@ -1,6 +1,13 @@
 /*
  * Functions for processing user input
  * from the keyboard
+ *
+ * The interrupt handler turns every scancode into a key event, with
+ * the modifiers held at the time and a TSC timestamp, and appends it
+ * to a ring that readers drain, so keys typed (or pasted) faster than
+ * they are read are kept instead of overwriting each other.
+ * SHIFT + PAGE UP / DOWN are taken out before they reach the ring and
+ * page the console through its scrollback.
  */
 
 #ifndef KEYBOARD_H
@@ -8,12 +15,36 @@
 
 #include <types.h>
 
-/* reads and interprets keyboard input based on scan set */
-void handle_keyboard(void);
+/* key events kept until read, must be a power of 2 */
+#define KEY_RING_SIZE   256
+#define KEY_RING_MASK   (KEY_RING_SIZE - 1)
+
+/* key_event_t flags: modifiers held, then what kind of event */
+#define KEY_LSHIFT      0x01
+#define KEY_RSHIFT      0x02
+#define KEY_LCTRL       0x04
+#define KEY_CAPS        0x08    /* caps lock is on */
+#define KEY_RELEASE     0x10    /* key went up */
+#define KEY_EXTENDED    0x20    /* came after EXTENDED_CODE (arrows, keypad, ...) */
+
+/* one key going down or up */
+typedef struct key_event_t {
+    uint64_t tsc;               /* when the scancode arrived */
+    uint8_t scancode;           /* scan set 1 make code */
+    int8_t ascii;               /* character typed with the modifiers, 0 if none */
+    uint16_t flags;             /* KEY_* */
+} key_event_t;
+
+/* reads a scancode and queues the key event */
+int32_t handle_keyboard(uint32_t irq, void* dev);
+/* wakes readers up, handles CTRL + L and scrollback paging, runs as a tasklet */
+void keyboard_bottom_half(uint32_t data);
 /* initialize keyboard IRQ */
 void init_keyboard(void);
-/* get last key pressed */
-int8_t keyboard_get_key();
+/* take up to n key events, waiting for one unless nonblock */
+int32_t keyboard_read_events(key_event_t* buf, int32_t n, int32_t nonblock);
+/* get the next character typed, 0 if there is none and nonblock is set */
+int8_t keyboard_get_key(int32_t nonblock);
 
 #define KBD_IRQ         1
 
@@ -37,4 +68,11 @@ int8_t keyboard_get_key();
 #define LALT            0x38
 #define CAPS            0x3a
 
+/* extended make codes */
+#define PAGE_UP         0x49
+#define PAGE_DOWN       0x51
+
+/* lines SHIFT + PAGE UP / DOWN move the scrollback, half a screen */
+#define SCROLLBACK_LINES    12
+
 #endif /* KEYBOARD_H */
@@ -0,0 +1,214 @@
+#include "pipe.h"
+
+#include <lib.h>
+
+static pipe_t pipes[MAX_PIPES];
+static uint8_t pipe_pages[MAX_PIPES][PIPE_BUF_SIZE] __attribute((aligned(PIPE_BUF_SIZE)));
+
+static void pipe_read_dup(file_desc_t* file);
+static void pipe_write_dup(file_desc_t* file);
+
+static fops_t pipe_read_ops = {NULL, pipe_read_close, pipe_read, NULL, pipe_read_dup};
+static fops_t pipe_write_ops = {NULL, pipe_write_close, NULL, pipe_write, pipe_write_dup};
+
+/* pipe behind an open descriptor of the current process */
+#define FD_PIPE(fd)         (&pipes[get_pcb_ptr()->file_desc_array[fd].inode])
+
+/*
+ * init_pipes
+ * DESCRIPTION: hand every pipe its page and mark it unused
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: none
+ */
+void init_pipes()
+{
+    int i;
+
+    for (i = 0; i < MAX_PIPES; i++) {
+        pipes[i].buf = pipe_pages[i];
+        pipes[i].readers = 0;
+        pipes[i].writers = 0;
+    }
+}
+
+/*
+ * pipe_create
+ * DESCRIPTION: allocate a pipe and open both of its ends
+ * INPUTS: none
+ * OUTPUTS: fds -- read end in fds[0], write end in fds[1]
+ * RETURN VALUE: 0 on success, -1 if no pipe or descriptor is free
+ * SIDE EFFECTS: none
+ */
+int32_t pipe_create(int32_t* fds)
+{
+    pcb_t* pcb = get_pcb_ptr();
+    pipe_t* pipe = NULL;
+    int32_t ends[2];
+    int i, n;
+
+    /* a pipe is free once both sides are gone */
+    for (i = 0; i < MAX_PIPES; i++) {
+        if (!pipes[i].readers && !pipes[i].writers) {
+            pipe = &pipes[i];
+            break;
+        }
+    }
+    if (!pipe)
+        return FFAIL;
+
+    /* find two empty file descriptors, fail otherwise */
+    for (i = 0, n = 0; i < FILE_DESC_SIZE && n < 2; i++) {
+        if (pcb->file_desc_array[i].flags == !IN_USE)
+            ends[n++] = i;
+    }
+    if (n != 2)
+        return FFAIL;
+
+    pipe->head = 0;
+    pipe->tail = 0;
+    pipe->readers = 1;
+    pipe->writers = 1;
+    wait_queue_init(&pipe->read_wq);
+    wait_queue_init(&pipe->write_wq);
+
+    for (i = 0; i < 2; i++) {
+        pcb->file_desc_array[ends[i]].inode = pipe - pipes;
+        pcb->file_desc_array[ends[i]].file_pos = 0;
+        pcb->file_desc_array[ends[i]].flags = IN_USE;
+    }
+    pcb->file_desc_array[ends[0]].file_ops = &pipe_read_ops;
+    pcb->file_desc_array[ends[1]].file_ops = &pipe_write_ops;
+
+    fds[0] = ends[0];
+    fds[1] = ends[1];
+    return FSUCCESS;
+}
+
+/*
+ * pipe_read
+ * DESCRIPTION: wait for data and copy out as much as is there
+ * INPUTS: fd     -- read end
+ *         nbytes -- most bytes to read
+ * OUTPUTS: buf -- bytes read
+ * RETURN VALUE: bytes read, 0 once the ring is empty and every
+ *               write end is closed
+ * SIDE EFFECTS: wakes up blocked writers
+ */
+int32_t pipe_read(int32_t fd, void* buf, int32_t nbytes)
+{
+    pipe_t* pipe = FD_PIPE(fd);
+    uint32_t count, off, chunk;
+
+    if (nbytes <= 0)
+        return 0;
+
+    wait_event(&pipe->read_wq, pipe->head != pipe->tail || !pipe->writers);
+
+    count = pipe->head - pipe->tail;
+    if (count > (uint32_t)nbytes)
+        count = nbytes;
+
+    /* up to the end of the page, then whatever wrapped around */
+    off = pipe->tail % PIPE_BUF_SIZE;
+    chunk = PIPE_BUF_SIZE - off;
+    if (chunk > count)
+        chunk = count;
+    memcpy(buf, pipe->buf + off, chunk);
+    memcpy((uint8_t*)buf + chunk, pipe->buf, count - chunk);
+    pipe->tail += count;
+
+    wake_up(&pipe->write_wq);
+    return count;
+}
+
+/*
+ * pipe_write
+ * DESCRIPTION: copy all of buf into the ring, waiting for room
+ *              whenever it fills up
+ * INPUTS: fd     -- write end
+ *         buf    -- bytes to write
+ *         nbytes -- number of bytes
+ * OUTPUTS: none
+ * RETURN VALUE: nbytes, or what got in before the last read end
+ *               closed (-1 if nothing did)
+ * SIDE EFFECTS: wakes up blocked readers
+ */
+int32_t pipe_write(int32_t fd, const void* buf, int32_t nbytes)
+{
+    pipe_t* pipe = FD_PIPE(fd);
+    uint32_t done = 0;
+    uint32_t count, off, chunk;
+
+    while ((int32_t)done < nbytes) {
+        wait_event(&pipe->write_wq,
+                   pipe->head - pipe->tail < PIPE_BUF_SIZE || !pipe->readers);
+        if (!pipe->readers)
+            return done ? (int32_t)done : FFAIL;
+
+        count = PIPE_BUF_SIZE - (pipe->head - pipe->tail);
+        if (count > nbytes - done)
+            count = nbytes - done;
+
+        off = pipe->head % PIPE_BUF_SIZE;
+        chunk = PIPE_BUF_SIZE - off;
+        if (chunk > count)
+            chunk = count;
+        memcpy(pipe->buf + off, (uint8_t*)buf + done, chunk);
+        memcpy(pipe->buf, (uint8_t*)buf + done + chunk, count - chunk);
+        pipe->head += count;
+        done += count;
+
+        wake_up(&pipe->read_wq);
+    }
+
+    return done;
+}
+
+/*
+ * pipe_read_close
+ * DESCRIPTION: close a read end
+ * INPUTS: fd -- read end
+ * OUTPUTS: none
+ * RETURN VALUE: 0
+ * SIDE EFFECTS: writers waiting for room fail once no reader is left
+ */
+int32_t pipe_read_close(int32_t fd)
+{
+    pipe_t* pipe = FD_PIPE(fd);
+
+    get_pcb_ptr()->file_desc_array[fd].flags = !IN_USE;
+    pipe->readers--;
+    wake_up(&pipe->write_wq);
+    return FSUCCESS;
+}
+
+/*
+ * pipe_write_close
+ * DESCRIPTION: close a write end
+ * INPUTS: fd -- write end
+ * OUTPUTS: none
+ * RETURN VALUE: 0
+ * SIDE EFFECTS: readers see end of file once no writer is left
+ */
+int32_t pipe_write_close(int32_t fd)
+{
+    pipe_t* pipe = FD_PIPE(fd);
+
+    get_pcb_ptr()->file_desc_array[fd].flags = !IN_USE;
+    pipe->writers--;
+    wake_up(&pipe->read_wq);
+    return FSUCCESS;
+}
+
+/* count an extra reference made by dup2 or by a child inheriting it */
+static void pipe_read_dup(file_desc_t* file)
+{
+    pipes[file->inode].readers++;
+}
+
+static void pipe_write_dup(file_desc_t* file)
+{
+    pipes[file->inode].writers++;
+}
@@ -0,0 +1,58 @@
+/*
+ * Anonymous pipes
+ *
+ * Each pipe is a one page ring buffer shared by a read end and a
+ * write end, both plain file descriptors.  Readers block while the
+ * ring is empty and writers while it is full; once every write end
+ * is closed readers see end of file, and once every read end is
+ * closed writes fail.  Data is moved with memcpy in at most two
+ * chunks per call, so a page sized transfer is a single copy.
+ *
+ * References Used:
+ *      pipe(7) Linux manual page
+ */
+
+#ifndef PIPE_H
+#define PIPE_H
+
+#include <types.h>
+#include <syscall/process.h>
+#include <syscall/sched.h>
+
+#define PIPE_BUF_SIZE       4096    /* one page */
+#define MAX_PIPES           8
+
+typedef struct pipe_t {
+    uint8_t* buf;
+    uint32_t head;                  /* bytes ever written */
+    uint32_t tail;                  /* bytes ever read */
+    int32_t readers;                /* open read ends */
+    int32_t writers;                /* open write ends */
+    wait_queue_t read_wq;
+    wait_queue_t write_wq;
+} pipe_t;
+
+/* set up the pipe pool */
+void init_pipes(void);
+
+/* create a pipe, its read end goes to fds[0] and write end to fds[1] */
+int32_t pipe_create(int32_t* fds);
+
+/*
+ *  PIPE DRIVER FUNCTIONS
+ * read only works on a read end and write on a write end
+ */
+
+/* read at least one byte, 0 at end of file */
+extern int32_t pipe_read(int32_t fd, void* buf, int32_t nbytes);
+
+/* write all of buf, -1 if nobody can read it any more */
+extern int32_t pipe_write(int32_t fd, const void* buf, int32_t nbytes);
+
+/* drop a read end */
+extern int32_t pipe_read_close(int32_t fd);
+
+/* drop a write end */
+extern int32_t pipe_write_close(int32_t fd);
+
+#endif /* PIPE_H */
@@ -0,0 +1,46 @@
+#include "pit.h"
+
+#include <lib.h>
+#include <timer.h>
+#include <interrupts/interrupts.h>
+#include <syscall/sched.h>
+
+#define LOW_BYTE            0xFF
+#define HIGH_SHIFT          8
+
+/*
+ * init_pit
+ * DESCRIPTION: program channel 0 as a rate generator running at HZ
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: hooks handle_pit up to IRQ0
+ */
+void init_pit() {
+    uint32_t divisor = PIT_BASE_FREQ / HZ;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    outb(PIT_MODE_RATE, PIT_COMMAND);
+    outb(divisor & LOW_BYTE, PIT_CHANNEL0);
+    outb((divisor >> HIGH_SHIFT) & LOW_BYTE, PIT_CHANNEL0);
+    restore_flags(flags);
+
+    (void)request_irq(PIT_IRQ, handle_pit, NULL);
+}
+
+/*
+ * handle_pit
+ * DESCRIPTION: top half of the timer interrupt
+ * INPUTS: irq -- PIT_IRQ
+ *         dev -- not used
+ * OUTPUTS: none
+ * RETURN VALUE: IRQ_HANDLED
+ * SIDE EFFECTS: advances jiffies, defers timer expiry and charges
+ *               the tick to the running task's time slice
+ */
+int32_t handle_pit(uint32_t irq, void* dev) {
+    timer_tick();
+    sched_tick();
+    return IRQ_HANDLED;
+}
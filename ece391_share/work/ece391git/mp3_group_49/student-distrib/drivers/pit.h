@@ -0,0 +1,42 @@
+/*
+ * Functions related to the 8253/8254 Programmable Interval Timer (PIT)
+ * aka IRQ0, pin0 on the master PIC
+ *
+ * common reference:
+ *      https://wiki.osdev.org/Programmable_Interval_Timer
+ *
+ * frequency calculation:
+ *      PIT frequency = 1193182 / divisor
+ */
+
+#ifndef PIT_H
+#define PIT_H
+
+#include <types.h>
+
+#define PIT_IRQ             0
+
+#define PIT_CHANNEL0        0x40
+#define PIT_CHANNEL2        0x42
+#define PIT_COMMAND         0x43
+
+/* channel 2 gate (bit 0) and output (bit 5), speaker enable is bit 1 */
+#define PIT_GATE_PORT       0x61
+#define PIT_GATE2           0x01
+#define PIT_SPEAKER         0x02
+#define PIT_OUT2            0x20
+
+#define PIT_BASE_FREQ       1193182
+
+/* channel 0, lobyte/hibyte, mode 2 (rate generator), binary */
+#define PIT_MODE_RATE       0x34
+/* channel 2, lobyte/hibyte, mode 0 (interrupt on terminal count), binary */
+#define PIT_MODE_ONESHOT2   0xB0
+
+/* start channel 0 at HZ interrupts per second */
+void init_pit(void);
+
+/* handle PIT interrupts */
+int32_t handle_pit(uint32_t irq, void* dev);
+
+#endif /* PIT_H */
@@ -1,8 +1,10 @@
 #include "rtc.h"
 
 #include <lib.h>
-#include <interrupts/i8259.h>
+#include <interrupts/interrupts.h>
+#include <interrupts/tasklet.h>
 #include <syscall/process.h>
+#include <syscall/sched.h>
 
 #define INDEX               0x70
 #define CONFIG              0x71
@@ -34,6 +36,23 @@
 #define RTC_OPEN_FREQ       2
 #define CLEAR               0
 
+/* CMOS clock registers, NMI stays disabled while we read them */
+#define CMOS_SEC            0x80
+#define CMOS_MIN            0x82
+#define CMOS_HOUR           0x84
+#define CMOS_DAY            0x87
+#define CMOS_MONTH          0x88
+#define CMOS_YEAR           0x89
+#define UPDATE_IN_PROGRESS  0x80    /* register A */
+#define REG_B_24H           0x02
+#define REG_B_BINARY        0x04
+#define HOUR_PM             0x80    /* 12 hour mode only */
+#define CMOS_CENTURY        2000    /* two digit years are taken as 20xx */
+#define EPOCH_YEAR          1970
+#define SECS_PER_DAY        86400
+#define SECS_PER_HOUR       3600
+#define SECS_PER_MIN        60
+
 /* int interrupted states */
 #define WAITING             0
 #define INT_HIT             1
@@ -42,6 +61,7 @@
 static int vfreq;                               /* virtual frequency container */
 static int icounter = 0;                        /* virtual interrupt counter */
 volatile static int interrupted = WAITING;       /* "flag" for rtc_read */
+static wait_queue_t rtc_wq;                     /* tasks blocked in rtc_read */
 
 /* uncomment to turn on debug mode for init_rtc */
 // #define RTC_DEBUG
@@ -86,18 +106,91 @@ void init_rtc() {
     outb(REG_A, INDEX);
     outb((old_config & (int)CLEAR_BOTTOM) + rate, CONFIG);
     sti();
-    enable_irq(PIC_PIN_RTC);
+    (void)request_irq(PIC_PIN_RTC, handle_rtc, NULL);
+}
+
+/* read one CMOS register */
+static uint8_t cmos_read(uint8_t reg)
+{
+    outb(reg, INDEX);
+    return inb(CONFIG);
+}
+
+/* convert a packed BCD byte to binary */
+static uint8_t bcd_to_bin(uint8_t v)
+{
+    return (v >> 4) * 10 + (v & CLEAR_TOP);
+}
+
+/* leap days in the years up to and including year */
+static uint32_t leap_days(uint32_t year)
+{
+    return year / 4 - year / 100 + year / 400;
 }
 
 /*
- * handle_rtc
- * DESCRIPTION: handles the rtc for test_interrupt as an example
+ * rtc_get_time
+ * DESCRIPTION: read the wall clock kept by the CMOS
  * INPUTS: none
  * OUTPUTS: none
- * RETURN VALUE: none
- * SIDE EFFECTS: none
+ * RETURN VALUE: seconds since 1970-01-01 00:00, in whatever time zone
+ *               the CMOS clock is set to
+ * SIDE EFFECTS: spins for up to one update cycle (~2ms)
+ */
+uint32_t rtc_get_time() {
+    static const uint16_t days_before_month[] = {
+        0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334
+    };
+    uint8_t sec, min, hour, day, month, year, reg_b;
+    uint32_t flags, days, full_year, pm;
+
+    cli_and_save(flags);
+    /* fields read during an update may belong to different seconds */
+    while (cmos_read(REG_A) & UPDATE_IN_PROGRESS);
+    sec = cmos_read(CMOS_SEC);
+    min = cmos_read(CMOS_MIN);
+    hour = cmos_read(CMOS_HOUR);
+    day = cmos_read(CMOS_DAY);
+    month = cmos_read(CMOS_MONTH);
+    year = cmos_read(CMOS_YEAR);
+    reg_b = cmos_read(REG_B);
+    restore_flags(flags);
+
+    pm = hour & HOUR_PM;
+    hour &= ~HOUR_PM;
+    if (!(reg_b & REG_B_BINARY)) {
+        sec = bcd_to_bin(sec);
+        min = bcd_to_bin(min);
+        hour = bcd_to_bin(hour);
+        day = bcd_to_bin(day);
+        month = bcd_to_bin(month);
+        year = bcd_to_bin(year);
+    }
+    /* 12 AM is hour 0, 12 PM is hour 12 */
+    if (!(reg_b & REG_B_24H))
+        hour = hour % 12 + (pm ? 12 : 0);
+
+    full_year = CMOS_CENTURY + year;
+    days = (full_year - EPOCH_YEAR) * 365 +
+           leap_days(full_year - 1) - leap_days(EPOCH_YEAR - 1) +
+           days_before_month[(month - 1) % 12] + day - 1;
+    if (month > 2 && leap_days(full_year) != leap_days(full_year - 1))
+        days++;
+
+    return days * SECS_PER_DAY + hour * SECS_PER_HOUR + min * SECS_PER_MIN + sec;
+}
+
+/*
+ * handle_rtc
+ * DESCRIPTION: top half of the RTC interrupt; acknowledges the
+ *              chip, then defers the bookkeeping
+ * INPUTS: irq -- PIC_PIN_RTC
+ *         dev -- not used
+ * OUTPUTS: none
+ * RETURN VALUE: IRQ_HANDLED
+ * SIDE EFFECTS: queues rtc_bottom_half
  */
-void handle_rtc() {
+int32_t handle_rtc(uint32_t irq, void* dev) {
     /* 
      * throw away the contents of register C
      * so that the interrupts can be received
@@ -105,11 +198,25 @@ void handle_rtc() {
     outb(LOAD_REG_C_BITS, INDEX);
     inb(CONFIG);
 
+    (void)tasklet_schedule(rtc_bottom_half, 0);
+    return IRQ_HANDLED;
+}
+
+/*
+ * rtc_bottom_half
+ * DESCRIPTION: advances the virtualized rtc, runs as a tasklet
+ * INPUTS: data -- not used
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: wakes up rtc_read once enough ticks have passed
+ */
+void rtc_bottom_half(uint32_t data) {
     /* virtualized rtc counter gets a hit */
     icounter++;
     if(vfreq*icounter >= FREQ_MAX){
         /* set flag for read_rtc */
         interrupted = INT_HIT;
+        wake_up(&rtc_wq);
         /* keep counter in check */
         icounter -= FREQ_MAX/vfreq;
     }
@@ -129,9 +236,6 @@ void handle_rtc() {
             debug_track = 0;
         }
     #endif
-
-    /* send eoi to PIC's RTC pin */
-    send_eoi(PIC_PIN_RTC);
 }
 
 /* start of driver functions */
@@ -182,16 +286,13 @@ int32_t rtc_open(const uint8_t* filename){
  *         nbytes -- not used
  * OUTPUTS: none
  * RETURN VALUE: 0 on success
- * SIDE EFFECTS: waits until interrupt
+ * SIDE EFFECTS: sleeps until interrupt
  */
 int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes){
     /* set flag to help distinguish the next interrupt at virtual frequency */
     interrupted = WAITING;
-    /* loop until enough interrupts happen */
-    do{
-        /* pause the processor until the next interrupt. */
-        asm volatile("hlt");
-    }while(interrupted == WAITING);
+    /* sleep until enough interrupts happen */
+    wait_event(&rtc_wq, interrupted != WAITING);
     
     return FSUCCESS;
 }
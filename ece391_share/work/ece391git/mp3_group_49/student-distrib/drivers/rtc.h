@@ -21,8 +21,14 @@
 /* initialize RTC with default values */
 void init_rtc(void);
 
+/* wall clock from the CMOS, seconds since 1970 */
+uint32_t rtc_get_time(void);
+
 /* handle RTC interrupts */
-void handle_rtc(void);
+int32_t handle_rtc(uint32_t irq, void* dev);
+
+/* deferred part of the RTC interrupt */
+void rtc_bottom_half(uint32_t data);
 
 /* 
  *  RTC DRIVER FUNCTIONS
@@ -0,0 +1,333 @@
+#include "serial.h"
+
+#include <lib.h>
+#include <interrupts/interrupts.h>
+#include <interrupts/tasklet.h>
+#include <syscall/process.h>
+#include <syscall/sched.h>
+
+/* set once the loopback probe found a UART */
+static int32_t serial_present = 0;
+
+/*
+ * bytes waiting to be sent; writers append at tx_head with interrupts
+ * off, handle_serial takes them from tx_tail
+ */
+static uint8_t tx_ring[SERIAL_TX_SIZE];
+static volatile uint32_t tx_head = 0;
+static volatile uint32_t tx_tail = 0;
+static volatile int32_t tx_busy = 0;     /* THRE interrupt on, FIFO draining */
+
+/* bytes received; handle_serial appends, readers take */
+static uint8_t rx_ring[SERIAL_RX_SIZE];
+static volatile uint32_t rx_head = 0;
+static volatile uint32_t rx_tail = 0;
+
+static volatile int32_t serial_bh_pending = 0;   /* serial_bottom_half queued */
+static wait_queue_t tx_wq;                      /* writers waiting for room */
+static wait_queue_t rx_wq;                      /* readers waiting for data */
+
+static fops_t serial_ops = {serial_open, serial_close, serial_read, serial_write};
+
+/*
+ * serial_fill_fifo
+ * DESCRIPTION: hand up to a FIFO's worth of the transmit ring to the UART
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: call with interrupts disabled and the FIFO empty
+ */
+static void serial_fill_fifo(void)
+{
+    int i;
+
+    for (i = 0; i < UART_FIFO_SIZE && tx_tail != tx_head; i++) {
+        outb(tx_ring[tx_tail & SERIAL_TX_MASK], COM1_BASE + UART_DATA);
+        tx_tail++;
+    }
+}
+
+/*
+ * serial_start_tx
+ * DESCRIPTION: get an idle transmitter going on newly queued bytes
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: call with interrupts disabled; turns the THRE
+ *               interrupt on, handle_serial turns it off once the
+ *               ring is empty
+ */
+static void serial_start_tx(void)
+{
+    if (tx_busy || tx_tail == tx_head)
+        return;
+
+    tx_busy = 1;
+    if (inb(COM1_BASE + UART_LSR) & LSR_THRE)
+        serial_fill_fifo();
+    outb(IER_RX | IER_THRE, COM1_BASE + UART_IER);
+}
+
+/*
+ * tx_put
+ * DESCRIPTION: append as much of buf to the transmit ring as fits,
+ *              sending each newline as CR LF
+ * INPUTS: buf -- bytes to send
+ *         n   -- number of bytes
+ * OUTPUTS: none
+ * RETURN VALUE: bytes of buf taken
+ * SIDE EFFECTS: starts the transmitter
+ */
+static int32_t tx_put(const uint8_t* buf, int32_t n)
+{
+    uint32_t flags;
+    int32_t done = 0;
+
+    cli_and_save(flags);
+    while (done < n) {
+        if (buf[done] == '\n') {
+            if (tx_head - tx_tail > SERIAL_TX_SIZE - 2)
+                break;
+            tx_ring[tx_head++ & SERIAL_TX_MASK] = '\r';
+        } else if (tx_head - tx_tail == SERIAL_TX_SIZE) {
+            break;
+        }
+        tx_ring[tx_head++ & SERIAL_TX_MASK] = buf[done++];
+    }
+    serial_start_tx();
+    restore_flags(flags);
+
+    return done;
+}
+
+/*
+ * serial_bottom_half
+ * DESCRIPTION: wake up readers and writers after the UART moved data
+ * INPUTS: data -- not used
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: runs as a tasklet
+ */
+static void serial_bottom_half(uint32_t data)
+{
+    serial_bh_pending = 0;
+    wake_up(&rx_wq);
+    wake_up(&tx_wq);
+}
+
+/*
+ * init_serial
+ * DESCRIPTION: find COM1 with a loopback test and set it to 115200 8N1
+ *              with FIFOs and the receive interrupt on
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: leaves the port alone if nothing answers
+ */
+void init_serial()
+{
+    wait_queue_init(&tx_wq);
+    wait_queue_init(&rx_wq);
+
+    outb(0, COM1_BASE + UART_IER);
+    outb(LCR_DLAB, COM1_BASE + UART_LCR);
+    outb(SERIAL_DIVISOR, COM1_BASE + UART_DATA);
+    outb(0, COM1_BASE + UART_IER);              /* divisor high byte */
+    outb(LCR_8N1, COM1_BASE + UART_LCR);
+    outb(FCR_ENABLE | FCR_CLEAR_RX | FCR_CLEAR_TX | FCR_TRIGGER_14, COM1_BASE + UART_FCR);
+
+    /* a byte sent in loopback mode comes straight back if the UART is there */
+    outb(MCR_LOOP | MCR_RTS | MCR_OUT2, COM1_BASE + UART_MCR);
+    outb(LOOPBACK_BYTE, COM1_BASE + UART_DATA);
+    if (inb(COM1_BASE + UART_DATA) != LOOPBACK_BYTE)
+        return;
+
+    outb(MCR_DTR | MCR_RTS | MCR_OUT2, COM1_BASE + UART_MCR);
+    serial_present = 1;
+    (void)request_irq(SERIAL_IRQ, handle_serial, NULL);
+    outb(IER_RX, COM1_BASE + UART_IER);
+}
+
+/*
+ * handle_serial
+ * DESCRIPTION: serve every interrupt the UART has pending: move
+ *              received bytes into the receive ring and refill the
+ *              transmit FIFO, or turn THRE off once there is nothing
+ *              left to send
+ * INPUTS: irq -- SERIAL_IRQ
+ *         dev -- not used
+ * OUTPUTS: none
+ * RETURN VALUE: IRQ_HANDLED, IRQ_NONE if the UART had nothing pending
+ * SIDE EFFECTS: waking readers and writers is left to a tasklet
+ */
+int32_t handle_serial(uint32_t irq, void* dev)
+{
+    int32_t handled = IRQ_NONE;
+    uint32_t iir;
+    uint8_t c;
+
+    while (!((iir = inb(COM1_BASE + UART_IIR)) & IIR_NONE)) {
+        handled = IRQ_HANDLED;
+        switch (iir & IIR_ID_MASK) {
+            case IIR_RX:
+            case IIR_RX_TIMEOUT:
+                while (inb(COM1_BASE + UART_LSR) & LSR_DR) {
+                    c = inb(COM1_BASE + UART_DATA);
+                    /* drop what the ring has no room for */
+                    if (rx_head - rx_tail < SERIAL_RX_SIZE)
+                        rx_ring[rx_head++ & SERIAL_RX_MASK] = c;
+                }
+                break;
+            case IIR_THRE:
+                if (tx_tail == tx_head) {
+                    tx_busy = 0;
+                    outb(IER_RX, COM1_BASE + UART_IER);
+                } else {
+                    serial_fill_fifo();
+                }
+                break;
+            case IIR_LSR:
+                (void)inb(COM1_BASE + UART_LSR);
+                break;
+            default:
+                (void)inb(COM1_BASE + UART_MSR);
+                break;
+        }
+    }
+
+    if (handled == IRQ_HANDLED && !serial_bh_pending) {
+        serial_bh_pending = 1;
+        if (tasklet_schedule(serial_bottom_half, 0))
+            serial_bh_pending = 0;
+    }
+    return handled;
+}
+
+/*
+ * serial_console_write
+ * DESCRIPTION: mirror console output to COM1
+ * INPUTS: buf -- characters printed
+ *         n   -- number of characters
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: never blocks, so it is safe from interrupt handlers;
+ *               whatever does not fit in the ring is dropped
+ */
+void serial_console_write(const int8_t* buf, int32_t n)
+{
+    if (serial_present)
+        (void)tx_put((const uint8_t*)buf, n);
+}
+
+/*
+ * serial_tx_pending
+ * DESCRIPTION: check how far behind the transmitter is
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: bytes in the transmit ring
+ * SIDE EFFECTS: none
+ */
+int32_t serial_tx_pending()
+{
+    return tx_head - tx_tail;
+}
+
+/*
+ * serial_open
+ * DESCRIPTION: give the caller a descriptor for COM1
+ * INPUTS: filename -- not used
+ * OUTPUTS: none
+ * RETURN VALUE: the descriptor, -1 if there is no UART or no free slot
+ * SIDE EFFECTS: none
+ */
+int32_t serial_open(const uint8_t* filename)
+{
+    pcb_t* pcb = get_pcb_ptr();
+    int32_t fd;
+
+    if (!serial_present)
+        return FFAIL;
+
+    for (fd = 0; fd < FILE_DESC_SIZE; fd++) {
+        if (pcb->file_desc_array[fd].flags == !IN_USE)
+            break;
+    }
+    if (fd == FILE_DESC_SIZE)
+        return FFAIL;
+
+    pcb->file_desc_array[fd].inode = NULL;
+    pcb->file_desc_array[fd].file_pos = 0;
+    pcb->file_desc_array[fd].flags = IN_USE;
+    pcb->file_desc_array[fd].file_ops = &serial_ops;
+    return fd;
+}
+
+/*
+ * serial_close
+ * DESCRIPTION: free a COM1 descriptor
+ * INPUTS: fd -- descriptor to free
+ * OUTPUTS: none
+ * RETURN VALUE: 0
+ * SIDE EFFECTS: queued output still goes out
+ */
+int32_t serial_close(int32_t fd)
+{
+    get_pcb_ptr()->file_desc_array[fd].flags = !IN_USE;
+    return FSUCCESS;
+}
+
+/*
+ * serial_read
+ * DESCRIPTION: wait for input and copy out as much as has arrived
+ * INPUTS: fd     -- not used
+ *         nbytes -- most bytes to read
+ * OUTPUTS: buf -- bytes read
+ * RETURN VALUE: bytes read, -1 on a bad buffer
+ * SIDE EFFECTS: sleeps until at least one byte is there
+ */
+int32_t serial_read(int32_t fd, void* buf, int32_t nbytes)
+{
+    uint32_t flags;
+    int32_t count = 0;
+
+    if (!buf || nbytes < 0)
+        return FFAIL;
+    if (!nbytes)
+        return 0;
+
+    wait_event(&rx_wq, rx_head != rx_tail);
+
+    cli_and_save(flags);
+    while (count < nbytes && rx_tail != rx_head) {
+        ((uint8_t*)buf)[count++] = rx_ring[rx_tail & SERIAL_RX_MASK];
+        rx_tail++;
+    }
+    restore_flags(flags);
+
+    return count;
+}
+
+/*
+ * serial_write
+ * DESCRIPTION: queue all of buf for sending
+ * INPUTS: fd     -- not used
+ *         buf    -- bytes to send
+ *         nbytes -- number of bytes
+ * OUTPUTS: none
+ * RETURN VALUE: nbytes, -1 on a bad buffer
+ * SIDE EFFECTS: sleeps while the transmit ring is full
+ */
+int32_t serial_write(int32_t fd, const void* buf, int32_t nbytes)
+{
+    int32_t done = 0;
+
+    if (!buf || nbytes < 0)
+        return FFAIL;
+
+    while (done < nbytes) {
+        /* room for at least a CR LF pair */
+        wait_event(&tx_wq, tx_head - tx_tail <= SERIAL_TX_SIZE - 2);
+        done += tx_put((const uint8_t*)buf + done, nbytes - done);
+    }
+    return nbytes;
+}
@@ -0,0 +1,105 @@
+/*
+ * 16550 UART driver for COM1
+ *
+ * Output goes through a transmit ring: writers append to it and every
+ * THRE (transmit holding register empty) interrupt refills the 16 byte
+ * transmit FIFO from it, so the UART is touched once per 16 bytes
+ * instead of polling the line status before every byte.  Received
+ * bytes collect in a smaller ring that read drains.
+ *
+ * The port shows up as the device file "serial", and the console
+ * mirrors everything it prints here, so a headless QEMU run with
+ * -serial stdio sees the same output as the screen.  Newlines go out
+ * as CR LF.  If no UART answers the loopback probe at boot, opening
+ * the device fails and console output is only shown on screen.
+ *
+ * References Used:
+ *      https://wiki.osdev.org/Serial_Ports
+ *      PC16550D Universal Asynchronous Receiver/Transmitter datasheet
+ */
+
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include <types.h>
+
+#define SERIAL_IRQ          4
+#define COM1_BASE           0x3F8
+
+/* register offsets from COM1_BASE */
+#define UART_DATA           0       /* THR / RBR, divisor low with DLAB */
+#define UART_IER            1       /* divisor high with DLAB */
+#define UART_IIR            2       /* reads */
+#define UART_FCR            2       /* writes */
+#define UART_LCR            3
+#define UART_MCR            4
+#define UART_LSR            5
+#define UART_MSR            6
+
+#define IER_RX              0x01    /* received data available */
+#define IER_THRE            0x02    /* transmit holding register empty */
+
+#define IIR_NONE            0x01    /* no interrupt pending */
+#define IIR_ID_MASK         0x0E
+#define IIR_MSR             0x00
+#define IIR_THRE            0x02
+#define IIR_RX              0x04
+#define IIR_LSR             0x06
+#define IIR_RX_TIMEOUT      0x0C
+
+#define FCR_ENABLE          0x01
+#define FCR_CLEAR_RX        0x02
+#define FCR_CLEAR_TX        0x04
+#define FCR_TRIGGER_14      0xC0    /* interrupt once 14 bytes arrived */
+
+#define LCR_8N1             0x03
+#define LCR_DLAB            0x80
+
+#define MCR_DTR             0x01
+#define MCR_RTS             0x02
+#define MCR_OUT2            0x08    /* gates the interrupt line on PCs */
+#define MCR_LOOP            0x10
+
+#define LSR_DR              0x01    /* data ready */
+#define LSR_THRE            0x20
+
+/* 115200 / divisor baud */
+#define SERIAL_DIVISOR      1
+#define UART_FIFO_SIZE      16
+#define LOOPBACK_BYTE       0xAE
+
+/* ring sizes, must be powers of 2 */
+#define SERIAL_TX_SIZE      4096
+#define SERIAL_TX_MASK      (SERIAL_TX_SIZE - 1)
+#define SERIAL_RX_SIZE      256
+#define SERIAL_RX_MASK      (SERIAL_RX_SIZE - 1)
+
+/* probe COM1, set it to 115200 8N1 and hook its IRQ */
+void init_serial(void);
+
+/* drains the receive FIFO and refills the transmit FIFO */
+int32_t handle_serial(uint32_t irq, void* dev);
+
+/* queue console output without blocking, drops what does not fit */
+void serial_console_write(const int8_t* buf, int32_t n);
+
+/* bytes queued but not handed to the UART yet */
+int32_t serial_tx_pending(void);
+
+/*
+ *  SERIAL DRIVER FUNCTIONS
+ */
+
+/* open COM1, -1 if there is no UART */
+int32_t serial_open(const uint8_t* filename);
+
+/* free the descriptor */
+int32_t serial_close(int32_t fd);
+
+/* wait for at least one received byte, returns what is there */
+int32_t serial_read(int32_t fd, void* buf, int32_t nbytes);
+
+/* queue all of buf, waiting whenever the transmit ring fills up */
+int32_t serial_write(int32_t fd, const void* buf, int32_t nbytes);
+
+#endif /* SERIAL_H */
@@ -2,75 +2,99 @@
 #include "keyboard.h"
 
 #include <lib.h>
+#include <klog.h>
+#include <syscall/process.h>
 
 #define MAX_BUF_FILL    128
 
 
-static int8_t terminal_buf[MAX_BUF_FILL];
+/*
+ * line discipline state; there is one terminal, so the mode is shared
+ * by everyone reading it and put back to TTY_DEFAULT when the task
+ * that changed it exits
+ */
+static uint32_t tty_mode = TTY_DEFAULT;
+static int32_t tty_mode_pid = -1;           /* task that last set the mode */
+static int8_t line_buf[MAX_BUF_FILL];       /* canonical line being edited */
+static int32_t line_len = 0;
 
 
-// helper vars for terminal using keyboard
-static short in_terminal = 0;       // see if we even need to keep track of backspacing too much... set the to true if you wanna 
-                                    // not allow it to backspace at a certain point... also set the depth to 0
+/* echo a key straight to the console, it is not a kernel message */
+static void echo_key(int8_t c)
+{
+    console_write(&c, 1);
+}
 
 
 /* SYSCALL FUNCTIONS */
 
 /* terminal_read
- * Read up to size-1 characters (127 max) before the the enter key is pressed.
- * A newline character is automatically added.
+ * In canonical mode, read up to size-1 characters (127 max) before the
+ * the enter key is pressed.  A newline character is automatically added.
+ * The line is edited (backspace) and echoed here as keys come out of
+ * the key ring, and kept between calls, so a non-blocking reader picks
+ * it up once it is complete.  In raw mode every key typed is returned
+ * right away.
  * Inputs: int8_t* buf - where inputted characters are stored
  *         uint32_t n - number of characters to read (max buf size minus 1) 
- * Return Value: number of characters read on success, -1 on failure
+ * Return Value: number of characters read on success, -1 on failure,
+ *               0 if TTY_NONBLOCK is set and no line (or key) is ready
  * Function: reads keyboard input 
  */
 int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes)
 {
+    int32_t nonblock = tty_mode & TTY_NONBLOCK;
+    int32_t echo = tty_mode & TTY_ECHO;
+    int32_t count = 0;
+    int8_t c;
+
     /* null parameter check */
-    in_terminal = 1;
-    if (buf == NULL){
-		return FFAIL;
-	}
-    if(nbytes > MAX_BUF_FILL){
-        nbytes = ((int32_t)MAX_BUF_FILL)-1;
+    if (buf == NULL || nbytes < 0){
+        return FFAIL;
     }
-    uint32_t i = 0;
-    while (i <= nbytes && (terminal_buf[i] = keyboard_get_key())) {
-        if (terminal_buf[i] == '\n'){
-            putc('\n');
-            break;
+    if (!nbytes)
+        return 0;
+
+    if (!(tty_mode & TTY_CANON)) {
+        /* raw: wait for the first key at most, then take what is there */
+        while (count < nbytes && (c = keyboard_get_key(nonblock || count))) {
+            ((int8_t*)buf)[count++] = c;
+            if (echo)
+                echo_key(c);
+        }
+        return count;
+    }
+
+    while ((c = keyboard_get_key(nonblock))) {
+        if (c == '\n') {
+            if (echo)
+                echo_key('\n');
+            /* hand out the line, what does not fit in buf is dropped */
+            count = (line_len < nbytes - 1) ? line_len : nbytes - 1;
+            memcpy(buf, line_buf, count);
+            ((int8_t*)buf)[count++] = '\n';
+            line_len = 0;
+            return count;
         }
 
-        if (terminal_buf[i] == '\b') {
+        if (c == BACKSPACE) {
             /* handle backspace */
-            if(i <= 0){
-                continue;
+            if (line_len > 0) {
+                line_len--;
+                if (echo)
+                    echo_key(BACKSPACE);
             }
-            putc('\b');
-            i--;     
-            terminal_buf[i] = NULL;
             continue;
-        }else{
-            ((int8_t*)buf)[i] = terminal_buf[i];
-            putc(((int8_t*)buf)[i]);
-            i++;
         }
-            // find the location of the cursor using the get function I made in lib.h
-            // change the value in video mem of that location to ' '
-            // change the cursor using the set function I made
-            // actually in case we aren't the first backspace in the set, we can just delete the previous character in the buffers
-    }
-    int x = 0;
-    for(; x < MAX_BUF_FILL; x++){
-        terminal_buf[x] = 0;
-    }
-    /* emd the line and keep filling */
-    ((int8_t*)buf)[i++] = '\n';
-    for(x = i + 1; x < MAX_BUF_FILL; x++){
-        ((int8_t*)buf)[x] = 0;
+
+        /* keep room for the newline, ignore keys past the end */
+        if (line_len < MAX_BUF_FILL - 1) {
+            line_buf[line_len++] = c;
+            if (echo)
+                echo_key(c);
+        }
     }
-    in_terminal = 0;
-    return i;
+    return 0;
 }
 
 
@@ -79,15 +103,18 @@ int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes)
  * Inputs: int8_t* buf - buffer of characters to write
  *         uint32_t n - number of characters to write
  * Return Value: 0 on success, -1 on failure
- * Function: writes to screen. Only stops after n chars written. 
+ * Function: writes to screen. Only stops after n chars written.
+ *           The whole buffer goes to the console in one piece so the
+ *           cursor is only moved once per write.
  */
 int32_t terminal_write(int32_t fd, const void* buf, int32_t nbytes)
 {
-    int i = 0;
-    /* write nbytes from buffer */
-    for(; i < nbytes; i++){
-        putc(((int8_t *)buf)[i]);
-    }
+    if (buf == NULL || nbytes < 0)
+        return FFAIL;
+
+    /* kernel messages logged before this write show up before it */
+    klog_flush();
+    console_write((const int8_t*)buf, nbytes);
     return FSUCCESS;
 }
 
@@ -107,10 +134,58 @@ int32_t terminal_open(const uint8_t* filename)
  * close terminal device
  * Inputs: int32_t fd
  * Outputs: none
- * Return Value: 0 on success
- * Function: none.
+ * Return Value: 0 on success, -1 for stdin and stdout
+ * Function: frees copies of the terminal made with dup2; the
+ *           standard descriptors themselves stay open.
  */
 int32_t terminal_close(int32_t fd)
 {
-    return FFAIL;
+    if (fd == STDIN || fd == STDOUT)
+        return FFAIL;
+
+    get_pcb_ptr()->file_desc_array[fd].flags = !IN_USE;
+    return FSUCCESS;
+}
+
+/* terminal_ioctl
+ * change or look at the line discipline
+ * Inputs: int32_t fd - not used
+ *         uint32_t cmd - TTY_GETMODE or TTY_SETMODE
+ *         uint32_t arg - new TTY_* mode bits for TTY_SETMODE
+ * Return Value: the mode for TTY_GETMODE, 0 for TTY_SETMODE, -1 on
+ *               an unknown command or mode bit
+ * Function: leaving canonical mode drops a half typed line.
+ */
+int32_t terminal_ioctl(int32_t fd, uint32_t cmd, uint32_t arg)
+{
+    switch (cmd) {
+        case TTY_GETMODE:
+            return tty_mode;
+        case TTY_SETMODE:
+            if (arg & ~TTY_MODE_MASK)
+                return FFAIL;
+            if (!(arg & TTY_CANON))
+                line_len = 0;
+            tty_mode = arg;
+            tty_mode_pid = get_pcb_ptr()->pid;
+            return FSUCCESS;
+        default:
+            return FFAIL;
+    }
+}
+
+/* terminal_exit
+ * undo the mode changes of a task that is going away
+ * Inputs: int32_t pid - task that exits
+ * Outputs: none
+ * Return Value: none
+ * Function: so a game killed in raw mode does not leave the shell
+ *           without echo.
+ */
+void terminal_exit(int32_t pid)
+{
+    if (tty_mode_pid == pid) {
+        tty_mode = TTY_DEFAULT;
+        tty_mode_pid = -1;
+    }
 }
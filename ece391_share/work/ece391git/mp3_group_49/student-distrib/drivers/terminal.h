@@ -12,6 +12,19 @@ int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes);
 int32_t terminal_write(int32_t fd, const void* buf, int32_t nbytes);
 int32_t terminal_open(const uint8_t* filename);
 int32_t terminal_close(int32_t fd);
+int32_t terminal_ioctl(int32_t fd, uint32_t cmd, uint32_t arg);
+void terminal_exit(int32_t pid);
+
+/* terminal_ioctl commands */
+#define TTY_GETMODE     1
+#define TTY_SETMODE     2
+
+/* line discipline mode bits */
+#define TTY_CANON       0x1     /* edit a line, read returns it once enter is hit */
+#define TTY_ECHO        0x2     /* show keys as they are read */
+#define TTY_NONBLOCK    0x4     /* read returns 0 instead of waiting */
+#define TTY_MODE_MASK   (TTY_CANON | TTY_ECHO | TTY_NONBLOCK)
+#define TTY_DEFAULT     (TTY_CANON | TTY_ECHO)
 
 
 #endif /* _TERMINAL_H */
@@ -0,0 +1,414 @@
+#include "vga.h"
+
+#include <lib.h>
+#include <paging.h>
+#include <timer.h>
+#include <syscall/process.h>
+
+/* VGA register settings for mode X */
+static uint16_t mode_X_seq[NUM_SEQUENCER_REGS] = {
+    0x0100, 0x2101, 0x0F02, 0x0003, 0x0604
+};
+static uint16_t mode_X_CRTC[NUM_CRTC_REGS] = {
+    0x5F00, 0x4F01, 0x5002, 0x8203, 0x5404, 0x8005, 0xBF06, 0x1F07,
+    0x0008, 0x0109, 0x000A, 0x000B, 0x000C, 0x000D, 0x000E, 0x000F,
+    0x9C10, 0x8E11, 0x8F12, 0x2813, 0x0014, 0x9615, 0xB916, 0xE317,
+    0x6B18
+};
+static uint8_t mode_X_attr[NUM_ATTR_REGS * 2] = {
+    0x00, 0x00, 0x01, 0x01, 0x02, 0x02, 0x03, 0x03,
+    0x04, 0x04, 0x05, 0x05, 0x06, 0x06, 0x07, 0x07,
+    0x08, 0x08, 0x09, 0x09, 0x0A, 0x0A, 0x0B, 0x0B,
+    0x0C, 0x0C, 0x0D, 0x0D, 0x0E, 0x0E, 0x0F, 0x0F,
+    0x10, 0x41, 0x11, 0x00, 0x12, 0x0F, 0x13, 0x00,
+    0x14, 0x00, 0x15, 0x00
+};
+static uint16_t mode_X_graphics[NUM_GRAPHICS_REGS] = {
+    0x0000, 0x0001, 0x0002, 0x0003, 0x0004, 0x4005, 0x0506, 0x0F07,
+    0xFF08
+};
+
+/* VGA register settings for text mode 3 (color text) */
+static uint16_t text_seq[NUM_SEQUENCER_REGS] = {
+    0x0100, 0x2001, 0x0302, 0x0003, 0x0204
+};
+static uint16_t text_CRTC[NUM_CRTC_REGS] = {
+    0x5F00, 0x4F01, 0x5002, 0x8203, 0x5504, 0x8105, 0xBF06, 0x1F07,
+    0x0008, 0x4F09, 0x0D0A, 0x0E0B, 0x000C, 0x000D, 0x000E, 0x000F,
+    0x9C10, 0x8E11, 0x8F12, 0x2813, 0x1F14, 0x9615, 0xB916, 0xA317,
+    0xFF18
+};
+static uint8_t text_attr[NUM_ATTR_REGS * 2] = {
+    0x00, 0x00, 0x01, 0x01, 0x02, 0x02, 0x03, 0x03,
+    0x04, 0x04, 0x05, 0x05, 0x06, 0x06, 0x07, 0x07,
+    0x08, 0x08, 0x09, 0x09, 0x0A, 0x0A, 0x0B, 0x0B,
+    0x0C, 0x0C, 0x0D, 0x0D, 0x0E, 0x0E, 0x0F, 0x0F,
+    0x10, 0x0C, 0x11, 0x00, 0x12, 0x0F, 0x13, 0x08,
+    0x14, 0x00, 0x15, 0x00
+};
+static uint16_t text_graphics[NUM_GRAPHICS_REGS] = {
+    0x0000, 0x0001, 0x0002, 0x0003, 0x0004, 0x1005, 0x0E06, 0x0007,
+    0xFF08
+};
+
+/* the 64 KB window all four planes are reached through */
+static uint8_t* const modex_mem = (uint8_t*)MODEX_BASE_ADDR;
+
+static int32_t vga_refs = 0;        /* descriptors open on the device */
+
+/* text mode state mode X writes over, saved by vga_open */
+static uint8_t font_save[FONT_CHARS][FONT_HEIGHT];
+static uint8_t palette_save[TEXT_PALETTE_SIZE][3];
+
+static void vga_dup(file_desc_t* file);
+
+static fops_t vga_ops = {vga_open, vga_close, NULL, NULL, vga_dup, vga_ioctl};
+
+/*
+ * vga_blank
+ * DESCRIPTION: blank or unblank the display
+ * INPUTS: blank -- 1 to blank, 0 to unblank
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: leaves the attribute controller enabled
+ */
+static void vga_blank(int32_t blank)
+{
+    outb(0x01, VGA_SEQ);
+    outb((inb(VGA_SEQ + 1) & 0xDF) | ((blank & 1) << 5), VGA_SEQ + 1);
+
+    /* reading the status resets the attribute port to index, 0x20 enables */
+    (void)inb(VGA_INPUT_STATUS);
+    outb(0x20, VGA_ATTR);
+}
+
+/*
+ * set_seq_regs_and_reset
+ * DESCRIPTION: load the sequencer, which the table holds in reset, and
+ *              the miscellaneous output register, then restart it
+ * INPUTS: table -- sequencer register values
+ *         misc  -- miscellaneous output register value
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: none
+ */
+static void set_seq_regs_and_reset(uint16_t table[NUM_SEQUENCER_REGS], uint8_t misc)
+{
+    int i;
+
+    for (i = 0; i < NUM_SEQUENCER_REGS; i++)
+        outw(table[i], VGA_SEQ);
+
+    /* let the sequencer settle in reset */
+    {volatile int ii; for (ii = 0; ii < 10000; ii++);}
+
+    outb(misc, VGA_MISC_WRITE);
+    outw(0x0300, VGA_SEQ);
+}
+
+/*
+ * set_CRTC_registers
+ * DESCRIPTION: load the CRT controller registers
+ * INPUTS: table -- CRTC register values
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: none
+ */
+static void set_CRTC_registers(uint16_t table[NUM_CRTC_REGS])
+{
+    int i;
+
+    /* clear the protection bit so the first few registers take writes */
+    outw(0x0011, VGA_CRTC);
+    for (i = 0; i < NUM_CRTC_REGS; i++)
+        outw(table[i], VGA_CRTC);
+}
+
+/*
+ * set_attr_registers
+ * DESCRIPTION: load the attribute registers, index and value bytes
+ *              alternate on a single port
+ * INPUTS: table -- index, value pairs
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: none
+ */
+static void set_attr_registers(uint8_t table[NUM_ATTR_REGS * 2])
+{
+    int i;
+
+    (void)inb(VGA_INPUT_STATUS);
+    for (i = 0; i < NUM_ATTR_REGS * 2; i++)
+        outb(table[i], VGA_ATTR);
+}
+
+/*
+ * set_graphics_registers
+ * DESCRIPTION: load the graphics controller registers
+ * INPUTS: table -- graphics register values
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: none
+ */
+static void set_graphics_registers(uint16_t table[NUM_GRAPHICS_REGS])
+{
+    int i;
+
+    for (i = 0; i < NUM_GRAPHICS_REGS; i++)
+        outw(table[i], VGA_GC);
+}
+
+/*
+ * font_access
+ * DESCRIPTION: point the window at plane 2, where text mode keeps the
+ *              font, or back at the text screen
+ * INPUTS: on -- 1 for the font plane, 0 for text mode
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: call with interrupts disabled
+ */
+static void font_access(int32_t on)
+{
+    if (on) {
+        outw(0x0402, VGA_SEQ);
+        outw(0x0704, VGA_SEQ);
+        outw(0x0005, VGA_GC);
+        outw(0x0406, VGA_GC);
+        outw(0x0204, VGA_GC);
+    } else {
+        outw(0x0302, VGA_SEQ);
+        outw(0x0304, VGA_SEQ);
+        outw(0x1005, VGA_GC);
+        outw(0x0E06, VGA_GC);
+        outw(0x0004, VGA_GC);
+    }
+}
+
+/*
+ * set_mode_X
+ * DESCRIPTION: save the font and text palette, then switch to mode X
+ *              with all four planes cleared
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: the console stops drawing until set_text_mode_3
+ */
+static void set_mode_X(void)
+{
+    uint32_t flags;
+    int i;
+
+    console_suspend();
+
+    cli_and_save(flags);
+    font_access(1);
+    for (i = 0; i < FONT_CHARS; i++)
+        memcpy(font_save[i], modex_mem + i * FONT_STRIDE, FONT_HEIGHT);
+    font_access(0);
+
+    outb(0, VGA_DAC_READ);
+    for (i = 0; i < TEXT_PALETTE_SIZE * 3; i++)
+        palette_save[i / 3][i % 3] = inb(VGA_DAC_DATA);
+
+    vga_blank(1);
+    set_seq_regs_and_reset(mode_X_seq, 0x63);
+    set_CRTC_registers(mode_X_CRTC);
+    set_attr_registers(mode_X_attr);
+    set_graphics_registers(mode_X_graphics);
+    restore_flags(flags);
+
+    /* mode_X_seq leaves all planes selected */
+    memset(modex_mem, 0, MODEX_MEM_SIZE);
+    vga_blank(0);
+}
+
+/*
+ * set_text_mode_3
+ * DESCRIPTION: go back to color text mode with the font and palette
+ *              set_mode_X saved, and redraw the console
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: the console draws again
+ */
+static void set_text_mode_3(void)
+{
+    uint32_t flags;
+    int i;
+
+    cli_and_save(flags);
+    vga_blank(1);
+    set_seq_regs_and_reset(text_seq, 0x67);
+    set_CRTC_registers(text_CRTC);
+    set_attr_registers(text_attr);
+    set_graphics_registers(text_graphics);
+
+    outb(0, VGA_DAC_WRITE);
+    for (i = 0; i < TEXT_PALETTE_SIZE * 3; i++)
+        outb(palette_save[i / 3][i % 3], VGA_DAC_DATA);
+
+    font_access(1);
+    for (i = 0; i < FONT_CHARS; i++)
+        memcpy(modex_mem + i * FONT_STRIDE, font_save[i], FONT_HEIGHT);
+    font_access(0);
+    vga_blank(0);
+    restore_flags(flags);
+
+    console_resume();
+}
+
+/*
+ * vga_dup
+ * DESCRIPTION: count a descriptor copied by dup2 or inherited by a child
+ * INPUTS: file -- the new descriptor
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: none
+ */
+static void vga_dup(file_desc_t* file)
+{
+    vga_refs++;
+}
+
+/*
+ * vga_open
+ * DESCRIPTION: give the caller a descriptor for the VGA and switch it
+ *              to mode X
+ * INPUTS: filename -- not used
+ * OUTPUTS: none
+ * RETURN VALUE: the descriptor, -1 if the device is open already or
+ *               there is no free slot
+ * SIDE EFFECTS: the text console disappears until the device is closed
+ */
+int32_t vga_open(const uint8_t* filename)
+{
+    pcb_t* pcb = get_pcb_ptr();
+    int32_t fd;
+
+    if (vga_refs)
+        return FFAIL;
+
+    for (fd = 0; fd < FILE_DESC_SIZE; fd++) {
+        if (pcb->file_desc_array[fd].flags == !IN_USE)
+            break;
+    }
+    if (fd == FILE_DESC_SIZE)
+        return FFAIL;
+
+    pcb->file_desc_array[fd].inode = NULL;
+    pcb->file_desc_array[fd].file_pos = 0;
+    pcb->file_desc_array[fd].flags = IN_USE;
+    pcb->file_desc_array[fd].file_ops = &vga_ops;
+
+    vga_refs = 1;
+    set_mode_X();
+    return fd;
+}
+
+/*
+ * vga_close
+ * DESCRIPTION: free a VGA descriptor, back to text mode with the last
+ * INPUTS: fd -- descriptor to free
+ * OUTPUTS: none
+ * RETURN VALUE: 0
+ * SIDE EFFECTS: unmaps the mode X window from a task that no longer
+ *               holds the device
+ */
+int32_t vga_close(int32_t fd)
+{
+    pcb_t* pcb = get_pcb_ptr();
+
+    pcb->file_desc_array[fd].flags = !IN_USE;
+    if (!vga_held() && pcb->is_vgamapped) {
+        pcb->is_vgamapped = 0;
+        unmap_modex();
+    }
+
+    if (--vga_refs == 0)
+        set_text_mode_3();
+    return FSUCCESS;
+}
+
+/*
+ * vga_ioctl
+ * DESCRIPTION: mode X requests
+ *              VGA_SET_PLANES -- send writes to the window to the planes
+ *                                in the low 4 bits of arg
+ *              VGA_FLIP       -- show the page at offset arg of each
+ *                                plane, once the current frame is done
+ *              VGA_SET_COLOR  -- set palette entry arg >> 24 to the 6 bit
+ *                                red, green and blue in the low 3 bytes
+ * INPUTS: fd  -- not used
+ *         cmd -- request
+ *         arg -- argument of the request
+ * OUTPUTS: none
+ * RETURN VALUE: 0, -1 for an unknown request or a bad argument
+ * SIDE EFFECTS: VGA_FLIP sleeps until the vertical retrace, so the page
+ *               shown before is free to draw into when it returns
+ */
+int32_t vga_ioctl(int32_t fd, uint32_t cmd, uint32_t arg)
+{
+    uint32_t flags;
+    uint32_t start;
+
+    switch (cmd) {
+        case VGA_SET_PLANES:
+            if (arg & ~MODEX_ALL_PLANES)
+                return FFAIL;
+            outw((arg << 8) | VGA_SEQ_MAP_MASK, VGA_SEQ);
+            return FSUCCESS;
+
+        case VGA_FLIP:
+            if (arg >= MODEX_MEM_SIZE)
+                return FFAIL;
+            /* the start address is latched as a retrace begins, keep the
+               two halves out of one */
+            cli_and_save(flags);
+            while (inb(VGA_INPUT_STATUS) & VGA_VRETRACE);
+            outw((arg & 0xFF00) | VGA_CRTC_START_HI, VGA_CRTC);
+            outw(((arg << 8) & 0xFF00) | VGA_CRTC_START_LO, VGA_CRTC);
+            restore_flags(flags);
+
+            /* the next retrace latches it, a frame from now at most; the
+               pulse is too short to catch every time, so sleep a tick at
+               a time until it is seen or a whole frame has gone by */
+            start = jiffies;
+            while (!(inb(VGA_INPUT_STATUS) & VGA_VRETRACE) &&
+                   jiffies - start < VGA_FRAME_TICKS)
+                (void)timer_sleep(&get_pcb_ptr()->sleep_timer, 1);
+            return FSUCCESS;
+
+        case VGA_SET_COLOR:
+            cli_and_save(flags);
+            outb(arg >> 24, VGA_DAC_WRITE);
+            outb((arg >> 16) & 0x3F, VGA_DAC_DATA);
+            outb((arg >> 8) & 0x3F, VGA_DAC_DATA);
+            outb(arg & 0x3F, VGA_DAC_DATA);
+            restore_flags(flags);
+            return FSUCCESS;
+
+        default:
+            return FFAIL;
+    }
+}
+
+/*
+ * vga_held
+ * DESCRIPTION: check if the current task has a VGA descriptor
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: 1 if it does, 0 if not
+ * SIDE EFFECTS: none
+ */
+int32_t vga_held(void)
+{
+    pcb_t* pcb = get_pcb_ptr();
+    int32_t fd;
+
+    for (fd = 0; fd < FILE_DESC_SIZE; fd++) {
+        if (pcb->file_desc_array[fd].flags == IN_USE &&
+            pcb->file_desc_array[fd].file_ops == &vga_ops)
+            return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,85 @@
+/*
+ * VGA mode X driver
+ *
+ * Opening the device file "vga" switches the VGA from text mode to
+ * mode X (320x200, 256 colors, unchained), with the register tables of
+ * the mp2 game.  The 256 KB of video memory is split in four planes
+ * that share the 64 KB window at 0xA0000; vgamap maps that window into
+ * the task and VGA_SET_PLANES picks which planes its writes go to.
+ * One 320x200 page takes MODEX_PAGE_SIZE bytes of each plane, so four
+ * pages fit and a program can draw into one while another is shown;
+ * VGA_FLIP moves the CRTC start address to the page just drawn and
+ * sleeps until it is on screen, at the vertical retrace.
+ *
+ * The console keeps collecting output while the VGA is in mode X and
+ * is drawn again when the last descriptor is closed, with the font
+ * and the palette entries saved when the device was opened.  Only one
+ * task at a time can open the device, its children inherit it.
+ *
+ * References Used:
+ *      mp2 modex.c (mode_X_seq, mode_X_CRTC, text_seq, ...)
+ *      https://wiki.osdev.org/VGA_Hardware
+ *      Michael Abrash's Graphics Programming Black Book, chapter 47
+ */
+
+#ifndef VGA_H
+#define VGA_H
+
+#include <types.h>
+
+/* vga_ioctl commands */
+#define VGA_SET_PLANES      1       /* arg: mask of the planes writes go to */
+#define VGA_FLIP            2       /* arg: offset of the page to show */
+#define VGA_SET_COLOR       3       /* arg: index << 24 | r << 16 | g << 8 | b */
+
+#define MODEX_X_DIM         320
+#define MODEX_Y_DIM         200
+#define MODEX_PAGE_SIZE     (MODEX_X_DIM / 4 * MODEX_Y_DIM)
+#define MODEX_MEM_SIZE      65536   /* bytes per plane */
+#define MODEX_ALL_PLANES    0x0F
+#define VGA_FRAME_TICKS     15      /* one 70 Hz frame, rounded up to ticks */
+
+/* VGA ports */
+#define VGA_ATTR            0x3C0
+#define VGA_MISC_WRITE      0x3C2
+#define VGA_SEQ             0x3C4
+#define VGA_DAC_READ        0x3C7
+#define VGA_DAC_WRITE       0x3C8
+#define VGA_DAC_DATA        0x3C9
+#define VGA_GC              0x3CE
+#define VGA_CRTC            0x3D4
+#define VGA_INPUT_STATUS    0x3DA   /* reading it also resets VGA_ATTR to index */
+
+#define VGA_VRETRACE        0x08    /* VGA_INPUT_STATUS: in vertical retrace */
+#define VGA_CRTC_START_HI   0x0C
+#define VGA_CRTC_START_LO   0x0D
+#define VGA_SEQ_MAP_MASK    0x02
+
+#define NUM_SEQUENCER_REGS  5
+#define NUM_CRTC_REGS       25
+#define NUM_GRAPHICS_REGS   9
+#define NUM_ATTR_REGS       22
+
+/* what text mode needs back after mode X wrote over all four planes */
+#define FONT_CHARS          256
+#define FONT_HEIGHT         16
+#define FONT_STRIDE         32      /* bytes per character in plane 2 */
+#define TEXT_PALETTE_SIZE   64      /* DAC entries the text attributes use */
+
+/*
+ *  VGA DRIVER FUNCTIONS
+ */
+
+/* switch to mode X, -1 if another task has the device */
+int32_t vga_open(const uint8_t* filename);
+
+/* back to text mode once the last descriptor is gone */
+int32_t vga_close(int32_t fd);
+
+/* plane selection, page flips and palette changes */
+int32_t vga_ioctl(int32_t fd, uint32_t cmd, uint32_t arg);
+
+/* check if the current task has the device open, so it may map it */
+int32_t vga_held(void);
+
+#endif /* VGA_H */
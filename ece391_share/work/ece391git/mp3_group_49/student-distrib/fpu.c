@@ -0,0 +1,154 @@
+#include "fpu.h"
+#include "lib.h"
+
+int32_t cpu_has_sse2 = 0;
+int32_t cpu_has_erms = 0;
+
+/* what xmm0 up held before kernel_fpu_begin, only one user at a time */
+static uint8_t fpu_save[KERNEL_FPU_REGS * 16] __attribute__((aligned(16)));
+
+/* the state right after fninit, every new task starts from it */
+static uint8_t fpu_clean[FPU_STATE_SIZE] __attribute__((aligned(16)));
+
+/*
+ * init_fpu
+ * DESCRIPTION: look for FXSR, SSE2 and ERMS, enable the x87 unit and,
+ *              if SSE2 is there, the SSE unit as well
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: user programs may use the FPU and SSE from now on, the
+ *               scheduler saves their registers at every switch
+ */
+void init_fpu(void)
+{
+    uint32_t eax, ebx, ecx, edx;
+
+    eax = 0;
+    ecx = 0;
+    asm volatile ("cpuid" : "+a"(eax), "=b"(ebx), "+c"(ecx), "=d"(edx));
+    if (eax >= 7) {
+        eax = 7;
+        ecx = 0;
+        asm volatile ("cpuid" : "+a"(eax), "=b"(ebx), "+c"(ecx), "=d"(edx));
+        cpu_has_erms = !!(ebx & CPUID7_EBX_ERMS);
+    }
+
+    edx = cpuid_edx(1);
+    if ((edx & (CPUID_EDX_FXSR | CPUID_EDX_SSE2)) == (CPUID_EDX_FXSR | CPUID_EDX_SSE2)) {
+        asm volatile ("             \n\
+            movl %%cr4, %%eax       \n\
+            orl  %0, %%eax          \n\
+            movl %%eax, %%cr4"
+            :
+            : "i"(CR4_OSFXSR | CR4_OSXMMEXCPT)
+            : "eax", "memory"
+        );
+        cpu_has_sse2 = 1;
+    }
+
+    asm volatile ("                 \n\
+        movl %%cr0, %%eax           \n\
+        andl %0, %%eax              \n\
+        orl  %1, %%eax              \n\
+        movl %%eax, %%cr0           \n\
+        fninit"
+        :
+        : "i"(~(CR0_EM | CR0_TS)), "i"(CR0_MP | CR0_NE)
+        : "eax", "memory"
+    );
+    fpu_save_state(fpu_clean);
+}
+
+/*
+ * fpu_save_state
+ * DESCRIPTION: store the x87 and SSE registers of the running task
+ * INPUTS: none
+ * OUTPUTS: state -- FPU_STATE_SIZE bytes, 16 byte aligned
+ * RETURN VALUE: none
+ * SIDE EFFECTS: without FXSR, fnsave also resets the x87 unit
+ */
+void fpu_save_state(uint8_t* state)
+{
+    if (cpu_has_sse2)
+        asm volatile ("fxsave (%0)" : : "r"(state) : "memory");
+    else
+        asm volatile ("fnsave (%0)" : : "r"(state) : "memory");
+}
+
+/*
+ * fpu_restore_state
+ * DESCRIPTION: load registers fpu_save_state or fpu_init_state wrote
+ * INPUTS: state -- FPU_STATE_SIZE bytes, 16 byte aligned
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: none
+ */
+void fpu_restore_state(const uint8_t* state)
+{
+    if (cpu_has_sse2)
+        asm volatile ("fxrstor (%0)" : : "r"(state) : "memory");
+    else
+        asm volatile ("frstor (%0)" : : "r"(state) : "memory");
+}
+
+/*
+ * fpu_init_state
+ * DESCRIPTION: give a new task the registers of a freshly reset FPU
+ * INPUTS: none
+ * OUTPUTS: state -- the task's save area
+ * RETURN VALUE: none
+ * SIDE EFFECTS: none
+ */
+void fpu_init_state(uint8_t* state)
+{
+    memcpy(state, fpu_clean, FPU_STATE_SIZE);
+}
+
+/*
+ * kernel_fpu_begin
+ * DESCRIPTION: make xmm0 to xmm3 free for the kernel
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: the interrupt flag to hand to kernel_fpu_end
+ * SIDE EFFECTS: interrupts stay off until kernel_fpu_end, keep the
+ *               work in between short
+ */
+uint32_t kernel_fpu_begin(void)
+{
+    uint32_t flags;
+
+    cli_and_save(flags);
+    asm volatile ("                 \n\
+        movdqa %%xmm0,   (%0)       \n\
+        movdqa %%xmm1, 16(%0)       \n\
+        movdqa %%xmm2, 32(%0)       \n\
+        movdqa %%xmm3, 48(%0)"
+        :
+        : "r"(fpu_save)
+        : "memory"
+    );
+    return flags;
+}
+
+/*
+ * kernel_fpu_end
+ * DESCRIPTION: put back the xmm registers kernel_fpu_begin saved
+ * INPUTS: flags -- what kernel_fpu_begin returned
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: interrupts are on again if they were before
+ */
+void kernel_fpu_end(uint32_t flags)
+{
+    asm volatile ("                 \n\
+        movdqa   (%0), %%xmm0       \n\
+        movdqa 16(%0), %%xmm1       \n\
+        movdqa 32(%0), %%xmm2       \n\
+        movdqa 48(%0), %%xmm3"
+        :
+        : "r"(fpu_save)
+        : "memory"
+    );
+    restore_flags(flags);
+}
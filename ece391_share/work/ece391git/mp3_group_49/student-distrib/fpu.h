@@ -0,0 +1,70 @@
+/*
+ * FPU and SSE setup for the kernel
+ *
+ * init_fpu turns on the x87 unit (CR0.EM off) and, when the cpu has
+ * FXSR and SSE2, the SSE unit (CR4.OSFXSR and OSXMMEXCPT on).  It also
+ * notes whether the cpu has fast string moves (ERMS), so memcpy and
+ * memset can pick how to copy.  Every task has its own save area in
+ * its PCB; switch_to stores the registers of the task going out with
+ * fxsave (fnsave without FXSR) and loads those of the one coming in,
+ * so tasks never see each other's FPU or SSE state.
+ *
+ * The kernel uses SSE registers only between kernel_fpu_begin and
+ * kernel_fpu_end: interrupts are off in between, so nothing can switch
+ * tasks or nest another SSE user, and the xmm registers the copy loops
+ * clobber are saved and put back, so whatever a program kept in them
+ * survives its system calls.
+ *
+ * References Used:
+ *      Intel SDM Vol. 3A 13.1 (Initialization of the SSE extensions)
+ *      Intel SDM Vol. 1 10.5 (FXSAVE and FXRSTOR)
+ *      Linux arch/x86/include/asm/fpu/api.h (kernel_fpu_begin)
+ */
+
+#ifndef FPU_H
+#define FPU_H
+
+#include "types.h"
+
+/* cpuid leaf 1 edx */
+#define CPUID_EDX_FXSR      (1 << 24)
+#define CPUID_EDX_SSE2      (1 << 26)
+/* cpuid leaf 7 ebx */
+#define CPUID7_EBX_ERMS     (1 << 9)
+
+#define CR0_MP              (1 << 1)
+#define CR0_EM              (1 << 2)
+#define CR0_TS              (1 << 3)
+#define CR0_NE              (1 << 5)
+#define CR4_OSFXSR          (1 << 9)
+#define CR4_OSXMMEXCPT      (1 << 10)
+
+/* xmm registers the kernel copy loops use, xmm0 up */
+#define KERNEL_FPU_REGS     4
+
+/* fxsave area, fnsave needs only the first 108 bytes */
+#define FPU_STATE_SIZE      512
+
+/* set by init_fpu */
+extern int32_t cpu_has_sse2;        /* SSE2 is on, memcpy may use it */
+extern int32_t cpu_has_erms;        /* rep movsb/stosb are the fast way */
+
+/* find out what the cpu has and switch the FPU and SSE on */
+void init_fpu(void);
+
+/* store the running task's FPU and SSE registers */
+void fpu_save_state(uint8_t* state);
+
+/* load a task's FPU and SSE registers back */
+void fpu_restore_state(const uint8_t* state);
+
+/* fill a new task's save area with the state after a reset */
+void fpu_init_state(uint8_t* state);
+
+/* claim the SSE registers, returns the flags for kernel_fpu_end */
+uint32_t kernel_fpu_begin(void);
+
+/* give them back to whoever had them */
+void kernel_fpu_end(uint32_t flags);
+
+#endif /* FPU_H */
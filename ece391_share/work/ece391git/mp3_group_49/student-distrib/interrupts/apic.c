@@ -0,0 +1,111 @@
+#include "apic.h"
+#include "interrupts.h"
+
+#include <lib.h>
+#include <paging.h>
+
+/* full count of the timer, where calibration starts */
+#define LAPIC_COUNT_MAX         0xFFFFFFFF
+
+/* register block, NULL while there is no APIC */
+static volatile uint8_t* lapic;
+
+/* register access */
+static inline uint32_t lapic_read(uint32_t reg)
+{
+    return *(volatile uint32_t*)(lapic + reg);
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t val)
+{
+    *(volatile uint32_t*)(lapic + reg) = val;
+}
+
+/*
+ * init_lapic
+ * DESCRIPTION: find the local APIC, map its registers and enable it
+ *              with the timer masked
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if the cpu has no local APIC
+ * SIDE EFFECTS: call after init_paging; leaves the 8259s in charge
+ *               of every other interrupt
+ */
+int32_t init_lapic()
+{
+    uint64_t base;
+
+    if (!(cpuid_edx(1) & CPUID_EDX_APIC))
+        return FFAIL;
+
+    base = rdmsr(MSR_APIC_BASE);
+    wrmsr(MSR_APIC_BASE, base | APIC_BASE_ENABLE);
+    lapic = (volatile uint8_t*)((uint32_t)base & APIC_BASE_MASK);
+    map_mmio((uint32_t*)lapic);
+
+    /* accept every priority, then switch the APIC on */
+    lapic_write(LAPIC_TPR, 0);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | LAPIC_SPURIOUS_VEC);
+
+    return FSUCCESS;
+}
+
+/*
+ * lapic_timer_count_start
+ * DESCRIPTION: load the timer with its largest count, one-shot and
+ *              masked, so it can be read against another clock
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: stops a running periodic timer
+ */
+void lapic_timer_count_start()
+{
+    lapic_write(LAPIC_TIMER_DIV, LAPIC_DIV_16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_TIMER_INIT, LAPIC_COUNT_MAX);
+}
+
+/*
+ * lapic_timer_count_elapsed
+ * DESCRIPTION: how far the timer counted down since
+ *              lapic_timer_count_start
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: elapsed timer counts
+ * SIDE EFFECTS: none
+ */
+uint32_t lapic_timer_count_elapsed()
+{
+    return LAPIC_COUNT_MAX - lapic_read(LAPIC_TIMER_CUR);
+}
+
+/*
+ * lapic_timer_periodic
+ * DESCRIPTION: run the timer periodically on the vector of
+ *              LAPIC_TIMER_IRQ
+ * INPUTS: count -- timer counts between interrupts
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: the first interrupt comes count timer counts from now
+ */
+void lapic_timer_periodic(uint32_t count)
+{
+    lapic_write(LAPIC_TIMER_DIV, LAPIC_DIV_16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_PERIODIC | (INTR_ADDR_START + LAPIC_TIMER_IRQ));
+    lapic_write(LAPIC_TIMER_INIT, count);
+}
+
+/*
+ * lapic_eoi
+ * DESCRIPTION: tell the APIC the current interrupt is handled
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: none
+ */
+void lapic_eoi()
+{
+    lapic_write(LAPIC_EOI, 0);
+}
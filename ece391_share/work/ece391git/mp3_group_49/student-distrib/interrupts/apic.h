@@ -0,0 +1,65 @@
+/*
+ * Local APIC, used for its timer
+ *
+ * The 8259s keep delivering the device interrupts (the BIOS leaves
+ * LINT0 in virtual wire mode); the local APIC is only switched on for
+ * its timer, which can replace the PIT as the tick.  Its rate depends
+ * on the bus clock, so clocksource.c measures it against the PIT first.
+ * The timer shows up as IRQ LAPIC_TIMER_IRQ in the IRQ table and is
+ * acknowledged at the APIC, not at the PIC.
+ *
+ * References Used:
+ *      Intel SDM Vol. 3 chapter 10, Advanced Programmable Interrupt Controller
+ *      https://wiki.osdev.org/APIC
+ *      https://wiki.osdev.org/APIC_timer
+ */
+
+#ifndef APIC_H
+#define APIC_H
+
+#include <types.h>
+
+/* where the APIC's registers are, and the enable bit, in IA32_APIC_BASE */
+#define MSR_APIC_BASE           0x1B
+#define APIC_BASE_ENABLE        0x800
+#define APIC_BASE_MASK          0xFFFFF000
+
+/* cpuid leaf 1 edx: on-chip APIC */
+#define CPUID_EDX_APIC          (1 << 9)
+
+/* register offsets */
+#define LAPIC_TPR               0x80
+#define LAPIC_EOI               0xB0
+#define LAPIC_SVR               0xF0
+#define LAPIC_LVT_TIMER         0x320
+#define LAPIC_TIMER_INIT        0x380
+#define LAPIC_TIMER_CUR         0x390
+#define LAPIC_TIMER_DIV         0x3E0
+
+/* spurious vector register: software enable, spurious interrupts go to 0xFF */
+#define LAPIC_SVR_ENABLE        0x100
+#define LAPIC_SPURIOUS_VEC      0xFF
+
+/* LVT timer bits */
+#define LAPIC_LVT_MASKED        0x10000
+#define LAPIC_LVT_PERIODIC      0x20000
+
+/* timer counts bus clocks divided by 16 */
+#define LAPIC_DIV_16            0x3
+
+/* map and enable the local APIC, -1 if the cpu has none */
+int32_t init_lapic(void);
+
+/* start the timer counting down from its maximum, masked, for calibration */
+void lapic_timer_count_start(void);
+
+/* timer counts since lapic_timer_count_start */
+uint32_t lapic_timer_count_elapsed(void);
+
+/* fire the timer interrupt every count timer counts */
+void lapic_timer_periodic(uint32_t count);
+
+/* acknowledge the interrupt in service */
+void lapic_eoi(void);
+
+#endif /* APIC_H */
@@ -4,6 +4,7 @@
 #include <x86_desc.h>
 #include <lib.h>
 #include <syscall/syscalls.h>
+#include <syscall/process.h>
 
 
 /*
@@ -114,7 +115,7 @@ void do_exception(int n) {
     }
     // blue screen of death placeholder
     // while(1);
-    halt(0);
+    end_process(EXCEPTION_STATUS);
 }
 
 
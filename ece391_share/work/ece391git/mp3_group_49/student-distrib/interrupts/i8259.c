@@ -155,3 +155,38 @@ void send_eoi(uint32_t irq_num) {
         outb(irq_num|EOI,MASTER_8259_PORT);
     }
 }
+
+/*
+ * i8259_spurious
+ * DESCRIPTION: Tell a spurious IRQ7/IRQ15 from a real one.  A line
+ *              that drops before the CPU acknowledges it is reported
+ *              as the lowest priority line of its chip without the
+ *              in-service bit being set.
+ * REFERENCE: https://wiki.osdev.org/PIC  section: Spurious IRQs
+ * INPUTS: irq_num -- between 0 and 15, id of irq
+ * OUTPUTS: none
+ * RETURN VALUE: 1 if the IRQ is spurious and must not get an EOI, 0 otherwise
+ * SIDE EFFECTS: a spurious IRQ15 is still acknowledged on the master,
+ *               which did see a real interrupt from the cascade pin
+ */
+int32_t i8259_spurious(uint32_t irq_num) {
+    uint16_t port;
+
+    if (irq_num == SPURIOUS_MASTER) {
+        port = MASTER_8259_PORT;
+    } else if (irq_num == SPURIOUS_SLAVE) {
+        port = SLAVE_8259_PORT;
+    } else {
+        return 0;
+    }
+
+    /* real interrupt if the chip has it in service */
+    outb(OCW3_READ_ISR, port);
+    if (inb(port) & (1 << (irq_num % NUM_IRQS)))
+        return 0;
+
+    if (irq_num == SPURIOUS_SLAVE)
+        outb(IRQ2_SLAVE_PIN|EOI, MASTER_8259_PORT);
+
+    return 1;
+}
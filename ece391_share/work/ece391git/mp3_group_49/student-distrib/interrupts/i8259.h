@@ -32,6 +32,13 @@
  * to declare the interrupt finished */
 #define EOI                 0x60
 
+/* OCW3 asking the next read of the command port for the in-service register */
+#define OCW3_READ_ISR       0x0B
+
+/* lowest priority line of each chip, where spurious interrupts show up */
+#define SPURIOUS_MASTER     7
+#define SPURIOUS_SLAVE      15
+
 
 /* Mask all interrupts */
 #define MASK_ALL 0xFF
@@ -46,5 +53,7 @@ void enable_irq(uint32_t irq_num);
 void disable_irq(uint32_t irq_num);
 /* Send end-of-interrupt signal for the specified IRQ */
 void send_eoi(uint32_t irq_num);
+/* Check whether an IRQ is spurious, acknowledging the master if needed */
+int32_t i8259_spurious(uint32_t irq_num);
 
 #endif /* _I8259_H */
@@ -2,47 +2,183 @@
 
 #include <x86_desc.h>
 #include <lib.h>
-#include <drivers/terminal.h>
-#include <drivers/keyboard.h>
-#include <drivers/rtc.h>
 #include <interrupts/i8259.h>
+#include <interrupts/apic.h>
+#include <interrupts/tasklet.h>
 
 /*
  * Exceptions: The following is a list of interrupts in IDT
  * Implementation of these assembly functions can be found in Handlers.S.
  */
-void keyboard_interrupt(void);
-void rtc_interrupt (void);
+extern void (*irq_stubs[NR_IRQS])(void);
+
+void lapic_spurious_interrupt(void);
 
 void sys_call(void);
+void sysenter_entry(void);
+
+/* one registered handler, chained per line */
+typedef struct irq_action_t {
+    irq_handler_t handler;          /* NULL while the entry is free */
+    void* dev;
+    struct irq_action_t* next;
+} irq_action_t;
+
+static irq_action_t irq_action_pool[IRQ_ACTIONS];
+static irq_action_t* irq_chain[NR_IRQS];
+static irq_stat_t irq_stats[NR_IRQS];
+
+/*
+ * request_irq
+ * DESCRIPTION: add a handler to the end of an IRQ line's chain
+ * INPUTS: irq     -- line, 0 to NR_IRQS - 1
+ *         handler -- called on every interrupt of the line
+ *         dev     -- handed back to handler, identifies it to free_irq
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 on a bad line or a full pool
+ * SIDE EFFECTS: unmasks a PIC line if this is its first handler; the
+ *               APIC timer is unmasked by whoever programs it
+ */
+int32_t request_irq(uint32_t irq, irq_handler_t handler, void* dev){
+    irq_action_t* action = NULL;
+    irq_action_t** link;
+    uint32_t flags;
+    int i;
+
+    if (irq >= NR_IRQS || !handler)
+        return FFAIL;
+
+    cli_and_save(flags);
+    for (i = 0; i < IRQ_ACTIONS; i++) {
+        if (!irq_action_pool[i].handler) {
+            action = &irq_action_pool[i];
+            break;
+        }
+    }
+    if (!action) {
+        restore_flags(flags);
+        return FFAIL;
+    }
+
+    action->handler = handler;
+    action->dev = dev;
+    action->next = NULL;
+    for (link = &irq_chain[irq]; *link; link = &(*link)->next);
+    *link = action;
+
+    if (action == irq_chain[irq] && irq < NR_PIC_IRQS)
+        enable_irq(irq);
+    restore_flags(flags);
+
+    return FSUCCESS;
+}
+
+/*
+ * free_irq
+ * DESCRIPTION: take a handler off an IRQ line's chain
+ * INPUTS: irq -- line the handler was registered on
+ *         dev -- the dev it was registered with
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if no such handler is registered
+ * SIDE EFFECTS: masks a PIC line once its chain is empty
+ */
+int32_t free_irq(uint32_t irq, void* dev){
+    irq_action_t** link;
+    irq_action_t* action;
+    uint32_t flags;
+
+    if (irq >= NR_IRQS)
+        return FFAIL;
+
+    cli_and_save(flags);
+    for (link = &irq_chain[irq]; *link; link = &(*link)->next) {
+        if ((*link)->dev == dev)
+            break;
+    }
+    if (!*link) {
+        restore_flags(flags);
+        return FFAIL;
+    }
+
+    action = *link;
+    *link = action->next;
+    action->handler = NULL;
+
+    if (!irq_chain[irq] && irq < NR_PIC_IRQS)
+        disable_irq(irq);
+    restore_flags(flags);
+
+    return FSUCCESS;
+}
+
+/*
+ * irq_get_stats
+ * DESCRIPTION: snapshot the statistics of every line
+ * INPUTS: none
+ * OUTPUTS: out -- NR_IRQS entries, indexed by IRQ number
+ * RETURN VALUE: none
+ * SIDE EFFECTS: none
+ */
+void irq_get_stats(irq_stat_t* out){
+    uint32_t flags;
+
+    cli_and_save(flags);
+    memcpy(out, irq_stats, sizeof(irq_stats));
+    restore_flags(flags);
+}
 
 /*
  * do_IRQ
  * DESCRIPTION: handle all interrupts passed in from
  *              common exception handler in handlers.S
- * INPUTS: irqn -- can be mapped to irq address
- * OUTPUTS: name of exception
+ * INPUTS: irqn -- negative IRQ number
+ * OUTPUTS: none
  * RETURN VALUE: none
- * SIDE EFFECTS: kernel gets stuck in some sort of
- *               "blue screen of death"
+ * SIDE EFFECTS: runs the line's handler chain and acknowledges the
+ *               PIC or the APIC; records how long the top half kept interrupts
+ *               off, heavy work is left to tasklets run after this returns
  */
 void do_IRQ(int irqn){
+    uint64_t start = rdtsc();
+    irq_stat_t* stat;
+    irq_action_t* action;
+    int32_t handled = IRQ_NONE;
+    uint32_t irq;
+    uint32_t cycles;
+
     /* 
      * recall that handlers.S sends
      * -1 * <offset from 0x20> of irq
      */
-    irqn = INTR_ADDR_START - irqn; //map to irq addr
-    /* select handler to redirect to */
-    switch (irqn) {
-        case INTR_ADDR_KEYB:
-            handle_keyboard();
-            break;
-        case INTR_ADDR_RTC:
-            handle_rtc();
-            break;
-        default:
-            printf("Unhandled IRQ %d\n", irqn);
+    irq = -irqn;
+    if (irq >= NR_IRQS) {
+        printf("Unhandled IRQ %d\n", irq);
+        return;
+    }
+    stat = &irq_stats[irq];
+
+    if (i8259_spurious(irq)) {
+        stat->spurious++;
+        return;
     }
+
+    for (action = irq_chain[irq]; action; action = action->next)
+        handled |= action->handler(irq, action->dev);
+    if (handled == IRQ_NONE)
+        stat->unhandled++;
+
+    if (irq < NR_PIC_IRQS)
+        send_eoi(irq);
+    else
+        lapic_eoi();
+
+    cycles = (uint32_t)(rdtsc() - start);
+    stat->count++;
+    stat->cycles += cycles;
+    if (cycles > stat->max_cycles)
+        stat->max_cycles = cycles;
+
+    tasklet_account_irq(cycles);
 }
 
 /*
@@ -51,11 +187,23 @@ void do_IRQ(int irqn){
  * INPUTS: none
  * OUTPUTS: none
  * RETURN VALUE: none
- * SIDE EFFECTS: none
+ * SIDE EFFECTS: points the sysenter MSRs at sysenter_entry
  */
 void init_idt_interrupts(){
-    /* add interrupts to IDT */
-    add_interrupt(INTR_ADDR_KEYB, &keyboard_interrupt);
-    add_interrupt(INTR_ADDR_RTC, &rtc_interrupt);
+    int i;
+
+    /* add interrupts to IDT, drivers hook in with request_irq */
+    for (i = 0; i < NR_IRQS; i++)
+        add_interrupt(INTR_ADDR_START + i, irq_stubs[i]);
+    add_interrupt(LAPIC_SPURIOUS_VEC, &lapic_spurious_interrupt);
     add_sys_call(SYSCALL_VEC ,&sys_call);
+
+    /*
+     * fast path next to int 0x80; sysexit derives the user segments
+     * from KERNEL_CS, which the GDT layout matches.  The entry stack
+     * points at tss.esp0 so it follows every task switch for free.
+     */
+    wrmsr(MSR_SYSENTER_CS, KERNEL_CS);
+    wrmsr(MSR_SYSENTER_ESP, (uint32_t)&tss.esp0);
+    wrmsr(MSR_SYSENTER_EIP, (uint32_t)&sysenter_entry);
 }
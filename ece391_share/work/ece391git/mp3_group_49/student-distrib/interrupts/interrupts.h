@@ -8,11 +8,20 @@
  *      https://wiki.osdev.org/Interrupt_Descriptor_Table#I386_Interrupt_Gate
  * 
  * interrupts.* is analogous to exceptions.*
+ *
+ * Every PIC line, and the local APIC timer after them, has a chain of
+ * handlers that drivers hook into with request_irq; do_IRQ runs the
+ * whole chain, so lines can be shared, and sends the EOI itself.
+ * Spurious IRQ7/IRQ15 are filtered out before any handler sees them.
+ * Each line counts its interrupts and the cycles spent in its
+ * handlers.
  */
 
 #ifndef INTERRUPTS_H
 #define INTERRUPTS_H
 
+#include <types.h>
+
 #define add_interrupt(n, addr)          \
 do {                                    \
     SET_IDT_ENTRY(idt[n], addr);        \
@@ -41,14 +50,62 @@ do {                                    \
 
 /* IDT addresses for interrupts */
 #define INTR_ADDR_START         0x20
-#define INTR_ADDR_KEYB          0x21
-#define INTR_ADDR_RTC           0x28
+
+/* lines of the two PICs */
+#define NR_PIC_IRQS             16
+/* local APIC timer, on the vector right after the PIC lines */
+#define LAPIC_TIMER_IRQ         16
+/* size of the handler table */
+#define NR_IRQS                 17
+
+/* handlers registered at once, over all lines together */
+#define IRQ_ACTIONS             32
+
+/* what a handler returns */
+#define IRQ_NONE                0   /* not from this handler's device */
+#define IRQ_HANDLED             1
 
 #define SYSCALL_VEC             0x80
 
-/* Populate the IDT with interrupts */
+/* sysenter MSRs, Intel SDM Vol. 3 5.8.7 */
+#define MSR_SYSENTER_CS         0x174
+#define MSR_SYSENTER_ESP        0x175
+#define MSR_SYSENTER_EIP        0x176
+
+/* a handler on an IRQ chain, dev is whatever was passed to request_irq */
+typedef int32_t (*irq_handler_t)(uint32_t irq, void* dev);
+
+/* what common_interrupt_handler saved, lowest address first */
+typedef struct irq_regs_t {
+    uint32_t edi, esi, ebp, esp, ebx, edx, ecx, eax;   /* pushal */
+    uint32_t ds, es, fs;
+    uint32_t eip, cs, eflags;                           /* pushed by the cpu */
+} irq_regs_t;
+
+/* registers of the interrupted code, valid inside IRQ handlers */
+extern irq_regs_t* irq_regs;
+
+/* per line statistics */
+typedef struct irq_stat_t {
+    uint64_t cycles;        /* total time spent in the handler chain */
+    uint32_t count;         /* real interrupts */
+    uint32_t max_cycles;    /* longest single run of the chain */
+    uint32_t spurious;      /* IRQ7/IRQ15 with nothing in service */
+    uint32_t unhandled;     /* no handler claimed the interrupt */
+} irq_stat_t;
+
+/* Populate the IDT with interrupts, and set up the sysenter entry */
 void init_idt_interrupts(void);
 
+/* add a handler to an IRQ line, unmasking a PIC line on the first one */
+int32_t request_irq(uint32_t irq, irq_handler_t handler, void* dev);
+
+/* remove the handler registered with dev, masking the line when none are left */
+int32_t free_irq(uint32_t irq, void* dev);
+
+/* copy out the statistics of all NR_IRQS lines */
+void irq_get_stats(irq_stat_t* out);
+
 /*
  * how the OS handles/reports exceptions
  * will initiate a while(1); loop for now
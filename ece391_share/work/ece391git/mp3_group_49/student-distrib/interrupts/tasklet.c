@@ -0,0 +1,116 @@
+#include "tasklet.h"
+
+#include <lib.h>
+
+/* FIFO of pending work; head is written by top halves, tail by do_tasklets */
+static tasklet_t tasklet_queue[TASKLET_QUEUE_SIZE];
+static volatile uint32_t tasklet_head = 0;
+static volatile uint32_t tasklet_tail = 0;
+
+/* set while do_tasklets is draining, so nested interrupts do not recurse */
+static volatile int32_t tasklet_running = 0;
+
+static tasklet_stats_t tasklet_stats;
+
+/*
+ * tasklet_schedule
+ * DESCRIPTION: queue a function to run once the current interrupt
+ *              has been acknowledged and interrupts are back on
+ * INPUTS: func -- bottom half to run
+ *         data -- argument handed to func
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if the queue is full
+ * SIDE EFFECTS: must be called with interrupts disabled
+ */
+int32_t tasklet_schedule(void (*func)(uint32_t data), uint32_t data)
+{
+    if (!func)
+        return FFAIL;
+
+    /* drop the work rather than overwrite older entries */
+    if (tasklet_head - tasklet_tail >= TASKLET_QUEUE_SIZE) {
+        tasklet_stats.dropped++;
+        return FFAIL;
+    }
+
+    tasklet_queue[tasklet_head & TASKLET_QUEUE_MASK].func = func;
+    tasklet_queue[tasklet_head & TASKLET_QUEUE_MASK].data = data;
+    tasklet_head++;
+    tasklet_stats.queued++;
+
+    return FSUCCESS;
+}
+
+/*
+ * do_tasklets
+ * DESCRIPTION: drain the tasklet queue, running each entry with
+ *              interrupts enabled
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: entered and left with interrupts disabled; interrupts
+ *               taken while draining only queue more work, which is
+ *               picked up by the same loop.  Nothing runs while the
+ *               interrupted code is in the middle of a console write,
+ *               the queue waits for the next interrupt after it
+ */
+void do_tasklets(void)
+{
+    tasklet_t work;
+    uint64_t start;
+    uint32_t cycles;
+
+    if (tasklet_running || console_busy())
+        return;
+    tasklet_running = 1;
+
+    while (tasklet_tail != tasklet_head) {
+        work = tasklet_queue[tasklet_tail & TASKLET_QUEUE_MASK];
+        tasklet_tail++;
+
+        sti();
+        start = rdtsc();
+        work.func(work.data);
+        cycles = (uint32_t)(rdtsc() - start);
+        cli();
+
+        if (cycles > tasklet_stats.bh_max_cycles)
+            tasklet_stats.bh_max_cycles = cycles;
+    }
+
+    tasklet_running = 0;
+}
+
+/*
+ * tasklet_account_irq
+ * DESCRIPTION: remember the worst case time spent in a top half
+ * INPUTS: cycles -- TSC cycles the handler ran with interrupts off
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: none
+ */
+void tasklet_account_irq(uint32_t cycles)
+{
+    if (cycles > tasklet_stats.irq_max_cycles)
+        tasklet_stats.irq_max_cycles = cycles;
+}
+
+/*
+ * tasklet_get_stats
+ * DESCRIPTION: snapshot the latency counters
+ * INPUTS: stats -- where to copy the counters
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: none
+ */
+void tasklet_get_stats(tasklet_stats_t* stats)
+{
+    uint32_t flags;
+
+    if (!stats)
+        return;
+
+    cli_and_save(flags);
+    *stats = tasklet_stats;
+    restore_flags(flags);
+}
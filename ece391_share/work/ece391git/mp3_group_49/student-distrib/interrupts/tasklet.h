@@ -0,0 +1,49 @@
+/*
+ * Deferred work ("bottom halves") for interrupt handlers
+ *
+ * A top half runs inside common_interrupt_handler with interrupts
+ * disabled.  It should only grab the hardware state (scancode,
+ * status register, ...), send EOI and queue a tasklet.  Queued
+ * tasklets run in FIFO order on the way out of the interrupt, after
+ * do_IRQ returns, with interrupts enabled again.
+ *
+ * reference:
+ *      https://www.kernel.org/doc/htmldocs/kernel-hacking/basics-softirqs.html
+ */
+
+#ifndef TASKLET_H
+#define TASKLET_H
+
+#include <types.h>
+
+/* number of pending tasklets, must be a power of 2 */
+#define TASKLET_QUEUE_SIZE      64
+#define TASKLET_QUEUE_MASK      (TASKLET_QUEUE_SIZE - 1)
+
+/* one unit of deferred work */
+typedef struct tasklet_t {
+    void (*func)(uint32_t data);
+    uint32_t data;
+} tasklet_t;
+
+/* latency bookkeeping, all values in TSC cycles */
+typedef struct tasklet_stats_t {
+    uint32_t irq_max_cycles;    /* worst case spent in a top half */
+    uint32_t bh_max_cycles;     /* worst case spent in one tasklet */
+    uint32_t queued;            /* tasklets accepted */
+    uint32_t dropped;           /* tasklets lost to a full queue */
+} tasklet_stats_t;
+
+/* queue func(data) to run after the current interrupt, call with IF=0 */
+int32_t tasklet_schedule(void (*func)(uint32_t data), uint32_t data);
+
+/* run every pending tasklet, called from handlers.S with IF=0 */
+void do_tasklets(void);
+
+/* record the cost of one top half */
+void tasklet_account_irq(uint32_t cycles);
+
+/* copy of the current latency statistics */
+void tasklet_get_stats(tasklet_stats_t* stats);
+
+#endif /* TASKLET_H */
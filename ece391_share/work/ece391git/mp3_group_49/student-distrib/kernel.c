@@ -17,8 +17,17 @@
 #include "drivers/fs.h"
 #include "drivers/rtc.h"
 #include "drivers/keyboard.h"
+#include "drivers/pit.h"
+#include "drivers/pipe.h"
+#include "drivers/serial.h"
+#include "klog.h"
+#include "fpu.h"
+#include "timer.h"
+#include "timepage.h"
+#include "clocksource.h"
 
 #include "syscall/syscalls.h"
+#include "syscall/sched.h"
 
 // #define RUN_TESTS
 
@@ -27,6 +36,10 @@
 /* Check if the bit BIT in FLAGS is set. */
 #define CHECK_FLAG(flags, bit)   ((flags) & (1 << (bit)))
 
+/* Room kept for the command line, paging unmaps where GRUB left it. */
+#define CMDLINE_SIZE    128
+static int8_t cmdline[CMDLINE_SIZE];
+
 /* Check if MAGIC is valid and print the Multiboot information structure
    pointed by ADDR. */
 void entry(unsigned long magic, unsigned long addr) {
@@ -57,8 +70,10 @@ void entry(unsigned long magic, unsigned long addr) {
         printf("boot_device = 0x%#x\n", (unsigned)mbi->boot_device);
 
     /* Is the command line passed? */
-    if (CHECK_FLAG(mbi->flags, 2))
+    if (CHECK_FLAG(mbi->flags, 2)) {
         printf("cmdline = %s\n", (char *)mbi->cmdline);
+        strncpy(cmdline, (int8_t*)mbi->cmdline, CMDLINE_SIZE - 1);
+    }
 
     if (CHECK_FLAG(mbi->flags, 3)) {
         int mod_count = 0;
@@ -159,6 +174,9 @@ void entry(unsigned long magic, unsigned long addr) {
     init_paging();
     printf("Initialized Paging\n");
 
+    init_fpu();
+    printf("Initialized FPU%s%s\n", cpu_has_sse2 ? ", SSE2" : "", cpu_has_erms ? ", ERMS" : "");
+
     i8259_init();
     printf("Initialized PIC\n");
 
@@ -168,10 +186,22 @@ void entry(unsigned long magic, unsigned long addr) {
     init_rtc();
     printf("Initialized RTC\n");
 
-    clear();
+    init_serial();
+    printf("Initialized serial\n");
+
+    init_timers();
+    init_clocksource();
+    init_time_page();
+    start_tick();
+    console_defer();
+    klog_defer();
+    printf("Initialized tick\n");
 
+    init_sched();
+    init_pipes();
+    printf("Initialized scheduler\n");
 
-    execute((uint8_t*)"shell");
+    clear();
 
     //Enable Interrupts
     /* Initialize devices, memory, filesystem, enable device interrupts on the
@@ -196,14 +226,10 @@ void entry(unsigned long magic, unsigned long addr) {
         launch_tests();
     #endif
 
-    /* Execute the first program ("shell") ... */
-
-
-    /* Spin (nicely, so we don't chew up cycles) */
+    /* Benchmarks the command line asked for, with bench=... */
+    launch_benchmarks(cmdline);
 
-    while(1) {
-        //asm volatile ("int $33");
-    }
-
-    asm volatile (".1: hlt; jmp .1;");
+    /* Execute the first program ("shell") ... */
+    /* ... then spin (nicely, so we don't chew up cycles) as the idle task */
+    cpu_idle();
 }
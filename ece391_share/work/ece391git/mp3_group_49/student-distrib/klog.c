@@ -0,0 +1,228 @@
+#include "klog.h"
+#include "lib.h"
+
+#include "interrupts/tasklet.h"
+#include "syscall/process.h"
+
+static int8_t klog_buf[KLOG_SIZE];
+static volatile uint32_t klog_head = 0;        /* bytes ever logged */
+static uint32_t klog_rendered = 0;             /* bytes handed to the console */
+static uint32_t klog_lost = 0;                 /* overwritten before rendering */
+
+static int32_t klog_deferred = 0;              /* render from the tasklet */
+static volatile int32_t klog_bh_pending = 0;   /* klog_bottom_half queued */
+static int32_t klog_rendering = 0;             /* klog_flush is running */
+
+static fops_t klog_ops = {klog_open, klog_close, klog_read, NULL};
+
+/* oldest byte the ring still holds */
+#define KLOG_OLDEST()       (klog_head > KLOG_SIZE ? klog_head - KLOG_SIZE : 0)
+
+/* render what came in since the last time, runs as a tasklet */
+static void klog_bottom_half(uint32_t data)
+{
+    klog_bh_pending = 0;
+    klog_flush();
+}
+
+/*
+ * klog_write
+ * DESCRIPTION: append to the log, overwriting its oldest bytes once
+ *              it is full
+ * INPUTS: buf -- characters to log
+ *         n   -- number of characters
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: safe in interrupt handlers; queues the tasklet that
+ *               renders the log, or renders it right away before
+ *               klog_defer
+ */
+void klog_write(const int8_t* buf, int32_t n)
+{
+    uint32_t flags;
+    uint32_t off, chunk;
+
+    if (n <= 0)
+        return;
+
+    cli_and_save(flags);
+
+    /* only the last KLOG_SIZE bytes of a huge message survive anyway */
+    if (n > KLOG_SIZE) {
+        klog_head += n - KLOG_SIZE;
+        buf += n - KLOG_SIZE;
+        n = KLOG_SIZE;
+    }
+
+    /* up to the end of the ring, then whatever wrapped around */
+    off = klog_head & KLOG_MASK;
+    chunk = KLOG_SIZE - off;
+    if (chunk > (uint32_t)n)
+        chunk = n;
+    memcpy(klog_buf + off, buf, chunk);
+    memcpy(klog_buf, buf + chunk, n - chunk);
+    klog_head += n;
+
+    if (klog_deferred && !klog_bh_pending) {
+        klog_bh_pending = 1;
+        if (tasklet_schedule(klog_bottom_half, 0))
+            klog_bh_pending = 0;
+    }
+    restore_flags(flags);
+
+    if (!klog_deferred)
+        klog_flush();
+}
+
+/*
+ * klog_flush
+ * DESCRIPTION: hand everything logged since the last call to the
+ *              console
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: the console is written with interrupts enabled; a
+ *               call that comes in while one is already rendering
+ *               leaves the new bytes to it
+ */
+void klog_flush(void)
+{
+    uint32_t flags;
+    uint32_t off, chunk;
+
+    cli_and_save(flags);
+    if (klog_rendering) {
+        restore_flags(flags);
+        return;
+    }
+    klog_rendering = 1;
+
+    while (klog_rendered != klog_head) {
+        /* the writers lapped us, skip what is gone */
+        if (klog_head - klog_rendered > KLOG_SIZE) {
+            klog_lost += klog_head - klog_rendered - KLOG_SIZE;
+            klog_rendered = klog_head - KLOG_SIZE;
+        }
+
+        off = klog_rendered & KLOG_MASK;
+        chunk = klog_head - klog_rendered;
+        if (chunk > KLOG_SIZE - off)
+            chunk = KLOG_SIZE - off;
+
+        restore_flags(flags);
+        console_write(klog_buf + off, chunk);
+        cli_and_save(flags);
+
+        klog_rendered += chunk;
+    }
+
+    klog_rendering = 0;
+    restore_flags(flags);
+}
+
+/*
+ * klog_defer
+ * DESCRIPTION: switch to rendering from a tasklet, once interrupts
+ *              come in regularly enough to run it
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: none
+ */
+void klog_defer(void)
+{
+    klog_deferred = 1;
+}
+
+/*
+ * klog_dropped
+ * DESCRIPTION: check if the console fell behind the log
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: bytes overwritten before they were rendered
+ * SIDE EFFECTS: none
+ */
+uint32_t klog_dropped(void)
+{
+    return klog_lost;
+}
+
+/*
+ * klog_open
+ * DESCRIPTION: give the caller a descriptor that reads the log
+ * INPUTS: filename -- not used
+ * OUTPUTS: none
+ * RETURN VALUE: the descriptor, -1 if no slot is free
+ * SIDE EFFECTS: the descriptor starts at the oldest byte kept
+ */
+int32_t klog_open(const uint8_t* filename)
+{
+    pcb_t* pcb = get_pcb_ptr();
+    int32_t fd;
+
+    for (fd = 0; fd < FILE_DESC_SIZE; fd++) {
+        if (pcb->file_desc_array[fd].flags == !IN_USE)
+            break;
+    }
+    if (fd == FILE_DESC_SIZE)
+        return FFAIL;
+
+    pcb->file_desc_array[fd].inode = NULL;
+    pcb->file_desc_array[fd].file_pos = KLOG_OLDEST();
+    pcb->file_desc_array[fd].flags = IN_USE;
+    pcb->file_desc_array[fd].file_ops = &klog_ops;
+    return fd;
+}
+
+/*
+ * klog_close
+ * DESCRIPTION: free a log descriptor
+ * INPUTS: fd -- descriptor to free
+ * OUTPUTS: none
+ * RETURN VALUE: 0
+ * SIDE EFFECTS: none
+ */
+int32_t klog_close(int32_t fd)
+{
+    get_pcb_ptr()->file_desc_array[fd].flags = !IN_USE;
+    return FSUCCESS;
+}
+
+/*
+ * klog_read
+ * DESCRIPTION: copy out log bytes this descriptor has not read yet
+ * INPUTS: fd     -- log descriptor
+ *         nbytes -- most bytes to read
+ * OUTPUTS: buf -- log bytes
+ * RETURN VALUE: bytes read, 0 once caught up, -1 on a bad buffer
+ * SIDE EFFECTS: a reader that fell more than KLOG_SIZE behind skips
+ *               ahead to the oldest byte kept
+ */
+int32_t klog_read(int32_t fd, void* buf, int32_t nbytes)
+{
+    file_desc_t* file = &get_pcb_ptr()->file_desc_array[fd];
+    uint32_t flags;
+    uint32_t off, count, chunk;
+
+    if (!buf || nbytes < 0)
+        return FFAIL;
+
+    cli_and_save(flags);
+    if (file->file_pos < KLOG_OLDEST())
+        file->file_pos = KLOG_OLDEST();
+
+    count = klog_head - file->file_pos;
+    if (count > (uint32_t)nbytes)
+        count = nbytes;
+
+    off = file->file_pos & KLOG_MASK;
+    chunk = KLOG_SIZE - off;
+    if (chunk > count)
+        chunk = count;
+    memcpy(buf, klog_buf + off, chunk);
+    memcpy((int8_t*)buf + chunk, klog_buf, count - chunk);
+    file->file_pos += count;
+    restore_flags(flags);
+
+    return count;
+}
@@ -0,0 +1,54 @@
+/*
+ * Kernel log ring buffer
+ *
+ * printf, puts and putc only append to a ring of KLOG_SIZE bytes; a
+ * tasklet renders what is new to the console (and so to the serial
+ * port) afterwards.  Logging from an interrupt handler costs a copy
+ * into memory instead of a trip through the console, and bursts of
+ * messages are drawn in one go.  Until klog_defer is called at boot
+ * every message is rendered right away, so a hang early in boot still
+ * leaves its last words on screen.
+ *
+ * The ring keeps the newest KLOG_SIZE bytes.  User programs read it
+ * through the device file "kmsg", each descriptor from the oldest
+ * byte still there to the newest, like dmesg.
+ *
+ * References Used:
+ *      Linux kernel/printk/printk.c, dmesg(1)
+ */
+
+#ifndef KLOG_H
+#define KLOG_H
+
+#include "types.h"
+
+/* bytes of log kept, must be a power of 2 */
+#define KLOG_SIZE           16384
+#define KLOG_MASK           (KLOG_SIZE - 1)
+
+/* append to the log and get it rendered */
+void klog_write(const int8_t* buf, int32_t n);
+
+/* render everything logged so far to the console now */
+void klog_flush(void);
+
+/* from now on render from a tasklet instead of in klog_write */
+void klog_defer(void);
+
+/* bytes that were overwritten before they could be rendered */
+uint32_t klog_dropped(void);
+
+/*
+ *  KMSG DRIVER FUNCTIONS
+ */
+
+/* open the log for reading from its oldest byte */
+int32_t klog_open(const uint8_t* filename);
+
+/* free the descriptor */
+int32_t klog_close(int32_t fd);
+
+/* copy out log bytes not read yet, 0 once caught up */
+int32_t klog_read(int32_t fd, void* buf, int32_t nbytes);
+
+#endif /* KLOG_H */
@@ -3,6 +3,11 @@
 
 #include "lib.h"
 #include "drivers/terminal.h"
+#include "drivers/serial.h"
+#include "klog.h"
+#include "fpu.h"
+#include "syscall/process.h"
+#include "paging.h"
 
 #define VIDEO       0xB8000
 #define NUM_COLS    80
@@ -12,26 +17,296 @@
 #define HEX_F       0x000F 
 #define TOP_BITS    0xFF00
 #define CURSOR       0x03D4
+#define CRTC_START_HI   0x0C
+#define CRTC_START_LO   0x0D
+#define CELL_SHIFT      8
+/* cells in the B8000-BFFFF window the screen can slide through */
+#define WINDOW_CELLS    ((VGA_WINDOW_PAGES << PAGE_ALIGN_OFFSET) / 2)
+#define WINDOW_ROWS     (WINDOW_CELLS / NUM_COLS)
+#define DIRTY_SHIFT     5
+#define DIRTY_WORDS     ((WINDOW_ROWS >> DIRTY_SHIFT) + 1)
+/* rows of output kept, the screen plus the scrollback; a power of 2 */
+#define HISTORY_ROWS    2048
+#define HISTORY_MASK    (HISTORY_ROWS - 1)
+/* memcpy and memset strategies by size, see memcpy */
+#define MEM_SMALL       32              /* below: a word loop, rep costs more to start */
+#define MEM_SSE_MIN     4096            /* from here: SSE2 if src and dest line up */
+#define MEM_SSE_CHUNK   65536           /* bytes per kernel_fpu_begin, interrupts are off */
+#define MEM_NT_MIN      (2 * 1024 * 1024)   /* from here: stores bypass the cache */
+/* word at a time string scans: a word with a zero byte in it */
+#define ONES            0x01010101
+#define HIGHS           0x80808080
+#define HAS_ZERO(w)     (((w) - ONES) & ~(w) & HIGHS)
+
+/* a word of string, may alias the bytes it is read from */
+typedef uint32_t __attribute__((__may_alias__)) word_t;
 static int screen_x;
 static int screen_y;
-static char* video_mem = (char *)VIDEO;
+static int screen_origin;           /* VGA cell shown in the top left corner */
+static int screen_top;              /* history row that is screen row 0 */
+static int history_count;           /* rows above the screen that can be scrolled back to */
+static int view_offset;             /* rows the view is scrolled back, 0 is live */
+
+/*
+ * All console output goes to a ring of HISTORY_ROWS rows in normal
+ * memory; the screen is the NUM_ROWS rows starting at screen_top and
+ * everything before them is the scrollback.  Scrolling only moves
+ * screen_top, so rows that leave the screen stay in the ring until it
+ * wraps around.  Rows written since the last console_flush are marked
+ * in dirty_rows, by VGA window row, and copied to VIDEO in one go, so
+ * a burst of output costs one copy per frame instead of a slow VGA
+ * store per character.  Looking at the scrollback only changes
+ * view_offset; the next flush draws the one screen it points at.
+ */
+static uint16_t shadow[HISTORY_ROWS * NUM_COLS];
+static uint32_t dirty_rows[DIRTY_WORDS];
+static int32_t view_dirty;          /* view moved, draw all of it on the next flush */
+static int32_t crtc_dirty;          /* origin or cursor moved since the last flush */
+static int32_t crtc_origin = -1;    /* what the CRTC was last programmed with */
+static int32_t crtc_cursor = -1;
+static int32_t console_deferred;    /* set once the timer tick flushes for us */
+static int32_t console_hidden;      /* VGA is out of text mode, keep output in the shadow */
+static volatile int32_t console_lock;   /* console code is running, counts nested calls */
+static char* video_mem = (char *)shadow;
+static uint16_t* vga_mem = (uint16_t *)VIDEO;
+
+/* first cell of a row of the history ring */
+#define HISTORY_ROW(row)    (shadow + ((row) & HISTORY_MASK) * NUM_COLS)
+
+/* address of a character of the live screen in the history ring */
+#define SCREEN_CELL(x, y)   (video_mem + (((((screen_top + (y)) & HISTORY_MASK) * NUM_COLS) + (x)) << 1))
+
+/* void mark_dirty(int32_t y);
+ * Inputs: y = screen row
+ * Return Value: none
+ * Function: queues one row of the screen for the next flush.  Call it
+ *           after storing to the row, a flush in between then either
+ *           sees the new characters or leaves the bit set */
+static void mark_dirty(int32_t y) {
+    int32_t row = screen_origin / NUM_COLS + y;
+
+    dirty_rows[row >> DIRTY_SHIFT] |= 1 << (row & ((1 << DIRTY_SHIFT) - 1));
+}
+
+/* void mark_screen_dirty(void);
+ * Inputs: void
+ * Return Value: none
+ * Function: queues every row of the screen for the next flush */
+static void mark_screen_dirty(void) {
+    int32_t y;
+
+    for (y = 0; y < NUM_ROWS; y++) {
+        mark_dirty(y);
+    }
+}
+
+/* void update_cursor(void);
+ * Inputs: void
+ * Return Value: none
+ * Function: has the next flush move the hardware cursor to screen_x,
+ *           screen_y and the CRTC start address to screen_origin.
+ *           Flushes right away until the timer tick takes over */
+static void update_cursor(void) {
+    crtc_dirty = 1;
+    if (!console_deferred)
+        console_flush();
+}
+
+/* void clear_row(int32_t y);
+ * Inputs: y = screen row
+ * Return Value: none
+ * Function: blanks one row of the screen */
+static void clear_row(int32_t y) {
+    memset_word(SCREEN_CELL(0, y), (ATTRIB << CELL_SHIFT) | ' ', NUM_COLS);
+    mark_dirty(y);
+}
+
+/* int32_t console_busy(void);
+ * Inputs: void
+ * Return Value: nonzero while console code is running
+ * Function: lets do_tasklets hold back bottom halves that would write
+ *           to the console in the middle of a console_write.  Every
+ *           function that changes the screen state with interrupts on
+ *           counts itself in console_lock; tasks are only switched on
+ *           the way back to user mode, so the only other writers that
+ *           can come in are bottom halves */
+int32_t console_busy(void) {
+    return console_lock;
+}
 
 /* void clear(void);
  * Inputs: void
  * Return Value: none
  * Function: Clears video memory */
 void clear(void) {
-    int32_t i;
-    for (i = 0; i < NUM_ROWS * NUM_COLS; i++) {
-        *(uint8_t *)(video_mem + (i << 1)) = ' ';
-        *(uint8_t *)(video_mem + (i << 1) + 1) = ATTRIB;
+    int32_t y;
+
+    console_lock++;
+    /* start over at the top of the window, back at the live screen */
+    screen_origin = 0;
+    view_offset = 0;
+    for (y = 0; y < NUM_ROWS; y++) {
+        clear_row(y);
     }
 
     /* clear screenpos */
     screen_x = 0;
     screen_y = 0;
-    outw(((int)HEX_E) | ((NUM_COLS*screen_y + screen_x) & ((int)TOP_BITS)), ((int)CURSOR));
-    outw(((int)HEX_F) | (((NUM_COLS*screen_y + screen_x) << 8) & ((int)TOP_BITS)), ((int)CURSOR));	
+    update_cursor();
+    console_lock--;
+}
+
+/* void reset_screen_origin(void);
+ * Inputs: void
+ * Return Value: none
+ * Function: moves the screen contents back to the start of video
+ *           memory and flushes them, for programs that draw at VIDEO
+ *           directly */
+void reset_screen_origin(void) {
+    console_lock++;
+    if (screen_origin) {
+        screen_origin = 0;
+        mark_screen_dirty();
+        crtc_dirty = 1;
+    }
+    console_flush();
+    console_lock--;
+}
+
+/* void console_flush(void);
+ * Inputs: void
+ * Return Value: none
+ * Function: copies the dirty rows of the screen from the history
+ *           ring to VIDEO and programs the CRTC if the origin or the
+ *           cursor moved.  Dirty rows that already scrolled off the
+ *           screen are dropped, so a flush copies at most one screen.
+ *           While the scrollback is shown it is drawn instead, and
+ *           live rows stay dirty until the view returns */
+void console_flush(void) {
+    uint32_t flags;
+    uint32_t bits;
+    int32_t first, y, pos;
+
+    cli_and_save(flags);
+    if (console_hidden) {
+        restore_flags(flags);
+        return;
+    }
+
+    first = screen_origin / NUM_COLS;
+    if (view_offset) {
+        if (view_dirty) {
+            for (y = 0; y < NUM_ROWS; y++) {
+                memcpy(vga_mem + (first + y) * NUM_COLS,
+                       HISTORY_ROW(screen_top - view_offset + y), NUM_COLS * 2);
+            }
+        }
+    } else {
+        for (y = 0; y < NUM_ROWS; y++) {
+            bits = 1 << ((first + y) & ((1 << DIRTY_SHIFT) - 1));
+            if (dirty_rows[(first + y) >> DIRTY_SHIFT] & bits) {
+                memcpy(vga_mem + (first + y) * NUM_COLS, HISTORY_ROW(screen_top + y), NUM_COLS * 2);
+            }
+        }
+        memset(dirty_rows, 0, sizeof(dirty_rows));
+    }
+    view_dirty = 0;
+
+    if (crtc_dirty) {
+        crtc_dirty = 0;
+        if (screen_origin != crtc_origin) {
+            // moving the start address scrolls without touching video memory
+            crtc_origin = screen_origin;
+            outw((CRTC_START_HI) | (crtc_origin & ((int)TOP_BITS)), ((int)CURSOR));
+            outw((CRTC_START_LO) | ((crtc_origin << CELL_SHIFT) & ((int)TOP_BITS)), ((int)CURSOR));
+        }
+        pos = screen_origin + NUM_COLS * screen_y + screen_x;
+        if (view_offset) {
+            // park the cursor below the screen, it is not on the old lines
+            pos = screen_origin + NUM_COLS * NUM_ROWS;
+        }
+        if (pos != crtc_cursor) {
+            crtc_cursor = pos;
+            outw(((int)HEX_E) | (pos & ((int)TOP_BITS)), ((int)CURSOR));
+            outw(((int)HEX_F) | ((pos << 8) & ((int)TOP_BITS)), ((int)CURSOR));
+        }
+    }
+
+    restore_flags(flags);
+}
+
+/* void console_defer(void);
+ * Inputs: void
+ * Return Value: none
+ * Function: stops flushing after every write, from now on the timer
+ *           tick and blocking reads call console_flush */
+void console_defer(void) {
+    console_deferred = 1;
+}
+
+/* void console_suspend(void);
+ * Inputs: void
+ * Return Value: none
+ * Function: stops drawing to VIDEO and programming the CRTC while the
+ *           VGA is in a graphics mode, output keeps going to the
+ *           history ring */
+void console_suspend(void) {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    console_hidden = 1;
+    restore_flags(flags);
+}
+
+/* void console_resume(void);
+ * Inputs: void
+ * Return Value: none
+ * Function: draws the whole screen again once the VGA is back in
+ *           text mode, and programs the CRTC from scratch */
+void console_resume(void) {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    console_hidden = 0;
+    mark_screen_dirty();
+    view_dirty = 1;
+    crtc_dirty = 1;
+    crtc_origin = -1;
+    crtc_cursor = -1;
+    restore_flags(flags);
+    console_flush();
+}
+
+/* void console_scroll_view(int32_t lines);
+ * Inputs: lines = rows to move the view back into the scrollback,
+ *                 negative to move it toward the live screen
+ * Return Value: none
+ * Function: pages through the scrollback.  Only the view offset
+ *           changes, the flush right after draws the one screen it
+ *           points at no matter how much history there is */
+void console_scroll_view(int32_t lines) {
+    uint32_t flags;
+    int32_t offset;
+
+    cli_and_save(flags);
+    offset = view_offset + lines;
+    if (offset > history_count) {
+        offset = history_count;
+    }
+    if (offset < 0) {
+        offset = 0;
+    }
+    if (offset != view_offset) {
+        view_offset = offset;
+        view_dirty = 1;
+        crtc_dirty = 1;
+        if (!offset) {
+            mark_screen_dirty();
+        }
+    }
+    restore_flags(flags);
+
+    console_flush();
 }
 
 /* Standard printf().
@@ -163,59 +438,123 @@ format_char_switch:
 /* int32_t puts(int8_t* s);
  *   Inputs: int_8* s = pointer to a string of characters
  *   Return Value: Number of bytes written
- *    Function: Output a string to the console */
+ *    Function: Output a string to the kernel log */
 int32_t puts(int8_t* s) {
-    register int32_t index = 0;
-    while (s[index] != '\0') {
-        putc(s[index]);
-        index++;
-    }
-    return index;
+    int32_t len = strlen(s);
+
+    klog_write(s, len);
+    return len;
 }
 
 /* void putc(uint8_t c);
  * Inputs: uint_8* c = character to print
  * Return Value: void
- *  Function: Output a character to the console */
+ *  Function: Output a character to the kernel log */
 void putc(uint8_t c) {
-    if(c == (uint8_t)BACKSPACE){
-        backspace();
+    klog_write((int8_t*)&c, 1);
+}
+
+/* void new_line(void);
+ * Inputs: void
+ * Return Value: none
+ * Function: moves screen_x, screen_y to the start of the next line,
+ *           scrolling if it is off the screen.  Leaves the CRTC alone,
+ *           console_write programs it once at the end */
+static void new_line(void) {
+    screen_x = 0;
+    if (screen_y + 1 < NUM_ROWS) {
+        screen_y++;
         return;
     }
-    if(c == '\n' || c == '\r') {
-        if(screen_y + 1 >= NUM_ROWS){
-            scroll_one_unit_down();
-        }
-        else{
-            screen_y++;
-            screen_x = 0;
+
+    // the top row goes into the scrollback
+    screen_top = (screen_top + 1) & HISTORY_MASK;
+    if (history_count < HISTORY_ROWS - NUM_ROWS) {
+        history_count++;
+    }
+    if (view_offset) {
+        // keep showing the same lines while output goes on below them
+        if (view_offset < history_count) {
+            view_offset++;
         }
+        view_dirty = 1;
+    }
+
+    if (screen_origin + (NUM_ROWS + 1) * NUM_COLS > WINDOW_CELLS) {
+        // out of window, start over at its top and redraw from the ring
+        screen_origin = 0;
+        mark_screen_dirty();
     } else {
-        *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1)) = c;
-        *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) = ATTRIB;
-        if(screen_x + 1 >= NUM_COLS){
-            if(screen_y + 1 >= NUM_ROWS){
-                scroll_one_unit_down();
-                outw(((int)HEX_E) | ((NUM_COLS*screen_y + screen_x) & ((int)TOP_BITS)), ((int)CURSOR));
-                outw(((int)HEX_F) | (((NUM_COLS*screen_y + screen_x) << 8) & ((int)TOP_BITS)), ((int)CURSOR));	
-                return;
+        screen_origin += NUM_COLS;
+    }
+
+    // make the new line empty
+    clear_row(NUM_ROWS - 1);
+}
+
+/* void console_write(const int8_t* buf, int32_t n);
+ * Inputs: buf = characters to print
+ *         n = number of characters in buf
+ * Return Value: none
+ * Function: Output a buffer to the console.  Runs of printable
+ *           characters are stored straight into video memory a row at
+ *           a time, only newlines and backspaces are looked at one by
+ *           one.  The CRTC start address and cursor are programmed once
+ *           at the end instead of after every character.  Everything
+ *           is mirrored to the serial port as well */
+void console_write(const int8_t* buf, int32_t n) {
+    uint16_t* cell;
+    uint8_t c;
+    int32_t run, i;
+
+    console_lock++;
+    serial_console_write(buf, n);
+
+    while (n > 0) {
+        c = *buf;
+        if (c == '\n' || c == '\r') {
+            new_line();
+            buf++;
+            n--;
+            continue;
+        }
+        if (c == (uint8_t)BACKSPACE) {
+            // step back, onto the end of the previous row at column 0
+            if (screen_x > 0) {
+                screen_x--;
+            } else if (screen_y > 0) {
+                screen_x = NUM_COLS - 1;
+                screen_y--;
             }
-            screen_x = 0;
-            screen_y++;
-            outw(((int)HEX_E) | ((NUM_COLS*screen_y + screen_x) & ((int)TOP_BITS)), ((int)CURSOR));
-            outw(((int)HEX_F) | (((NUM_COLS*screen_y + screen_x) << 8) & ((int)TOP_BITS)), ((int)CURSOR));
-            return;
+            *(uint16_t*)SCREEN_CELL(screen_x, screen_y) = (ATTRIB << CELL_SHIFT) | ' ';
+            mark_dirty(screen_y);
+            buf++;
+            n--;
+            continue;
         }
-        screen_x++;
-        screen_x %= NUM_COLS;
-        screen_y = (screen_y + (screen_x / NUM_COLS)) % NUM_ROWS;
-        if((screen_y + (screen_x / NUM_COLS))>= NUM_ROWS){
-            scroll_one_unit_down();
+
+        // printable run, up to the end of the row
+        run = NUM_COLS - screen_x;
+        if (run > n)
+            run = n;
+        cell = (uint16_t*)SCREEN_CELL(screen_x, screen_y);
+        for (i = 0; i < run; i++) {
+            c = buf[i];
+            if (c == '\n' || c == '\r' || c == (uint8_t)BACKSPACE)
+                break;
+            cell[i] = (ATTRIB << CELL_SHIFT) | c;
         }
-        // set_cursor_position(screen_x++, screen_y);
+        screen_x += i;
+        buf += i;
+        n -= i;
+        mark_dirty(screen_y);
+
+        if (screen_x >= NUM_COLS)
+            new_line();
     }
-    outw(((int)HEX_E) | ((NUM_COLS*screen_y + screen_x) & ((int)TOP_BITS)), ((int)CURSOR));
-    outw(((int)HEX_F) | (((NUM_COLS*screen_y + screen_x) << 8) & ((int)TOP_BITS)), ((int)CURSOR));	
+
+    update_cursor();
+    console_lock--;
 }
 
 /* int8_t* itoa(uint32_t value, int8_t* buf, int32_t radix);
@@ -278,21 +617,153 @@ int8_t* strrev(int8_t* s) {
 /* uint32_t strlen(const int8_t* s);
  * Inputs: const int8_t* s = string to take length of
  * Return Value: length of string s
- * Function: return length of string s */
+ * Function: return length of string s.  Bytes up to a word boundary
+ *           are checked one at a time, then whole words until one has
+ *           a zero byte; an aligned word never crosses into the next
+ *           page, so reading past the end is safe */
 uint32_t strlen(const int8_t* s) {
-    register uint32_t len = 0;
-    while (s[len] != '\0')
-        len++;
-    return len;
+    const int8_t* p = s;
+    const word_t* w;
+
+    for (; (uint32_t)p & 0x3; p++) {
+        if (*p == '\0')
+            return p - s;
+    }
+    for (w = (const word_t*)p; !HAS_ZERO(*w); w++)
+        ;
+    for (p = (const int8_t*)w; *p != '\0'; p++)
+        ;
+    return p - s;
 }
 
+static void* memset_sse2(void* s, uint32_t fill, uint32_t n);
+static void* memcpy_sse2(void* dest, const void* src, uint32_t n);
+
 /* void* memset(void* s, int32_t c, uint32_t n);
  * Inputs:    void* s = pointer to memory
  *          int32_t c = value to set memory to
  *         uint32_t n = number of bytes to set
  * Return Value: new string
- * Function: set n consecutive bytes of pointer s to value c */
+ * Function: set n consecutive bytes of pointer s to value c, picking
+ *           the strategy by size like memcpy */
 void* memset(void* s, int32_t c, uint32_t n) {
+    uint8_t* p = s;
+    uint32_t fill;
+
+    c &= 0xFF;
+    fill = c << 24 | c << 16 | c << 8 | c;
+
+    if (n < MEM_SMALL) {
+        asm volatile ("                 \n\
+                movl    %%ecx, %%edx    \n\
+                shrl    $2, %%ecx       \n\
+                jz      2f              \n\
+            1:  movl    %%eax, (%%edi)  \n\
+                addl    $4, %%edi       \n\
+                subl    $1, %%ecx       \n\
+                jnz     1b              \n\
+            2:  andl    $0x3, %%edx     \n\
+                jz      4f              \n\
+            3:  movb    %%al, (%%edi)   \n\
+                addl    $1, %%edi       \n\
+                subl    $1, %%edx       \n\
+                jnz     3b              \n\
+            4:                          \n\
+                "
+                : "+D"(p), "+c"(n)
+                : "a"(fill)
+                : "edx", "memory", "cc"
+        );
+        return s;
+    }
+    if (cpu_has_erms) {
+        asm volatile ("                 \n\
+                movw    %%ds, %%dx      \n\
+                movw    %%dx, %%es      \n\
+                cld                     \n\
+                rep     stosb           \n\
+                "
+                : "+D"(p), "+c"(n)
+                : "a"(fill)
+                : "edx", "memory", "cc"
+        );
+        return s;
+    }
+    if (n >= MEM_SSE_MIN && cpu_has_sse2)
+        return memset_sse2(s, fill, n);
+    return memset_stosl(s, c, n);
+}
+
+/* void* memset_sse2(void* s, uint32_t fill, uint32_t n);
+ * Inputs:       void* s = pointer to memory
+ *         uint32_t fill = byte to set, in all four bytes
+ *            uint32_t n = number of bytes to set, at least MEM_SSE_MIN
+ * Return Value: s
+ * Function: sets the bytes up to a 16 byte boundary with memset_stosl,
+ *           then 64 bytes a loop from xmm0, a MEM_SSE_CHUNK at a time */
+static void* memset_sse2(void* s, uint32_t fill, uint32_t n) {
+    uint8_t* p = s;
+    uint32_t head, chunk, flags;
+    int32_t nt = (n >= MEM_NT_MIN);
+
+    head = -(uint32_t)p & 0xF;
+    memset_stosl(p, fill, head);
+    p += head;
+    n -= head;
+
+    while (n >= 64) {
+        chunk = (n < MEM_SSE_CHUNK) ? (n & ~63) : MEM_SSE_CHUNK;
+        n -= chunk;
+        flags = kernel_fpu_begin();
+        if (nt) {
+            asm volatile ("                 \n\
+                    movd    %%eax, %%xmm0           \n\
+                    pshufd  $0, %%xmm0, %%xmm0      \n\
+                1:  movntdq %%xmm0,   (%%edi)       \n\
+                    movntdq %%xmm0, 16(%%edi)       \n\
+                    movntdq %%xmm0, 32(%%edi)       \n\
+                    movntdq %%xmm0, 48(%%edi)       \n\
+                    addl    $64, %%edi              \n\
+                    subl    $64, %%ecx              \n\
+                    jnz     1b                      \n\
+                    sfence                          \n\
+                    "
+                    : "+D"(p), "+c"(chunk)
+                    : "a"(fill)
+                    : "memory", "cc"
+            );
+        } else {
+            asm volatile ("                 \n\
+                    movd    %%eax, %%xmm0           \n\
+                    pshufd  $0, %%xmm0, %%xmm0      \n\
+                1:  movdqa  %%xmm0,   (%%edi)       \n\
+                    movdqa  %%xmm0, 16(%%edi)       \n\
+                    movdqa  %%xmm0, 32(%%edi)       \n\
+                    movdqa  %%xmm0, 48(%%edi)       \n\
+                    addl    $64, %%edi              \n\
+                    subl    $64, %%ecx              \n\
+                    jnz     1b                      \n\
+                    "
+                    : "+D"(p), "+c"(chunk)
+                    : "a"(fill)
+                    : "memory", "cc"
+            );
+        }
+        kernel_fpu_end(flags);
+    }
+
+    memset_stosl(p, fill, n);
+    return s;
+}
+
+/* void* memset_stosl(void* s, int32_t c, uint32_t n);
+ * Inputs:    void* s = pointer to memory
+ *          int32_t c = value to set memory to
+ *         uint32_t n = number of bytes to set
+ * Return Value: new string
+ * Function: set n consecutive bytes of pointer s to value c, bytes up
+ *           to a dword boundary and then rep stosl */
+void* memset_stosl(void* s, int32_t c, uint32_t n) {
     c &= 0xFF;
     asm volatile ("                 \n\
             .memset_top:            \n\
@@ -374,8 +845,139 @@ void* memset_dword(void* s, int32_t c, uint32_t n) {
  *         const void* src = source of copy
  *              uint32_t n = number of byets to copy
  * Return Value: pointer to dest
- * Function: copy n bytes of src to dest */
+ * Function: copy n bytes of src to dest.  Below MEM_SMALL bytes a word
+ *           loop is cheapest.  On cpus with fast string moves rep movsb
+ *           beats everything else at any larger size; on the others
+ *           large copies with src and dest equally aligned go through
+ *           SSE2 and the rest through rep movsl */
 void* memcpy(void* dest, const void* src, uint32_t n) {
+    uint8_t* d = dest;
+    const uint8_t* s = src;
+
+    if (n < MEM_SMALL) {
+        asm volatile ("                 \n\
+                movl    %%ecx, %%edx    \n\
+                shrl    $2, %%ecx       \n\
+                jz      2f              \n\
+            1:  movl    (%%esi), %%eax  \n\
+                movl    %%eax, (%%edi)  \n\
+                addl    $4, %%esi       \n\
+                addl    $4, %%edi       \n\
+                subl    $1, %%ecx       \n\
+                jnz     1b              \n\
+            2:  andl    $0x3, %%edx     \n\
+                jz      4f              \n\
+            3:  movb    (%%esi), %%al   \n\
+                movb    %%al, (%%edi)   \n\
+                addl    $1, %%esi       \n\
+                addl    $1, %%edi       \n\
+                subl    $1, %%edx       \n\
+                jnz     3b              \n\
+            4:                          \n\
+                "
+                : "+S"(s), "+D"(d), "+c"(n)
+                :
+                : "eax", "edx", "memory", "cc"
+        );
+        return dest;
+    }
+    if (cpu_has_erms) {
+        asm volatile ("                 \n\
+                movw    %%ds, %%dx      \n\
+                movw    %%dx, %%es      \n\
+                cld                     \n\
+                rep     movsb           \n\
+                "
+                : "+S"(s), "+D"(d), "+c"(n)
+                :
+                : "edx", "memory", "cc"
+        );
+        return dest;
+    }
+    if (n >= MEM_SSE_MIN && cpu_has_sse2 && !(((uint32_t)dest ^ (uint32_t)src) & 0xF))
+        return memcpy_sse2(dest, src, n);
+    return memcpy_movsl(dest, src, n);
+}
+
+/* void* memcpy_sse2(void* dest, const void* src, uint32_t n);
+ * Inputs:      void* dest = destination of copy
+ *         const void* src = source of copy, aligned like dest mod 16
+ *              uint32_t n = number of bytes to copy, at least MEM_SSE_MIN
+ * Return Value: pointer to dest
+ * Function: copies up to a 16 byte boundary with memcpy_movsl, then 64
+ *           bytes a loop through xmm0-xmm3, a MEM_SSE_CHUNK at a time.
+ *           Copies of MEM_NT_MIN and up store around the cache */
+static void* memcpy_sse2(void* dest, const void* src, uint32_t n) {
+    uint8_t* d = dest;
+    const uint8_t* s = src;
+    uint32_t head, chunk, flags;
+    int32_t nt = (n >= MEM_NT_MIN);
+
+    head = -(uint32_t)d & 0xF;
+    memcpy_movsl(d, s, head);
+    d += head;
+    s += head;
+    n -= head;
+
+    while (n >= 64) {
+        chunk = (n < MEM_SSE_CHUNK) ? (n & ~63) : MEM_SSE_CHUNK;
+        n -= chunk;
+        flags = kernel_fpu_begin();
+        if (nt) {
+            asm volatile ("                 \n\
+                1:  movdqa    (%%esi), %%xmm0       \n\
+                    movdqa  16(%%esi), %%xmm1       \n\
+                    movdqa  32(%%esi), %%xmm2       \n\
+                    movdqa  48(%%esi), %%xmm3       \n\
+                    movntdq %%xmm0,   (%%edi)       \n\
+                    movntdq %%xmm1, 16(%%edi)       \n\
+                    movntdq %%xmm2, 32(%%edi)       \n\
+                    movntdq %%xmm3, 48(%%edi)       \n\
+                    addl    $64, %%esi              \n\
+                    addl    $64, %%edi              \n\
+                    subl    $64, %%ecx              \n\
+                    jnz     1b                      \n\
+                    sfence                          \n\
+                    "
+                    : "+S"(s), "+D"(d), "+c"(chunk)
+                    :
+                    : "memory", "cc"
+            );
+        } else {
+            asm volatile ("                 \n\
+                1:  movdqa    (%%esi), %%xmm0       \n\
+                    movdqa  16(%%esi), %%xmm1       \n\
+                    movdqa  32(%%esi), %%xmm2       \n\
+                    movdqa  48(%%esi), %%xmm3       \n\
+                    movdqa  %%xmm0,   (%%edi)       \n\
+                    movdqa  %%xmm1, 16(%%edi)       \n\
+                    movdqa  %%xmm2, 32(%%edi)       \n\
+                    movdqa  %%xmm3, 48(%%edi)       \n\
+                    addl    $64, %%esi              \n\
+                    addl    $64, %%edi              \n\
+                    subl    $64, %%ecx              \n\
+                    jnz     1b                      \n\
+                    "
+                    : "+S"(s), "+D"(d), "+c"(chunk)
+                    :
+                    : "memory", "cc"
+            );
+        }
+        kernel_fpu_end(flags);
+    }
+
+    memcpy_movsl(d, s, n);
+    return dest;
+}
+
+/* void* memcpy_movsl(void* dest, const void* src, uint32_t n);
+ * Inputs:      void* dest = destination of copy
+ *         const void* src = source of copy
+ *              uint32_t n = number of byets to copy
+ * Return Value: pointer to dest
+ * Function: copy n bytes of src to dest, bytes up to a dword boundary
+ *           of dest and then rep movsl */
+void* memcpy_movsl(void* dest, const void* src, uint32_t n) {
     asm volatile ("                 \n\
             .memcpy_top:            \n\
             testl   %%ecx, %%ecx    \n\
@@ -420,22 +1022,35 @@ void* memcpy(void* dest, const void* src, uint32_t n) {
  *         const void* src = source of move
  *              uint32_t n = number of byets to move
  * Return Value: pointer to dest
- * Function: move n bytes of src to dest */
+ * Function: move n bytes of src to dest.  Unless dest is inside src
+ *           this is a memcpy, which copies forward in every strategy;
+ *           otherwise the odd bytes at the end and then the dwords go
+ *           backward with rep movsb and rep movsl */
 void* memmove(void* dest, const void* src, uint32_t n) {
+    const uint8_t* s = src;
+    uint8_t* d = dest;
+
+    if (d <= s || d >= s + n)
+        return memcpy(dest, src, n);
+
     asm volatile ("                             \n\
             movw    %%ds, %%dx                  \n\
             movw    %%dx, %%es                  \n\
-            cld                                 \n\
-            cmp     %%edi, %%esi                \n\
-            jae     .memmove_go                 \n\
+            std                                 \n\
             leal    -1(%%esi, %%ecx), %%esi     \n\
             leal    -1(%%edi, %%ecx), %%edi     \n\
-            std                                 \n\
-            .memmove_go:                        \n\
+            movl    %%ecx, %%edx                \n\
+            andl    $0x3, %%ecx                 \n\
             rep     movsb                       \n\
+            subl    $3, %%esi                   \n\
+            subl    $3, %%edi                   \n\
+            movl    %%edx, %%ecx                \n\
+            shrl    $2, %%ecx                   \n\
+            rep     movsl                       \n\
+            cld                                 \n\
             "
+            : "+D"(d), "+S"(s), "+c"(n)
             :
-            : "D"(dest), "S"(src), "c"(n)
             : "edx", "memory", "cc"
     );
     return dest;
@@ -451,20 +1066,30 @@ void* memmove(void* dest, const void* src, uint32_t n) {
  *               character that does not match has a greater value
  *               in str1 than in str2; And a value less than zero
  *               indicates the opposite.
- * Function: compares string 1 and string 2 for equality */
+ * Function: compares string 1 and string 2 for equality, a word at a
+ *           time when both strings are equally aligned.  The last word
+ *           read holds the difference or the end, and is compared byte
+ *           by byte for the result */
 int32_t strncmp(const int8_t* s1, const int8_t* s2, uint32_t n) {
-    int32_t i;
-    for (i = 0; i < n; i++) {
-        if ((s1[i] != s2[i]) || (s1[i] == '\0') /* || s2[i] == '\0' */) {
-
-            /* The s2[i] == '\0' is unnecessary because of the short-circuit
-             * semantics of 'if' expressions in C.  If the first expression
-             * (s1[i] != s2[i]) evaluates to false, that is, if s1[i] ==
-             * s2[i], then we only need to test either s1[i] or s2[i] for
-             * '\0', since we know they are equal. */
-            return s1[i] - s2[i];
+    /* bytes up to a word boundary of s1 */
+    for (; n && ((uint32_t)s1 & 0x3); n--, s1++, s2++) {
+        if (*s1 != *s2 || *s1 == '\0')
+            return *s1 - *s2;
+    }
+
+    /* whole words while s2 lines up too and both are equal with no end in them */
+    if (!((uint32_t)s2 & 0x3)) {
+        for (; n >= 4; n -= 4, s1 += 4, s2 += 4) {
+            if (*(const word_t*)s1 != *(const word_t*)s2 || HAS_ZERO(*(const word_t*)s1))
+                break;
         }
     }
+
+    /* the word that differs or ends, or everything if s2 is misaligned */
+    for (; n; n--, s1++, s2++) {
+        if (*s1 != *s2 || *s1 == '\0')
+            return *s1 - *s2;
+    }
     return FSUCCESS;
 }
 
@@ -502,15 +1127,36 @@ int8_t* strncpy(int8_t* dest, const int8_t* src, uint32_t n) {
     return dest;
 }
 
+/* int32_t bad_userspace_addr(const void* addr, int32_t len)
+ * Inputs: const void* addr = start of a buffer passed in by a program
+ *              int32_t len = size of the buffer in bytes
+ * Return Value: 0 if the whole buffer lies in the program's 4MB page,
+ *               1 otherwise
+ * Function: validates pointers handed to system calls */
+int32_t bad_userspace_addr(const void* addr, int32_t len) {
+    uint32_t start = (uint32_t)addr;
+
+    if (len < 0)
+        return 1;
+    if (start < PROGRAM_SEGMENT || start >= PROGRAM_SEGMENT + MB_4)
+        return 1;
+    if ((uint32_t)len > PROGRAM_SEGMENT + MB_4 - start)
+        return 1;
+    return 0;
+}
+
 /* void test_interrupts(void)
  * Inputs: void
  * Return Value: void
  * Function: increments video memory. To be used to test rtc */
 void test_interrupts(void) {
-    int32_t i;
-    for (i = 0; i < NUM_ROWS * NUM_COLS; i++) {
-        video_mem[i << 1]++;
+    int32_t x, y;
+    for (y = 0; y < NUM_ROWS; y++) {
+        for (x = 0; x < NUM_COLS; x++) {
+            SCREEN_CELL(x, y)[0]++;
+        }
     }
+    mark_screen_dirty();
 }
 
 /* void set_cursor_position(int32_t x, int32_t y)
@@ -518,14 +1164,14 @@ void test_interrupts(void) {
  * Return Value: 0
  * Function: setst the x andd y positions of the cursors*/
 int32_t set_cursor_position(int32_t x, int32_t y){
+    console_lock++;
     if(x >= 0 && x < NUM_COLS){
         screen_x = x;
     }
     else{
         if(y+1 < NUM_ROWS){
             set_cursor_position(0, screen_y+1); // move to the next line because we finished this one
-            outw(((int)HEX_E) | ((NUM_COLS*screen_y + screen_x) & ((int)TOP_BITS)), ((int)CURSOR));
-            outw(((int)HEX_F) | (((NUM_COLS*screen_y + screen_x) << 8) & ((int)TOP_BITS)), ((int)CURSOR));	
+            console_lock--;
             return FSUCCESS;
         }
         scroll_one_unit_down();
@@ -537,8 +1183,8 @@ int32_t set_cursor_position(int32_t x, int32_t y){
     else{
         scroll_one_unit_down();
     }
-    outw(((int)HEX_E) | ((NUM_COLS*screen_y + screen_x) & ((int)TOP_BITS)), ((int)CURSOR));
-    outw(((int)HEX_F) | (((NUM_COLS*screen_y + screen_x) << 8) & ((int)TOP_BITS)), ((int)CURSOR));	
+    update_cursor();
+    console_lock--;
     return FSUCCESS;
 
 }
@@ -556,23 +1202,16 @@ int get_cursor_x(){
 /* void scroll_one_unit_down()
  * Inputs: None
  * Return Value: void
- * Function: moves all lines up one */
+ * Function: moves all lines up one.  The screen slides one row down
+ *           the video memory window by moving the CRTC start address;
+ *           only when it reaches the end of the window are the rows
+ *           copied back to the start */
 void scroll_one_unit_down(){
-    int32_t cols;
-	int32_t row;
-
-	for (row = 0; row < NUM_ROWS-1; row++) {   // go through the rows we need to move
-		for (cols = 0; cols < NUM_COLS; cols++) {  // go through the characters in the rows we are trying to move
-			*(uint8_t *)(video_mem + ((NUM_COLS*row + cols) << 1)) = *(uint8_t *)(video_mem + ((NUM_COLS*(row+1) + cols) << 1));
-		}
-	}
-    cols = 0;
-	// make the new line empty
-	for (cols = 0; cols < NUM_COLS; cols++) {
-		*(uint8_t *)(video_mem + ((NUM_COLS*row + cols) << 1)) = ' ';
-	}
-	set_cursor_position(0, NUM_ROWS-1);
-    
+    console_lock++;
+    screen_y = NUM_ROWS - 1;
+    new_line();
+    update_cursor();
+    console_lock--;
 }
 
 /* void backspace()
@@ -580,6 +1219,7 @@ void scroll_one_unit_down(){
  * Return Value: none
  * Function: interprets backspace as deleting the previous char.. handles the previous char on line before too */
 void backspace(){
+    console_lock++;
     if (screen_x == 0) { // beginning of the row, col 0.. we need to go up a line and to the complete right
 		set_cursor_position(NUM_COLS-1, screen_y-1);
 	}
@@ -587,6 +1227,8 @@ void backspace(){
 		set_cursor_position(screen_x-1, screen_y); // otherwise lest move left one
 	}
 
-	*(uint8_t *)(video_mem + ((NUM_COLS*screen_y + screen_x) << 1)) = ' ';  // load our location with an empty space
-    *(uint8_t *)(video_mem + ((NUM_COLS*screen_y + screen_x) << 1) + 1) = ATTRIB;
+	*(uint8_t *)SCREEN_CELL(screen_x, screen_y) = ' ';  // load our location with an empty space
+    *(uint8_t *)(SCREEN_CELL(screen_x, screen_y) + 1) = ATTRIB;
+    mark_dirty(screen_y);
+    console_lock--;
 }
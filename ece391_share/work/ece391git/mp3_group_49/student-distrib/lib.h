@@ -16,15 +16,18 @@
 int32_t printf(int8_t *format, ...);
 void putc(uint8_t c);
 int32_t puts(int8_t *s);
+void console_write(const int8_t* buf, int32_t n);
 int8_t *itoa(uint32_t value, int8_t* buf, int32_t radix);
 int8_t *strrev(int8_t* s);
 uint32_t strlen(const int8_t* s);
 void clear(void);
 
 void* memset(void* s, int32_t c, uint32_t n);
+void* memset_stosl(void* s, int32_t c, uint32_t n);
 void* memset_word(void* s, int32_t c, uint32_t n);
 void* memset_dword(void* s, int32_t c, uint32_t n);
 void* memcpy(void* dest, const void* src, uint32_t n);
+void* memcpy_movsl(void* dest, const void* src, uint32_t n);
 void* memmove(void* dest, const void* src, uint32_t n);
 int32_t strncmp(const int8_t* s1, const int8_t* s2, uint32_t n);
 int8_t* strcpy(int8_t* dest, const int8_t*src);
@@ -41,6 +44,16 @@ extern int32_t set_cursor_position(int32_t x, int32_t y);
 extern int get_cursor_y();
 extern int get_cursor_x();
 extern void scroll_one_unit_down();
+void reset_screen_origin(void);
+void console_flush(void);
+void console_defer(void);
+void console_suspend(void);
+void console_resume(void);
+void console_scroll_view(int32_t lines);
+int32_t console_busy(void);
+
+/* console_scroll_view argument that goes back to the live screen */
+#define CONSOLE_VIEW_LIVE   (-0x10000)
 void backspace();
 /* Port read functions */
 /* Inb reads a byte and returns its value as a zero-extended 32-bit
@@ -86,6 +99,67 @@ static inline uint32_t inl(port) {
     return val;
 }
 
+/* Reads the 64-bit time-stamp counter (cycles since reset) */
+static inline uint64_t rdtsc(void) {
+    uint64_t val;
+    asm volatile ("rdtsc"
+            : "=A"(val)
+            :
+            : "memory"
+    );
+    return val;
+}
+
+/* Reads a 64-bit model specific register */
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint64_t val;
+    asm volatile ("rdmsr"
+            : "=A"(val)
+            : "c"(msr)
+            : "memory"
+    );
+    return val;
+}
+
+/* Returns edx of cpuid leaf, the feature flags for leaf 1 */
+static inline uint32_t cpuid_edx(uint32_t leaf) {
+    uint32_t eax = leaf, ebx, ecx = 0, edx;
+    asm volatile ("cpuid"
+            : "+a"(eax), "=b"(ebx), "+c"(ecx), "=d"(edx)
+    );
+    return edx;
+}
+
+/* Divides *n by base in place and returns the remainder.  There is
+ * no libgcc for 64-bit division, so do it as two 32-bit divl steps,
+ * the high half first (like Linux's do_div) */
+static inline uint32_t div64_32(uint64_t* n, uint32_t base) {
+    uint32_t low = (uint32_t)*n;
+    uint32_t high = (uint32_t)(*n >> 32);
+    uint32_t qhigh = 0;
+    uint32_t rem;
+
+    if (high >= base) {
+        qhigh = high / base;
+        high %= base;
+    }
+    asm ("divl %2"
+            : "=a"(low), "=d"(rem)
+            : "rm"(base), "0"(low), "1"(high)
+    );
+    *n = ((uint64_t)qhigh << 32) | low;
+    return rem;
+}
+
+/* Writes a 64-bit model specific register */
+static inline void wrmsr(uint32_t msr, uint64_t val) {
+    asm volatile ("wrmsr"
+            :
+            : "c"(msr), "A"(val)
+            : "memory"
+    );
+}
+
 /* Writes a byte to a port */
 #define outb(data, port)                \
 do {                                    \
@@ -167,4 +241,17 @@ do {                                    \
     );                                  \
 } while (0)
 
+/* Compiler barrier
+ * Keeps the compiler from moving memory accesses across it, for data
+ * shared with interrupt handlers or user programs through a sequence
+ * counter or ring indices.  Emits no instruction */
+#define barrier()                       \
+do {                                    \
+    asm volatile (""                    \
+            :                           \
+            :                           \
+            : "memory"                  \
+    );                                  \
+} while (0)
+
 #endif /* _LIB_H */
@@ -22,10 +22,19 @@ void init_paging() {
         memset(&user_vid_table[i], 0, sizeof(ptable_entry_t));
     }
 
-    //Initialize Page Table Entry for VGA      
-    page_table[VGA_PT_IDX].present = 1;         
-    page_table[VGA_PT_IDX].rw = 1;
-    PTAB_SET_ADDR(VGA_PT_IDX, VGA_BASE_ADDR);
+    //Initialize Page Table Entries for the whole VGA text window
+    for (i = 0; i < VGA_WINDOW_PAGES; i++){
+        page_table[VGA_PT_IDX + i].present = 1;
+        page_table[VGA_PT_IDX + i].rw = 1;
+        PTAB_SET_ADDR(VGA_PT_IDX + i, VGA_BASE_ADDR + (i << PAGE_ALIGN_OFFSET));
+    }
+
+    //and the graphics window, for the mode X driver
+    for (i = 0; i < MODEX_WINDOW_PAGES; i++){
+        page_table[MODEX_PT_IDX + i].present = 1;
+        page_table[MODEX_PT_IDX + i].rw = 1;
+        PTAB_SET_ADDR(MODEX_PT_IDX + i, MODEX_BASE_ADDR + (i << PAGE_ALIGN_OFFSET));
+    }
     
     //Initialize Page Directory Entry for VGA
     page_directory[VGA_PD].present = 1;
@@ -106,7 +115,8 @@ int32_t map_large(uint32_t* v_addr, uint32_t* p_addr)
 /*
  * map_vmem
  * DESCRIPTION: Map video memory to physical address
- * INPUTS:  start -- location to map vmem to
+ * INPUTS:  start -- location to map vmem to, NULL to just restore
+ *                   the mapping of an already vidmapped process
  * OUTPUTS: none
  * RETURN VALUE: 0 for success
  * RESOURCES: https://wiki.osdev.org/Paging
@@ -123,12 +133,125 @@ int32_t map_vmem(uint8_t** start)
     /* clear cache */
     FLUSH_TLB();
 
-    *start = (uint8_t*)USER_VMEM;
+    if (start)
+        *start = (uint8_t*)USER_VMEM;
     return FSUCCESS;
     
 }
 
 
+/*
+ * map_modex
+ * DESCRIPTION: Map the mode X graphics window for user programs
+ * INPUTS:  start -- location to store the window's address in, NULL to
+ *                   just restore the mapping of a task switched back to
+ * OUTPUTS: none
+ * RETURN VALUE: 0 for success
+ * RESOURCES: https://wiki.osdev.org/Paging
+ * SIDE EFFECTS: none
+ */
+int32_t map_modex(uint8_t** start)
+{
+    uint32_t first = (USER_MODEX >> PAGE_ALIGN_OFFSET) & TABLE_BMASK;
+    int i;
+
+    for (i = 0; i < MODEX_WINDOW_PAGES; i++) {
+        user_vid_table[first + i].present = 1;
+        user_vid_table[first + i].rw = 1;
+        user_vid_table[first + i].us = 1;
+        user_vid_table[first + i].addr = (MODEX_BASE_ADDR >> PAGE_ALIGN_OFFSET) + i;
+    }
+
+    /* clear cache */
+    FLUSH_TLB();
+
+    if (start)
+        *start = (uint8_t*)USER_MODEX;
+    return FSUCCESS;
+}
+
+/*
+ * unmap_modex
+ * DESCRIPTION: Remove the mode X graphics window from user space
+ * INPUTS:  none
+ * OUTPUTS: none
+ * RETURN VALUE: 0 for success
+ * RESOURCES: https://wiki.osdev.org/Paging
+ * SIDE EFFECTS: none
+ */
+int32_t unmap_modex(void)
+{
+    uint32_t first = (USER_MODEX >> PAGE_ALIGN_OFFSET) & TABLE_BMASK;
+    int i;
+
+    for (i = 0; i < MODEX_WINDOW_PAGES; i++)
+        user_vid_table[first + i].present = 0;
+
+    /* clear cache */
+    FLUSH_TLB();
+
+    return FSUCCESS;
+}
+
+/*
+ * map_small_ro
+ * DESCRIPTION: Map a kernel page read-only for user programs
+ * INPUTS:  v_addr -- user virtual address, inside a region that already
+ *                    has a page table (e.g. next to video memory)
+ *          p_addr -- physical address of the page
+ * OUTPUTS: none
+ * RETURN VALUE: 0 for success, -1 if v_addr has no page table
+ * RESOURCES: https://wiki.osdev.org/Paging
+ * SIDE EFFECTS: the page is shared by every process
+ */
+int32_t map_small_ro(uint32_t* v_addr, uint32_t* p_addr)
+{
+    uint32_t dir_index = (uint32_t)v_addr >> DIR_BIT_OFF;
+    uint32_t table_index = ((uint32_t)v_addr >> PAGE_ALIGN_OFFSET) & (TABLE_BMASK);
+    ptable_entry_t* table = (ptable_entry_t*)(page_directory[dir_index].addr << PAGE_ALIGN_OFFSET);
+
+    if (!page_directory[dir_index].present || page_directory[dir_index].ps)
+        return FFAIL;
+
+    table[table_index].present = 1;
+    table[table_index].rw = 0;
+    table[table_index].us = 1;
+    table[table_index].addr = ((unsigned int) p_addr) >> PAGE_ALIGN_OFFSET;
+
+    /* clear cache */
+    FLUSH_TLB();
+
+    return FSUCCESS;
+}
+
+/*
+ * map_mmio
+ * DESCRIPTION: Identity map the large page holding a device's registers
+ * INPUTS:  p_addr -- physical address of the registers
+ * OUTPUTS: none
+ * RETURN VALUE: 0 for success
+ * RESOURCES: https://wiki.osdev.org/Paging
+ * SIDE EFFECTS: the page is kernel only and uncached, device
+ *               registers must not be served from the cache
+ */
+int32_t map_mmio(uint32_t* p_addr)
+{
+    uint32_t dir_index = (uint32_t)p_addr >> DIR_BIT_OFF;
+
+    page_directory[dir_index].present = 1;
+    page_directory[dir_index].rw = 1;
+    page_directory[dir_index].us = 0;
+    page_directory[dir_index].pwt = 1;
+    page_directory[dir_index].pcd = 1;
+    page_directory[dir_index].ps = 1; //4mb page
+    PDIR_SET_ADDR(dir_index, dir_index << DIR_BIT_OFF);
+
+    /* clear cache */
+    FLUSH_TLB();
+
+    return FSUCCESS;
+}
+
 /*
  * unmap_small
  * DESCRIPTION: Unmap short virtual address from physical address
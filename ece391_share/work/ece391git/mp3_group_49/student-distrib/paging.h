@@ -10,6 +10,12 @@
 
 #define VGA_PT_IDX          184
 #define VGA_BASE_ADDR       0xB8000
+/* text mode window B8000-BFFFF, the screen scrolls through all of it */
+#define VGA_WINDOW_PAGES    8
+#define MODEX_PT_IDX        160
+#define MODEX_BASE_ADDR     0xA0000
+/* graphics window A0000-AFFFF, mode X reaches all four planes through it */
+#define MODEX_WINDOW_PAGES  16
 #define VGA_PD              0
 #define USR_VGA_PD          0x21
 #define KERNAL_ADDR         0x400000
@@ -79,6 +85,10 @@ void init_paging(void);
 
 int32_t map_large(uint32_t* v_addr, uint32_t* p_addr);
 int32_t map_vmem(uint8_t** start);
+int32_t map_modex(uint8_t** start);
+int32_t unmap_modex(void);
+int32_t map_small_ro(uint32_t* v_addr, uint32_t* p_addr);
+int32_t map_mmio(uint32_t* p_addr);
 int32_t unmap_small(uint32_t* v_addr);
 int32_t unmap_large(uint32_t* v_addr);
 
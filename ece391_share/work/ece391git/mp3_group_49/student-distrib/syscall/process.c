@@ -1,4 +1,5 @@
 #include "process.h"
+#include "sched.h"
 
 #include <drivers/fs.h>
 #include <drivers/terminal.h>
@@ -6,23 +7,23 @@
 #include <x86_desc.h>
 #include <paging.h>
 
-#define STACK_OFF       4
 #define ELF_SIZE        4
 #define MAX_SHELLS      3
-#define MAX_PROCESS     6
 
-static uint32_t pid = 0;    // temporary pid counter
+/* parents waiting in wait_process for a child to halt */
+static wait_queue_t exit_wq;
 
-static fops_t stdin_ops = {terminal_open, terminal_close, terminal_read, NULL};
-static fops_t stdout_ops = {terminal_open, terminal_close, NULL, terminal_write};
+static fops_t stdin_ops = {terminal_open, terminal_close, terminal_read, NULL, NULL, terminal_ioctl};
+static fops_t stdout_ops = {terminal_open, terminal_close, NULL, terminal_write, NULL, terminal_ioctl};
 
 /*
  * create_process
  * DESCRIPTION: create PCB entry, map the memory and set TSS values
- * INPUTS: command -- input command from syscall execute
+ * INPUTS: command -- input command from syscall execute or spawn
  * OUTPUTS: none
- * RETURN VALUE: -1 on invalid input, status on success
- * SIDE EFFECTS: none
+ * RETURN VALUE: -1 on invalid input, pid of the new process on success
+ * SIDE EFFECTS: the new process inherits the caller's stdin and stdout
+ *               and runs once the scheduler gets to it
  */
 int32_t create_process(const uint8_t* command)
 {
@@ -31,7 +32,10 @@ int32_t create_process(const uint8_t* command)
     int i = 0;
     int j = 0;
     dentry_t dentry;
-    int8_t status;
+    int32_t pid;
+    pcb_t* parent = get_pcb_ptr();
+    /* the idle task (boot code) has nothing to inherit and no user memory */
+    int32_t has_parent = (parent->pid != IDLE_PID);
     /* elf header magic number from https://wiki.osdev.org/ELF */
     char elf_magic[ELF_SIZE] = {0x7F, 'E', 'L', 'F'};
     char elf_buf[ELF_SIZE];
@@ -41,11 +45,6 @@ int32_t create_process(const uint8_t* command)
         return FFAIL;
     }
 
-    if (pid >= MAX_PROCESS){
-    //if(pid >= MAX_SHELLS){
-        return FFAIL;
-    }
-
     /* create a filename string */
     while (command[i] != ' ' && command[i] != NULL && i<FNAME_MAX){
         filename[i] = command[i];
@@ -83,6 +82,12 @@ int32_t create_process(const uint8_t* command)
         }
     }
 
+    pid = alloc_pid();
+    if (pid == FFAIL){
+    //if(pid >= MAX_SHELLS){
+        return FFAIL;
+    }
+
     /* prepare to access file content */
     map_large((uint32_t*)PROGRAM_SEGMENT, (uint32_t*)(MB_8 + (pid)*MB_4));
     
@@ -90,15 +95,30 @@ int32_t create_process(const uint8_t* command)
     uint32_t file_entry_point = *((uint32_t*)(PROGRAM_ADDRESS + ELF_ENTRY_OFFSET));
 
     /* populate PCB struct for process */
-    pcb_t* pcb = (pcb_t*)(MB_8 - KB_8 - KB_8*pid);
+    pcb_t* pcb = PCB_ADDR(pid);
     pcb->pid = pid;
-    pcb->parent_pid = get_pcb_ptr()->pid;
+    pcb->parent_pid = parent->pid;
+    pcb->is_vidmapped = 0;
+    pcb->is_vgamapped = 0;
+    pcb->exit_status = 0;
+    pcb->wait_next = NULL;
 
     memset(pcb->args, 0, 128);
     strncpy((int8_t*)pcb->args, (int8_t*)args, j);
 
+    init_timer(&pcb->sleep_timer, NULL, 0);
+    fpu_init_state(pcb->fpu_state);
+
     /* set file desc array values for STDIN and STDOUT, clear the rest */
     for (i = 0; i < FILE_DESC_SIZE; i++) {
+        /* redirected stdin/stdout (e.g. a pipe) carry over to the child */
+        if ((i == STDIN || i == STDOUT) && has_parent &&
+            parent->file_desc_array[i].flags == IN_USE) {
+            pcb->file_desc_array[i] = parent->file_desc_array[i];
+            if (pcb->file_desc_array[i].file_ops->dup)
+                pcb->file_desc_array[i].file_ops->dup(&pcb->file_desc_array[i]);
+            continue;
+        }
         switch(i){
             case STDIN:
                 pcb->file_desc_array[i].file_ops = &stdin_ops;
@@ -113,62 +133,12 @@ int32_t create_process(const uint8_t* command)
         }
     }
 
-    /* populate tss */
-    tss.ss0 = KERNEL_DS;
-    tss.esp0 = MB_8 - KB_8*pid - STACK_OFF;
-
-    /* increment pid and run process; decrement it after termination */
-    pid++;
-
-    /* push use data segment, user stack pointer,
-     * flags, user code segment, entry point, then iret */
-    asm volatile("           \n\
-        movl %%ebp, %0       \n\
-        movl %%esp, %1       \n\
-        pushl $0x2B          \n\
-        pushl $0x83ffffc     \n\
-        pushfl               \n\
-        pop %%eax            \n\
-        orl $0x200, %%eax    \n\
-        push %%eax           \n\
-        pushl $0x23          \n\
-        pushl %3             \n\
-        call get_ret_addr    \n\
-        iret                 \n\
-        pop %2"
-        : "=m"(pcb->parent_ebp), "=m"(pcb->parent_esp), "=m"(status)
-        : "r"(file_entry_point)
-        : "%eax"
-    );
-
-    pid--;
+    /* put the caller's program back, the new one waits for the scheduler */
+    if (has_parent)
+        map_large((uint32_t*)PROGRAM_SEGMENT, (uint32_t*)(MB_8 + (parent->pid)*MB_4));
+    start_task(pcb, file_entry_point);
 
-    return status;
-}
-
-/*
- * get_ret_addr
- * DESCRIPTION: get the address of the next instruction
- * INPUTS: none
- * OUTPUTS: none
- * RETURN VALUE: none
- * SIDE EFFECTS: 
- */
-void get_ret_addr()
-{
-    uint32_t ret_eip;
-
-    // get the return address from the stack. 
-    asm volatile ("         \n\
-    mov 20(%%esp), %0"
-    : "=r"(ret_eip));
-
-    // add 1 so it skips over the iret;
-    ret_eip++;
-
-    // don't pass in pcb pointers cause this should be easy to call from asm
-    pcb_t* pcb = (pcb_t*)(MB_8 - KB_8 - KB_8*pid);
-    pcb->execute_return = ret_eip;
+    return pid;
 }
 
 /*
@@ -196,41 +166,105 @@ pcb_t* get_pcb_ptr()
 
 /*
  * end_process
- * DESCRIPTION: kill process, remove from PCB
- * INPUTS: status -- value specified to return to halt
+ * DESCRIPTION: kill process, leaving its exit status for the parent
+ * INPUTS: status -- value specified to return to halt, or
+ *                   EXCEPTION_STATUS
  * OUTPUTS: none
- * RETURN VALUE: 0 on success, -1 on bad pcb config
- * SIDE EFFECTS: unmaps the program memory
+ * RETURN VALUE: does not return
+ * SIDE EFFECTS: the PCB stays around as a zombie until the parent
+ *               collects it with wait_process
  */
-int32_t end_process(uint8_t status) {
+int32_t end_process(int32_t status) {
 
     pcb_t* pcb = get_pcb_ptr();
+    pcb_t* child;
+    int i;
 
-    /* restart the shell if the user quits the last layer */
-    if (!pcb->execute_return) {
-        if (pcb->pid == 0) {
-            pid = 0;            // this feels like a hack...
-            create_process((uint8_t*)"shell");
-        }
+    /* close whatever is still open so pipe ends get released */
+    for (i = 0; i < FILE_DESC_SIZE; i++) {
+        if (pcb->file_desc_array[i].flags == IN_USE &&
+            pcb->file_desc_array[i].file_ops->close)
+            pcb->file_desc_array[i].file_ops->close(i);
     }
 
     if (pcb->is_vidmapped)
         unmap_small((uint32_t*)USER_VMEM);
 
-    // unmap the current process memory before going back to the execute that called it
-    // remap original program memory
-    map_large((uint32_t*)PROGRAM_SEGMENT, (uint32_t*)(MB_8 + (get_pcb_ptr()->parent_pid)*MB_4));
+    /* a raw mode left behind would take the shell's echo with it */
+    terminal_exit(pcb->pid);
 
-    tss.esp0 = pcb->parent_esp;
+    /* hand back its share of the cpu if it was periodic */
+    (void)sched_set_periodic(0, 0);
 
-    /* give the control back */
-    asm volatile("              \
-        mov %0, %%ebp           \n\
-        mov %1, %%esp           \n\
-        push %%ebx              \n\
-        jmp *%%eax"
-        : 
-        :"m"(pcb->parent_ebp), "m"(pcb->parent_esp), "b"(status), "a"(pcb->execute_return)
-    );
+    /* stay off the cpu's run queue from here on, the stack is going away */
+    cli();
+
+    /* nobody will wait for our children, dead ones can go right away */
+    for (i = 1; i <= MAX_PROCESS; i++) {
+        child = PCB_ADDR(i);
+        if (child->state == TASK_FREE || child->parent_pid != pcb->pid)
+            continue;
+        if (child->state == TASK_ZOMBIE)
+            free_pid(child);
+        else
+            child->parent_pid = IDLE_PID;
+    }
+
+    if (pcb->parent_pid == IDLE_PID) {
+        free_pid(pcb);
+    } else {
+        pcb->exit_status = status;
+        pcb->state = TASK_ZOMBIE;
+        wake_up(&exit_wq);
+    }
+
+    schedule();
     return FSUCCESS;
 }
+
+/*
+ * wait_process
+ * DESCRIPTION: collect the exit status of a halted child
+ * INPUTS: pid     -- child to wait for, or WAIT_ANY
+ *         options -- WNOHANG to return right away if none has halted
+ * OUTPUTS: status -- exit status of the child, if not NULL
+ * RETURN VALUE: pid of the collected child, 0 with WNOHANG if no
+ *               child has halted yet, -1 if there is no such child
+ * SIDE EFFECTS: sleeps until a matching child halts
+ */
+int32_t wait_process(int32_t pid, int32_t* status, int32_t options)
+{
+    pcb_t* pcb = get_pcb_ptr();
+    pcb_t* child;
+    uint32_t flags;
+    int32_t found;
+    int32_t i;
+
+    cli_and_save(flags);
+    while (1) {
+        found = 0;
+        for (i = 1; i <= MAX_PROCESS; i++) {
+            child = PCB_ADDR(i);
+            if (child->state == TASK_FREE || child->parent_pid != pcb->pid)
+                continue;
+            if (pid != WAIT_ANY && pid != i)
+                continue;
+
+            found = 1;
+            if (child->state == TASK_ZOMBIE) {
+                if (status)
+                    *status = child->exit_status;
+                free_pid(child);
+                restore_flags(flags);
+                return i;
+            }
+        }
+
+        if (!found || (options & WNOHANG))
+            break;
+        sleep_on(&exit_wq);
+    }
+    restore_flags(flags);
+
+    return found ? 0 : FFAIL;
+}
@@ -2,12 +2,16 @@
 #define _PROCESS_H
 
 #include <types.h>
+#include <lib.h>
+#include <timer.h>
+#include <fpu.h>
 
 #define PCB_MASK            0xffffe000
 
 #define PROGRAM_SEGMENT     0x08000000
 #define PROGRAM_ADDRESS     0x08048000
 #define USER_VMEM           0x8400000
+#define USER_MODEX          0x8410000   /* mode X window, after the time page */
 
 #define LARGE_SIZE          0xffffffff
 
@@ -22,12 +26,50 @@
 
 #define IN_USE              1
 
+#define MAX_PROCESS         6
+#define STACK_OFF           4
+
+/* slot 0 belongs to the boot code, which idles once processes run */
+#define IDLE_PID            0
+
+/* PCB sits at the bottom of each process' 8kB kernel stack */
+#define PCB_ADDR(pid)       ((pcb_t*)(MB_8 - KB_8 - KB_8*(pid)))
+#define KSTACK_TOP(pid)     (MB_8 - KB_8*(pid) - STACK_OFF)
+
+/* task states */
+#define TASK_FREE           0       /* slot is not in use */
+#define TASK_RUNNABLE       1       /* running or waiting for the cpu */
+#define TASK_BLOCKED        2       /* waiting on a queue, timer or child */
+#define TASK_ZOMBIE         3       /* halted, exit status not collected */
+
+/* wait_process arguments */
+#define WAIT_ANY            -1      /* any child */
+#define WNOHANG             1       /* do not sleep if none has halted */
+
+/* exit status of a process killed by an exception */
+#define EXCEPTION_STATUS    256
+
+struct file_desc_t;
+
+/* cpu time of one task, in rdtsc cycles */
+typedef struct task_stats_t {
+    uint64_t user_cycles;           /* running in user mode */
+    uint64_t kernel_cycles;         /* running in the kernel, idle time for slot 0 */
+    uint64_t wait_cycles;           /* runnable but waiting for the cpu */
+    uint32_t nr_switches;           /* times it was switched in */
+    uint32_t deadline_misses;       /* periodic jobs not done by their deadline */
+} task_stats_t;
+
 /* file operations struct */
 typedef struct fops_t {
     int32_t (*open)(const uint8_t* filename);
     int32_t (*close)(int32_t fd);
     int32_t (*read)(int32_t fd, void* buf, int32_t nbytes);
     int32_t (*write)(int32_t fd, const void* buf, int32_t nbytes);
+    /* optional, called when a descriptor is copied to another slot */
+    void (*dup)(struct file_desc_t* file);
+    /* optional, device specific requests made through ioctl */
+    int32_t (*ioctl)(int32_t fd, uint32_t cmd, uint32_t arg);
 } fops_t;
 
 /* file descriptors struct */
@@ -42,19 +84,36 @@ typedef struct file_desc_t {
 typedef struct pcb_t {
     file_desc_t file_desc_array[FILE_DESC_SIZE];
     int32_t is_vidmapped;
+    int32_t is_vgamapped;           /* mode X window mapped by vgamap */
     uint8_t args[128];
-    uint32_t execute_return;
     int32_t pid;
-    int32_t parent_pid;
-    uint32_t parent_esp;
-    uint32_t parent_ebp;
+    int32_t parent_pid;             /* IDLE_PID once orphaned */
+    int32_t exit_status;
+    ktimer_t sleep_timer;
+    int32_t state;
+    uint32_t ksp;                   /* kernel esp while switched out */
+    struct pcb_t* wait_next;        /* next sleeper on the same wait queue */
+    task_stats_t stats;
+    uint64_t acct_stamp;            /* tsc of the last user/kernel switch */
+    uint64_t runnable_stamp;        /* tsc at which it last became runnable */
+    int32_t woken;                  /* runnable through sched_wakeup, not preemption */
+    uint32_t rt_period;             /* ticks between job releases, 0 if not periodic */
+    uint32_t rt_budget;             /* ticks each job may run at real time priority */
+    uint32_t rt_used;               /* ticks the current job has run */
+    uint32_t rt_deadline;           /* tick the current job has to be done by */
+    int32_t rt_done;                /* current job ended by blocking */
+    /* FPU and SSE registers while switched out, fxsave wants 16 byte alignment */
+    uint8_t fpu_state[FPU_STATE_SIZE] __attribute__((aligned(16)));
 } pcb_t;
 
-/* create and add process to PCB */
+/* create and add process to PCB, returns its pid */
 int32_t create_process(const uint8_t* command);
 
-/* kill and remove process from PCB */
-int32_t end_process(uint8_t status);
+/* kill process, leaving a zombie for its parent */
+int32_t end_process(int32_t status);
+
+/* collect a halted child, returns its pid */
+int32_t wait_process(int32_t pid, int32_t* status, int32_t options);
 
 /* access PCB pointer */
 pcb_t* get_pcb_ptr();
@@ -0,0 +1,110 @@
+#include "profile.h"
+#include "process.h"
+
+#include <lib.h>
+#include <interrupts/interrupts.h>
+
+static volatile int32_t profile_enabled = 0;
+
+static profile_sample_t samples[PROFILE_MAX_SAMPLES];
+
+/* samples taken, the next one profile_read hands out, ticks lost */
+static uint32_t nr_samples = 0;
+static uint32_t read_pos = 0;
+static uint32_t nr_dropped = 0;
+
+/*
+ * profile_tick
+ * DESCRIPTION: record the interrupted EIP, mode and pid
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: runs in the timer top half, reads irq_regs
+ */
+void profile_tick()
+{
+    profile_sample_t* s;
+
+    if (!profile_enabled)
+        return;
+
+    if (nr_samples == PROFILE_MAX_SAMPLES) {
+        nr_dropped++;
+        return;
+    }
+
+    s = &samples[nr_samples++];
+    s->eip = irq_regs->eip;
+    s->user = (irq_regs->cs & 3) != 0;
+    s->pid = get_pcb_ptr()->pid;
+}
+
+/*
+ * profile_start
+ * DESCRIPTION: throw away earlier samples and start sampling
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: covers every task, not only the caller
+ */
+void profile_start()
+{
+    uint32_t flags;
+
+    cli_and_save(flags);
+    nr_samples = 0;
+    read_pos = 0;
+    nr_dropped = 0;
+    profile_enabled = 1;
+    restore_flags(flags);
+}
+
+/*
+ * profile_stop
+ * DESCRIPTION: stop sampling
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: none
+ */
+void profile_stop()
+{
+    profile_enabled = 0;
+}
+
+/*
+ * profile_read
+ * DESCRIPTION: copy out samples that were not read yet, oldest first
+ * INPUTS: n -- room in buf, in samples
+ * OUTPUTS: buf -- the samples
+ * RETURN VALUE: number of samples copied
+ * SIDE EFFECTS: works while sampling is still on
+ */
+int32_t profile_read(profile_sample_t* buf, int32_t n)
+{
+    uint32_t flags;
+    int32_t count;
+
+    cli_and_save(flags);
+    count = nr_samples - read_pos;
+    if (count > n)
+        count = n;
+    memcpy(buf, &samples[read_pos], count * sizeof(profile_sample_t));
+    read_pos += count;
+    restore_flags(flags);
+
+    return count;
+}
+
+/*
+ * profile_dropped
+ * DESCRIPTION: how many ticks came after the buffer was full
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: ticks not sampled since profile_start
+ * SIDE EFFECTS: none
+ */
+uint32_t profile_dropped()
+{
+    return nr_dropped;
+}
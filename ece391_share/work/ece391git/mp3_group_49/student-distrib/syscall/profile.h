@@ -0,0 +1,53 @@
+/*
+ * Sampling profiler
+ *
+ * While profiling is on, every timer tick records where the cpu was
+ * interrupted: the EIP, whether it was in user or kernel mode, and
+ * the pid of the task running.  Samples go into a flat buffer that
+ * fills up once and then stops, so a profile always covers one
+ * contiguous stretch of time; ticks after that are only counted.
+ * Binning by function is left to the host, profsym.py symbolizes the
+ * samples against bootimg and the user ELF files.
+ *
+ * References Used:
+ *      Linux kernel/profile.c, readprofile(1)
+ *      gprof(1) flat profiles
+ */
+
+#ifndef _PROFILE_H
+#define _PROFILE_H
+
+#include <types.h>
+
+/* samples kept, 16 seconds at HZ 1000 */
+#define PROFILE_MAX_SAMPLES 16384
+
+/* commands of the profile syscall */
+#define PROFILE_OFF         0       /* stop sampling */
+#define PROFILE_ON          1       /* forget earlier samples, start */
+#define PROFILE_READ        2       /* take up to count samples */
+#define PROFILE_DROPPED     3       /* ticks missed because the buffer was full */
+
+/* where one tick found the cpu */
+typedef struct profile_sample_t {
+    uint32_t eip;
+    uint16_t pid;                   /* task running, 0 for idle */
+    uint16_t user;                  /* 1 if it was in user mode */
+} profile_sample_t;
+
+/* take a sample of the interrupted code, called from the timer tick */
+void profile_tick(void);
+
+/* clear the buffer and start sampling */
+void profile_start(void);
+
+/* stop sampling, the samples stay readable */
+void profile_stop(void);
+
+/* take up to n samples not read yet, returns how many */
+int32_t profile_read(profile_sample_t* buf, int32_t n);
+
+/* ticks that found the buffer full */
+uint32_t profile_dropped(void);
+
+#endif /* _PROFILE_H */
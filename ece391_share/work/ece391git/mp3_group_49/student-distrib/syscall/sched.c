@@ -0,0 +1,688 @@
+#include "sched.h"
+
+#include <x86_desc.h>
+#include <paging.h>
+
+#define USER_STACK          0x83ffffc
+#define USER_EFLAGS         0x202       /* IF set, reserved bit 1 */
+
+/* number of process slots in use, the idle task is not counted */
+static int32_t nr_tasks = 0;
+
+/* set by the PIT once the running task has used up its slice */
+static volatile int32_t need_resched = 0;
+static uint32_t slice_left = SCHED_SLICE;
+
+static sched_hist_t hist;
+
+/* share of the cpu promised to periodic tasks, in thousandths */
+static uint32_t rt_util = 0;
+
+/*
+ * idle
+ * DESCRIPTION: wait for the next interrupt with interrupts enabled
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: entered and left with interrupts disabled
+ */
+static void idle(void)
+{
+    /* sti only takes effect after hlt, so no wakeup slips in between */
+    asm volatile("sti; hlt; cli" ::: "memory");
+}
+
+/*
+ * rt_eligible
+ * DESCRIPTION: check if a task may run at real time priority now
+ * INPUTS: task -- task to check
+ * OUTPUTS: none
+ * RETURN VALUE: nonzero if it is periodic, runnable, and its current
+ *               job has neither ended nor used up its budget
+ * SIDE EFFECTS: none
+ */
+static int32_t rt_eligible(pcb_t* task)
+{
+    return task->rt_period && task->state == TASK_RUNNABLE &&
+           !task->rt_done && task->rt_used < task->rt_budget;
+}
+
+/*
+ * pick_rt
+ * DESCRIPTION: earliest deadline first over the periodic tasks
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: eligible task with the earliest deadline, NULL if
+ *               there is none
+ * SIDE EFFECTS: none
+ */
+static pcb_t* pick_rt(void)
+{
+    pcb_t* best = NULL;
+    pcb_t* task;
+    int32_t pid;
+
+    for (pid = 1; pid <= MAX_PROCESS; pid++) {
+        task = PCB_ADDR(pid);
+        if (rt_eligible(task) &&
+            (!best || !time_after_eq(task->rt_deadline, best->rt_deadline)))
+            best = task;
+    }
+
+    return best;
+}
+
+/*
+ * rt_release
+ * DESCRIPTION: close the jobs whose deadline has come and release
+ *              the next ones
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: counts a miss for every job still runnable at its
+ *               deadline; called once per tick
+ */
+static void rt_release(void)
+{
+    pcb_t* task;
+    int32_t pid;
+
+    for (pid = 1; pid <= MAX_PROCESS; pid++) {
+        task = PCB_ADDR(pid);
+        if (!task->rt_period || !time_after_eq(jiffies, task->rt_deadline))
+            continue;
+
+        if (task->state == TASK_RUNNABLE && !task->rt_done)
+            task->stats.deadline_misses++;
+
+        /* stay on the period grid unless we fell a whole period behind */
+        task->rt_deadline += task->rt_period;
+        if (time_after_eq(jiffies, task->rt_deadline))
+            task->rt_deadline = jiffies + task->rt_period;
+        task->rt_used = 0;
+        task->rt_done = 0;
+    }
+}
+
+/*
+ * rt_should_preempt
+ * DESCRIPTION: check if task ought to take the cpu from the running one
+ * INPUTS: task -- periodic task that just became eligible
+ * OUTPUTS: none
+ * RETURN VALUE: nonzero if the running task is not eligible itself or
+ *               has a later deadline
+ * SIDE EFFECTS: none
+ */
+static int32_t rt_should_preempt(pcb_t* task)
+{
+    pcb_t* curr = get_pcb_ptr();
+
+    if (task == curr)
+        return 0;
+
+    return !rt_eligible(curr) ||
+           !time_after_eq(task->rt_deadline, curr->rt_deadline);
+}
+
+/*
+ * pick_next
+ * DESCRIPTION: the periodic task with the earliest deadline, otherwise
+ *              round robin over the process slots, starting after curr
+ * INPUTS: curr -- task giving up the cpu
+ * OUTPUTS: none
+ * RETURN VALUE: next runnable task, curr itself if it is the only one,
+ *               the idle task if nothing can run
+ * SIDE EFFECTS: none
+ */
+static pcb_t* pick_next(pcb_t* curr)
+{
+    pcb_t* rt;
+    int32_t i, pid;
+
+    if ((rt = pick_rt()))
+        return rt;
+
+    /* pids 1..MAX_PROCESS, wrapping around to curr itself last */
+    for (i = 1; i <= MAX_PROCESS; i++) {
+        pid = (curr->pid + i - 1) % MAX_PROCESS + 1;
+        if (PCB_ADDR(pid)->state == TASK_RUNNABLE)
+            return PCB_ADDR(pid);
+    }
+
+    return PCB_ADDR(IDLE_PID);
+}
+
+/*
+ * hist_bucket
+ * DESCRIPTION: find the log2 bucket of a latency
+ * INPUTS: cycles -- latency in tsc cycles
+ * OUTPUTS: none
+ * RETURN VALUE: floor(log2(cycles)), the last bucket for anything
+ *               longer than it covers
+ * SIDE EFFECTS: none
+ */
+static uint32_t hist_bucket(uint64_t cycles)
+{
+    uint32_t low = (uint32_t)cycles;
+    uint32_t i = 0;
+
+    if (cycles >> 32)
+        return SCHED_HIST_BUCKETS - 1;
+
+    while (low >>= 1)
+        i++;
+
+    return i;
+}
+
+/*
+ * acct_switch
+ * DESCRIPTION: close prev's kernel time and next's run queue wait
+ * INPUTS: prev -- task being switched out
+ *         next -- task being switched in
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: records next's wait in the matching histogram
+ */
+static void acct_switch(pcb_t* prev, pcb_t* next)
+{
+    uint64_t now = rdtsc();
+    uint64_t waited;
+
+    /* prev always leaves from inside the kernel */
+    prev->stats.kernel_cycles += now - prev->acct_stamp;
+    if (prev->state == TASK_RUNNABLE) {
+        prev->runnable_stamp = now;
+        prev->woken = 0;
+    }
+
+    next->acct_stamp = now;
+    next->stats.nr_switches++;
+
+    /* the idle task is always runnable, its wait means nothing */
+    if (next->pid == IDLE_PID)
+        return;
+
+    waited = now - next->runnable_stamp;
+    next->stats.wait_cycles += waited;
+    if (next->woken)
+        hist.wakeup[hist_bucket(waited)]++;
+    else
+        hist.preempt[hist_bucket(waited)]++;
+}
+
+/*
+ * switch_to
+ * DESCRIPTION: install next's address space and kernel stack
+ * INPUTS: prev -- task being switched out
+ *         next -- task to switch to
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: returns once prev is scheduled again
+ */
+static void switch_to(pcb_t* prev, pcb_t* next)
+{
+    /* the idle task never touches user memory, leave it as it is */
+    if (next->pid != IDLE_PID) {
+        map_large((uint32_t*)PROGRAM_SEGMENT, (uint32_t*)(MB_8 + next->pid*MB_4));
+
+        if (next->is_vidmapped)
+            map_vmem(NULL);
+        else
+            unmap_small((uint32_t*)USER_VMEM);
+
+        if (next->is_vgamapped)
+            map_modex(NULL);
+        else
+            unmap_modex();
+    }
+
+    tss.esp0 = KSTACK_TOP(next->pid);
+
+    /* every task has its own FPU and SSE registers */
+    fpu_save_state(prev->fpu_state);
+    fpu_restore_state(next->fpu_state);
+
+    acct_switch(prev, next);
+    context_switch(&prev->ksp, next->ksp);
+}
+
+/*
+ * init_sched
+ * DESCRIPTION: mark every process slot free and turn the caller
+ *              into the idle task
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: must run on the boot stack, which is slot 0's
+ */
+void init_sched()
+{
+    int32_t i;
+
+    for (i = 0; i <= MAX_PROCESS; i++) {
+        PCB_ADDR(i)->pid = i;
+        PCB_ADDR(i)->state = TASK_FREE;
+        PCB_ADDR(i)->rt_period = 0;
+    }
+
+    /* always runnable, picked only when nothing else is */
+    PCB_ADDR(IDLE_PID)->state = TASK_RUNNABLE;
+    PCB_ADDR(IDLE_PID)->acct_stamp = rdtsc();
+}
+
+/*
+ * alloc_pid
+ * DESCRIPTION: reserve a free PCB slot
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: pid of the slot, -1 if all are taken
+ * SIDE EFFECTS: the slot is blocked until the caller makes it runnable
+ */
+int32_t alloc_pid()
+{
+    uint32_t flags;
+    int32_t i;
+
+    cli_and_save(flags);
+    for (i = 1; i <= MAX_PROCESS; i++) {
+        if (PCB_ADDR(i)->state == TASK_FREE) {
+            PCB_ADDR(i)->state = TASK_BLOCKED;
+            memset(&PCB_ADDR(i)->stats, 0, sizeof(task_stats_t));
+            PCB_ADDR(i)->rt_period = 0;
+            nr_tasks++;
+            restore_flags(flags);
+            return i;
+        }
+    }
+    restore_flags(flags);
+
+    return FFAIL;
+}
+
+/*
+ * free_pid
+ * DESCRIPTION: give a PCB slot back
+ * INPUTS: task -- PCB of the slot
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: if task is the caller, keep interrupts off until it
+ *               has switched away, its stack may be handed out again
+ */
+void free_pid(pcb_t* task)
+{
+    uint32_t flags;
+
+    cli_and_save(flags);
+    task->state = TASK_FREE;
+    nr_tasks--;
+    restore_flags(flags);
+}
+
+/*
+ * start_task
+ * DESCRIPTION: build the kernel stack of a task that has never run,
+ *              so the first switch to it lands in task_entry and
+ *              irets to the program's entry point
+ * INPUTS: task  -- PCB of the new task
+ *         entry -- user mode entry point
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: makes the task runnable
+ */
+void start_task(pcb_t* task, uint32_t entry)
+{
+    uint32_t* sp = (uint32_t*)KSTACK_TOP(task->pid);
+
+    /* iret frame */
+    *--sp = USER_DS;
+    *--sp = USER_STACK;
+    *--sp = USER_EFLAGS;
+    *--sp = USER_CS;
+    *--sp = entry;
+
+    /* return address and callee saved registers for context_switch */
+    *--sp = (uint32_t)task_entry;
+    *--sp = 0;      /* ebp */
+    *--sp = 0;      /* ebx */
+    *--sp = 0;      /* esi */
+    *--sp = 0;      /* edi */
+
+    task->ksp = (uint32_t)sp;
+    sched_wakeup(task);
+}
+
+/*
+ * schedule
+ * DESCRIPTION: switch to the next runnable task, or to the idle task
+ *              if there is none; the caller stays runnable unless it
+ *              has blocked itself
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: may not return for a long time
+ */
+void schedule()
+{
+    uint32_t flags;
+    pcb_t* prev;
+    pcb_t* next;
+
+    cli_and_save(flags);
+
+    prev = get_pcb_ptr();
+    need_resched = 0;
+    slice_left = SCHED_SLICE;
+
+    next = pick_next(prev);
+    if (next != prev)
+        switch_to(prev, next);
+
+    restore_flags(flags);
+}
+
+/*
+ * sched_tick
+ * DESCRIPTION: charge a PIT tick to the running task and release
+ *              periodic jobs that are due
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: requests a reschedule once the slice or budget runs
+ *               out, or a periodic task with an earlier deadline is
+ *               waiting
+ */
+void sched_tick()
+{
+    pcb_t* curr = get_pcb_ptr();
+    pcb_t* rt;
+
+    /* periodic tasks run on their budget instead of a slice */
+    if (rt_eligible(curr)) {
+        if (++curr->rt_used >= curr->rt_budget)
+            need_resched = 1;
+    } else if (curr->pid != IDLE_PID && slice_left && !--slice_left) {
+        need_resched = 1;
+    }
+
+    rt_release();
+
+    if ((rt = pick_rt()) && rt_should_preempt(rt))
+        need_resched = 1;
+}
+
+/*
+ * sched_preempt
+ * DESCRIPTION: reschedule if the running task's slice is over
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: only called right before an iret to user mode
+ */
+void sched_preempt()
+{
+    if (need_resched)
+        schedule();
+}
+
+/*
+ * sched_block
+ * DESCRIPTION: take the current task off the cpu until someone
+ *              calls sched_wakeup on it
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: call with interrupts disabled; the idle task never
+ *               blocks, it just waits for one interrupt
+ */
+void sched_block()
+{
+    if (get_pcb_ptr()->pid == IDLE_PID) {
+        idle();
+        return;
+    }
+
+    /* blocking ends the current job of a periodic task */
+    get_pcb_ptr()->rt_done = 1;
+    get_pcb_ptr()->state = TASK_BLOCKED;
+    schedule();
+}
+
+/*
+ * sched_wakeup
+ * DESCRIPTION: make a blocked task runnable
+ * INPUTS: task -- task to wake
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: safe to call from bottom halves
+ */
+void sched_wakeup(pcb_t* task)
+{
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if (task->state == TASK_BLOCKED) {
+        task->state = TASK_RUNNABLE;
+        task->runnable_stamp = rdtsc();
+        task->woken = 1;
+
+        if (rt_eligible(task) && rt_should_preempt(task))
+            need_resched = 1;
+    }
+    restore_flags(flags);
+}
+
+/* thousandths of the cpu a periodic task may take, rounded up so the
+ * shares never add up to less than what is handed out */
+static uint32_t rt_share(uint32_t period, uint32_t budget)
+{
+    return period ? (budget * RT_UTIL_MAX + period - 1) / period : 0;
+}
+
+/*
+ * sched_set_periodic
+ * DESCRIPTION: move the current task into the periodic class, or
+ *              back to round robin
+ * INPUTS: period -- ticks between job releases, 0 to leave the class
+ *         budget -- ticks each job may run ahead of round robin tasks
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if the values are out of range or
+ *               the periodic tasks would ask for more than the cpu
+ * SIDE EFFECTS: the first job is released right away
+ */
+int32_t sched_set_periodic(uint32_t period, uint32_t budget)
+{
+    pcb_t* curr = get_pcb_ptr();
+    uint32_t flags;
+    uint32_t util;
+
+    if (curr->pid == IDLE_PID)
+        return FFAIL;
+    if (period && (period > RT_PERIOD_MAX || !budget || budget > period))
+        return FFAIL;
+
+    cli_and_save(flags);
+
+    util = rt_util - rt_share(curr->rt_period, curr->rt_budget) +
+           rt_share(period, budget);
+    if (util > RT_UTIL_MAX) {
+        restore_flags(flags);
+        return FFAIL;
+    }
+
+    rt_util = util;
+    curr->rt_period = period;
+    curr->rt_budget = budget;
+    curr->rt_used = 0;
+    curr->rt_done = 0;
+    curr->rt_deadline = jiffies + period;
+
+    restore_flags(flags);
+    return FSUCCESS;
+}
+
+/*
+ * acct_kernel_entry
+ * DESCRIPTION: charge the time since the last stamp to user mode
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: only called on entry to the kernel from user mode,
+ *               with interrupts disabled
+ */
+void acct_kernel_entry()
+{
+    pcb_t* curr = get_pcb_ptr();
+    uint64_t now = rdtsc();
+
+    curr->stats.user_cycles += now - curr->acct_stamp;
+    curr->acct_stamp = now;
+}
+
+/*
+ * acct_kernel_exit
+ * DESCRIPTION: charge the time since the last stamp to the kernel
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: only called right before an iret to user mode
+ */
+void acct_kernel_exit()
+{
+    pcb_t* curr = get_pcb_ptr();
+    uint64_t now = rdtsc();
+
+    curr->stats.kernel_cycles += now - curr->acct_stamp;
+    curr->acct_stamp = now;
+}
+
+/*
+ * sched_task_stats
+ * DESCRIPTION: snapshot the cpu time of a task
+ * INPUTS: pid -- task to look at, IDLE_PID for the idle task
+ * OUTPUTS: stats -- user, kernel and wait cycles and switch count
+ * RETURN VALUE: 0 on success, -1 if pid is not in use
+ * SIDE EFFECTS: none
+ */
+int32_t sched_task_stats(int32_t pid, task_stats_t* stats)
+{
+    uint32_t flags;
+    pcb_t* task;
+
+    if (pid < IDLE_PID || pid > MAX_PROCESS)
+        return FFAIL;
+
+    task = PCB_ADDR(pid);
+
+    cli_and_save(flags);
+    if (task->state == TASK_FREE) {
+        restore_flags(flags);
+        return FFAIL;
+    }
+    memcpy(stats, &task->stats, sizeof(task_stats_t));
+
+    /* the caller is in the kernel right now, count that too */
+    if (task == get_pcb_ptr())
+        stats->kernel_cycles += rdtsc() - task->acct_stamp;
+    restore_flags(flags);
+
+    return FSUCCESS;
+}
+
+/*
+ * sched_get_hist
+ * DESCRIPTION: snapshot the run queue latency histograms
+ * INPUTS: none
+ * OUTPUTS: out -- copy of the histograms
+ * RETURN VALUE: none
+ * SIDE EFFECTS: none
+ */
+void sched_get_hist(sched_hist_t* out)
+{
+    uint32_t flags;
+
+    cli_and_save(flags);
+    memcpy(out, &hist, sizeof(sched_hist_t));
+    restore_flags(flags);
+}
+
+/*
+ * wait_queue_init
+ * DESCRIPTION: prepare an empty wait queue
+ * INPUTS: wq -- queue to set up
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: none
+ */
+void wait_queue_init(wait_queue_t* wq)
+{
+    wq->head = NULL;
+}
+
+/*
+ * sleep_on
+ * DESCRIPTION: queue the current task on wq and block it
+ * INPUTS: wq -- queue to sleep on
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: call with interrupts disabled, use wait_event to
+ *               recheck the condition
+ */
+void sleep_on(wait_queue_t* wq)
+{
+    pcb_t* curr = get_pcb_ptr();
+
+    if (curr->pid == IDLE_PID) {
+        idle();
+        return;
+    }
+
+    curr->wait_next = wq->head;
+    wq->head = curr;
+    sched_block();
+}
+
+/*
+ * wake_up
+ * DESCRIPTION: wake every task sleeping on wq
+ * INPUTS: wq -- queue to empty
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: safe to call from bottom halves
+ */
+void wake_up(wait_queue_t* wq)
+{
+    uint32_t flags;
+    pcb_t* task;
+
+    cli_and_save(flags);
+    while ((task = wq->head)) {
+        wq->head = task->wait_next;
+        task->wait_next = NULL;
+        sched_wakeup(task);
+    }
+    restore_flags(flags);
+}
+
+/*
+ * cpu_idle
+ * DESCRIPTION: body of the idle task; runs whoever is runnable and
+ *              halts the processor when nobody is
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: does not return
+ * SIDE EFFECTS: starts the shell, and starts it again whenever the
+ *               last process has exited
+ */
+void cpu_idle()
+{
+    while (1) {
+        if (!nr_tasks)
+            (void)create_process((uint8_t*)"shell");
+
+        cli();
+        schedule();
+        idle();
+        sti();
+    }
+}
@@ -0,0 +1,139 @@
+/*
+ * Round robin scheduler and wait queues
+ *
+ * Every process owns one of the MAX_PROCESS PCB slots; the runnable
+ * ones take turns on the cpu, switched either voluntarily when they
+ * block or by the PIT once their time slice is used up.
+ *
+ * A task may also declare itself periodic: every period ticks a new
+ * job is released with the end of the period as its deadline, and
+ * up to budget ticks of it run ahead of all round robin tasks,
+ * earliest deadline first.  A job ends when the task blocks (usually
+ * waiting for its next frame); one that is still runnable when its
+ * deadline passes counts as a miss.  Once a job has used its budget
+ * or ended, the task falls back to round robin until the next
+ * release.  The budgets of all periodic tasks together may not ask
+ * for more than the whole cpu.  Preemption only happens on the way
+ * back to user mode, so kernel code never has to worry about being
+ * switched out between two instructions.  The boot code stays behind
+ * as the idle task in slot 0 and only gets the cpu when nothing else
+ * is runnable.
+ *
+ * A task that has to wait for something (pipe data, a key, a timer)
+ * puts itself on a wait queue and blocks; whoever produces the event
+ * wakes the queue up.
+ *
+ * Each task's cpu time is split into user, kernel and run queue wait
+ * time with rdtsc, stamped on every kernel entry and exit and on every
+ * switch.  How long a task waited between becoming runnable and getting
+ * the cpu also goes into a log2 histogram, kept separately for tasks
+ * that were woken up and tasks that were preempted.
+ *
+ * References Used:
+ *      https://wiki.osdev.org/Scheduling_Algorithms
+ *      https://wiki.osdev.org/Kernel_Multitasking
+ */
+
+#ifndef _SCHED_H
+#define _SCHED_H
+
+#include <types.h>
+#include <lib.h>
+#include "process.h"
+
+/* PIT ticks a task may run before it is preempted */
+#define SCHED_SLICE         10
+
+/* admission limit for the periodic class, in thousandths of the cpu */
+#define RT_UTIL_MAX         1000
+/* longest period accepted, keeps the utilization math in 32 bits */
+#define RT_PERIOD_MAX       1000000
+
+/* buckets of the latency histograms, bucket i counts [2^i, 2^(i+1)) cycles */
+#define SCHED_HIST_BUCKETS  32
+
+/* run queue latency histograms */
+typedef struct sched_hist_t {
+    uint32_t wakeup[SCHED_HIST_BUCKETS];    /* woken up until running */
+    uint32_t preempt[SCHED_HIST_BUCKETS];   /* preempted until running again */
+} sched_hist_t;
+
+/* list of tasks sleeping until some event */
+typedef struct wait_queue_t {
+    pcb_t* head;
+} wait_queue_t;
+
+/*
+ * sleep until cond holds; checking and going to sleep happen with
+ * interrupts off so a wake_up in between cannot be missed
+ */
+#define wait_event(wq, cond)                \
+do {                                        \
+    uint32_t _wflags;                       \
+    cli_and_save(_wflags);                  \
+    while (!(cond))                         \
+        sleep_on(wq);                       \
+    restore_flags(_wflags);                 \
+} while (0)
+
+/* mark every process slot free, the caller becomes the idle task */
+void init_sched(void);
+
+/* run the idle task, never returns */
+void cpu_idle(void);
+
+/* find a free pid, -1 if all slots are taken */
+int32_t alloc_pid(void);
+
+/* give a pid back once its task is done */
+void free_pid(pcb_t* task);
+
+/* make a freshly loaded task runnable at its user entry point */
+void start_task(pcb_t* task, uint32_t entry);
+
+/* give the cpu to the next runnable task */
+void schedule(void);
+
+/* account one PIT tick against the running task's slice */
+void sched_tick(void);
+
+/* called on the way back to user mode from an interrupt */
+void sched_preempt(void);
+
+/* block the current task until sched_wakeup; call with interrupts off */
+void sched_block(void);
+
+/* make a blocked task runnable again */
+void sched_wakeup(pcb_t* task);
+
+/* prepare an empty wait queue */
+void wait_queue_init(wait_queue_t* wq);
+
+/* queue the current task on wq and block; call with interrupts off */
+void sleep_on(wait_queue_t* wq);
+
+/* wake every task sleeping on wq */
+void wake_up(wait_queue_t* wq);
+
+/* make the current task periodic, or round robin again if period is 0 */
+int32_t sched_set_periodic(uint32_t period, uint32_t budget);
+
+/* charge time since the last stamp to user mode, on entry from user mode */
+void acct_kernel_entry(void);
+
+/* charge time since the last stamp to the kernel, right before an iret to user mode */
+void acct_kernel_exit(void);
+
+/* copy out a task's cpu time, -1 if the slot is free */
+int32_t sched_task_stats(int32_t pid, task_stats_t* stats);
+
+/* copy out the latency histograms */
+void sched_get_hist(sched_hist_t* out);
+
+/* switch kernel stacks, implemented in switch.S */
+void context_switch(uint32_t* prev_ksp, uint32_t next_ksp);
+
+/* first code a new task runs, pops the iret frame set up by spawn */
+void task_entry(void);
+
+#endif
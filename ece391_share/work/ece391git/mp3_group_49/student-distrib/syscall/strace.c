@@ -0,0 +1,188 @@
+#include "strace.h"
+#include "syscalls.h"
+#include "process.h"
+
+#include <lib.h>
+
+volatile int32_t strace_enabled = 0;
+
+static strace_rec_t ring[STRACE_RING_SIZE];
+static strace_stat_t stats[STRACE_NR_CALLS];
+
+/* records ever claimed, and the next one strace_read hands out */
+static volatile uint32_t ring_head = 0;
+static uint32_t ring_tail = 0;
+
+/*
+ * claim_slot
+ * DESCRIPTION: reserve the next ring position
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: position, the slot is position & STRACE_RING_MASK
+ * SIDE EFFECTS: atomic, safe against any other writer
+ */
+static uint32_t claim_slot(void)
+{
+    uint32_t pos = 1;
+
+    asm volatile("lock; xaddl %0, %1"
+                 : "+r"(pos), "+m"(ring_head)
+                 :
+                 : "memory");
+    return pos;
+}
+
+/*
+ * strace_log
+ * DESCRIPTION: record one call in the ring and the counters
+ * INPUTS: number, args -- the call as it was made
+ *         ret          -- what it returned
+ *         enter, exit  -- TSC around the call
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: overwrites the oldest record once the ring is full
+ */
+static void strace_log(uint32_t number, uint32_t* args, int32_t ret,
+                       uint64_t enter, uint64_t exit)
+{
+    uint32_t pos = claim_slot();
+    strace_rec_t* rec = &ring[pos & STRACE_RING_MASK];
+    strace_stat_t* stat = &stats[number];
+    uint32_t cycles = (uint32_t)(exit - enter);
+
+    rec->seq = 0;
+    barrier();
+    rec->pid = get_pcb_ptr()->pid;
+    rec->number = number;
+    memcpy(rec->args, args, sizeof(rec->args));
+    rec->ret = ret;
+    rec->tsc_enter = enter;
+    rec->tsc_exit = exit;
+    barrier();
+    rec->seq = pos + 1;
+
+    /*
+     * interrupt handlers never make syscalls and tasks only switch
+     * inside a call, so nothing else can be updating these right now
+     */
+    stat->count++;
+    stat->cycles += exit - enter;
+    if (ret < 0)
+        stat->errors++;
+    if (cycles > stat->max_cycles)
+        stat->max_cycles = cycles;
+}
+
+/*
+ * strace_call
+ * DESCRIPTION: traced stand-in for calling sys_call_table directly
+ * INPUTS: number -- syscall number, already range checked
+ *         arg0-2 -- ebx, ecx, edx of the caller
+ * OUTPUTS: none
+ * RETURN VALUE: whatever the syscall returns
+ * SIDE EFFECTS: logs the call; halt is logged before it runs since it
+ *               never comes back
+ */
+int32_t strace_call(uint32_t number, uint32_t arg0, uint32_t arg1, uint32_t arg2)
+{
+    uint32_t args[3];
+    uint64_t enter;
+    int32_t ret;
+
+    args[0] = arg0;
+    args[1] = arg1;
+    args[2] = arg2;
+
+    enter = rdtsc();
+    if (number == SYS_HALT)
+        strace_log(number, args, 0, enter, enter);
+
+    ret = sys_call_table[number](arg0, arg1, arg2);
+
+    strace_log(number, args, ret, enter, rdtsc());
+    return ret;
+}
+
+/*
+ * strace_start
+ * DESCRIPTION: clear the ring and counters and turn tracing on
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: records not read yet are dropped
+ */
+void strace_start()
+{
+    uint32_t flags;
+
+    cli_and_save(flags);
+    strace_enabled = 0;
+    memset(ring, 0, sizeof(ring));
+    memset(stats, 0, sizeof(stats));
+    ring_head = 0;
+    ring_tail = 0;
+    strace_enabled = 1;
+    restore_flags(flags);
+}
+
+/*
+ * strace_stop
+ * DESCRIPTION: turn tracing off
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: calls already inside strace_call still get logged
+ */
+void strace_stop()
+{
+    strace_enabled = 0;
+}
+
+/*
+ * strace_read
+ * DESCRIPTION: copy out finished records, oldest first
+ * INPUTS: count -- room in buf, in records
+ * OUTPUTS: buf -- the records
+ * RETURN VALUE: number of records copied
+ * SIDE EFFECTS: records that were overwritten before being read are
+ *               skipped; a record still being written ends the copy
+ */
+int32_t strace_read(strace_rec_t* buf, int32_t count)
+{
+    strace_rec_t* rec;
+    uint32_t flags;
+    int32_t n = 0;
+
+    cli_and_save(flags);
+
+    if (ring_head - ring_tail > STRACE_RING_SIZE)
+        ring_tail = ring_head - STRACE_RING_SIZE;
+
+    while (n < count && ring_tail != ring_head) {
+        rec = &ring[ring_tail & STRACE_RING_MASK];
+        if (rec->seq != ring_tail + 1)
+            break;
+        memcpy(&buf[n++], rec, sizeof(strace_rec_t));
+        ring_tail++;
+    }
+
+    restore_flags(flags);
+    return n;
+}
+
+/*
+ * strace_get_stats
+ * DESCRIPTION: copy out the per syscall counters
+ * INPUTS: none
+ * OUTPUTS: buf -- STRACE_NR_CALLS counters, indexed by syscall number
+ * RETURN VALUE: none
+ * SIDE EFFECTS: none
+ */
+void strace_get_stats(strace_stat_t* buf)
+{
+    uint32_t flags;
+
+    cli_and_save(flags);
+    memcpy(buf, stats, sizeof(stats));
+    restore_flags(flags);
+}
@@ -0,0 +1,76 @@
+/*
+ * System call tracing
+ *
+ * While tracing is on, both syscall entries (int 0x80 and sysenter)
+ * go through strace_call instead of straight to sys_call_table.  It
+ * takes the TSC around the call and logs pid, number, arguments,
+ * return value and both timestamps to a ring, and keeps a running
+ * count and latency per syscall number.  With tracing off the only
+ * cost is one compare in the entry path.
+ *
+ * The ring is written without locks: a writer claims its slot with
+ * an atomic add on the head and stamps the record's seq last, so the
+ * reader can tell a finished record from one still being filled in.
+ * When the reader falls behind the oldest records are overwritten.
+ *
+ * References Used:
+ *      Linux kernel/trace/ring_buffer.c
+ *      strace(1), ltrace(1)
+ */
+
+#ifndef _STRACE_H
+#define _STRACE_H
+
+#include <types.h>
+
+/* records kept, a power of two */
+#define STRACE_RING_SIZE    256
+#define STRACE_RING_MASK    (STRACE_RING_SIZE - 1)
+
+/* syscall numbers with their own counters, 0 is never used */
+#define STRACE_NR_CALLS     32
+
+/* commands of the strace syscall */
+#define STRACE_OFF          0       /* stop tracing */
+#define STRACE_ON           1       /* clear the ring and counters, start */
+#define STRACE_READ         2       /* take up to count records */
+#define STRACE_STATS        3       /* copy the STRACE_NR_CALLS counters */
+
+/* one traced call */
+typedef struct strace_rec_t {
+    uint32_t seq;                   /* position in the ring + 1, 0 while written */
+    int32_t pid;
+    uint32_t number;
+    uint32_t args[3];
+    int32_t ret;                    /* 0 for halt, which is logged on entry */
+    uint64_t tsc_enter;
+    uint64_t tsc_exit;
+} strace_rec_t;
+
+/* running totals of one syscall number */
+typedef struct strace_stat_t {
+    uint64_t cycles;                /* sum of exit - enter */
+    uint32_t count;
+    uint32_t errors;                /* calls that returned < 0 */
+    uint32_t max_cycles;
+} strace_stat_t;
+
+/* nonzero while tracing, checked by the entries in handlers.S */
+extern volatile int32_t strace_enabled;
+
+/* run a syscall and log it, called from handlers.S */
+int32_t strace_call(uint32_t number, uint32_t arg0, uint32_t arg1, uint32_t arg2);
+
+/* reset the ring and counters, then turn tracing on */
+void strace_start(void);
+
+/* turn tracing off, what was recorded stays readable */
+void strace_stop(void);
+
+/* copy out up to count finished records, oldest first */
+int32_t strace_read(strace_rec_t* buf, int32_t count);
+
+/* copy out the per syscall counters */
+void strace_get_stats(strace_stat_t* buf);
+
+#endif
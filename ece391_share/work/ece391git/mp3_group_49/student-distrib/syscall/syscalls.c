@@ -6,15 +6,23 @@
 #include <paging.h>
 #include <drivers/terminal.h>
 #include <drivers/rtc.h>
+#include <drivers/pipe.h>
+#include <drivers/serial.h>
+#include <drivers/vga.h>
+#include <klog.h>
+#include "strace.h"
+#include "profile.h"
 #include <x86_desc.h>
+#include <timer.h>
+#include <clocksource.h>
 
 /*
  * halt
  * DESCRIPTION: terminate a process
  * INPUTS: status -- value specified to return to callee
  * OUTPUTS: none
- * RETURN VALUE: 0 on success, -1 on bad pcb config
- * SIDE EFFECTS: unmaps the program memory
+ * RETURN VALUE: does not return
+ * SIDE EFFECTS: the parent collects status through waitpid
  */
 int32_t halt(uint8_t status)
 {
@@ -27,11 +35,19 @@ int32_t halt(uint8_t status)
  * INPUTS: command -- input command received from user
  * OUTPUTS: none
  * RETURN VALUE: -1 on invalid input, status on success
- * SIDE EFFECTS: none
+ * SIDE EFFECTS: same as spawn followed by waitpid on the new pid
  */
 int32_t execute (const uint8_t* command)
 {
-    return create_process(command);
+    int32_t pid, status;
+
+    pid = create_process(command);
+    if (pid == FFAIL)
+        return FFAIL;
+
+    if (wait_process(pid, &status, 0) == FFAIL)
+        return FFAIL;
+    return status;
 }
 
 /*
@@ -51,11 +67,15 @@ int32_t read (int32_t fd, void* buf, int32_t nbytes)
     /* parameter validation */
     if (!buf)
         return FFAIL;
-    if (fd < 0 || fd >= FILE_DESC_SIZE || fd == STDOUT)
+    if (fd < 0 || fd >= FILE_DESC_SIZE)
         return FFAIL;
     if (pcb->file_desc_array[fd].flags == !IN_USE)
         return FFAIL;
-    
+    /* e.g. stdout or the write end of a pipe */
+    if (!pcb->file_desc_array[fd].file_ops->read)
+        return FFAIL;
+
+
     /* use the appropriate read function */
     return pcb->file_desc_array[fd].file_ops->read(fd, buf, nbytes);
 }
@@ -75,31 +95,55 @@ int32_t write (int32_t fd, const void* buf, int32_t nbytes)
     /* parameter validation */
     if (!buf)
         return FFAIL;
-    if (fd < 0 || fd >= FILE_DESC_SIZE || fd == STDIN)
+    if (fd < 0 || fd >= FILE_DESC_SIZE)
         return FFAIL;
     if (pcb->file_desc_array[fd].flags == !IN_USE)
         return FFAIL;
+    /* e.g. stdin or the read end of a pipe */
+    if (!pcb->file_desc_array[fd].file_ops->write)
+        return FFAIL;
 
     /* use the appropriate write function */
     return pcb->file_desc_array[fd].file_ops->write(fd, buf, nbytes);
 }
 
+/* a device that has no entry in the file system image */
+typedef struct device_t {
+    const int8_t* name;
+    int32_t (*open)(const uint8_t* filename);
+} device_t;
+
+static device_t devices[] = {
+    {"serial", serial_open},
+    {"kmsg", klog_open},
+    {"vga", vga_open},
+};
+
+#define NR_DEVICES          (sizeof(devices) / sizeof(devices[0]))
+
 /*
  * open
  * DESCRIPTION: access file system
  * INPUTS: filename -- file name (and directory)
  * OUTPUTS: none
  * RETURN VALUE: -1
- * SIDE EFFECTS: not implemented
+ * SIDE EFFECTS: device names are looked up before the file system
  */
 int32_t open (const uint8_t* filename)
 {
     dentry_t dentry;
     int fd;
+    uint32_t i;
 
     /* parameter validation */
     if (!filename)
         return FFAIL;
+
+    for (i = 0; i < NR_DEVICES; i++) {
+        if (!strncmp((const int8_t*)filename, devices[i].name, strlen(devices[i].name) + 1))
+            return devices[i].open(filename);
+    }
+
     if (read_dentry_by_name(filename, &dentry)){
         return FFAIL;
     }
@@ -199,6 +243,8 @@ int32_t vidmap (uint8_t** screen_start)
     /* update flag */
     pcb->is_vidmapped = 1;
 
+    /* the program draws at the start of video memory, show that part */
+    reset_screen_origin();
     map_vmem(screen_start);
     return FSUCCESS;
 }
@@ -231,3 +277,410 @@ int32_t sigreturn (void)
 {
     return FFAIL;
 }
+
+/*
+ * nanosleep
+ * DESCRIPTION: suspend the calling process for at least the
+ *              requested interval, using its own wheel timer
+ * INPUTS:  req -- interval to sleep for
+ *          rem -- if not NULL, receives the time left unslept
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 on a bad interval or pointer
+ * SIDE EFFECTS: rounds the interval up to whole ticks of 1/HZ
+ */
+int32_t nanosleep (const timespec_t* req, timespec_t* rem)
+{
+    pcb_t* pcb = get_pcb_ptr();
+    uint32_t ticks, left;
+
+    /* parameter validation */
+    if (!req || bad_userspace_addr(req, sizeof(timespec_t)))
+        return FFAIL;
+    if (rem && bad_userspace_addr(rem, sizeof(timespec_t)))
+        return FFAIL;
+    if (timespec_to_ticks(req, &ticks))
+        return FFAIL;
+
+    left = timer_sleep(&pcb->sleep_timer, ticks);
+
+    if (rem)
+        ticks_to_timespec(left, rem);
+    return FSUCCESS;
+}
+
+/*
+ * pipe
+ * DESCRIPTION: create a pipe and open both of its ends
+ * INPUTS: none
+ * OUTPUTS: fds -- read end in fds[0], write end in fds[1]
+ * RETURN VALUE: 0 on success, -1 on a bad pointer or if no pipe
+ *               or descriptor is free
+ * SIDE EFFECTS: none
+ */
+int32_t pipe (int32_t* fds)
+{
+    /* parameter validation */
+    if (!fds || bad_userspace_addr(fds, 2*sizeof(int32_t)))
+        return FFAIL;
+
+    return pipe_create(fds);
+}
+
+/*
+ * dup2
+ * DESCRIPTION: make newfd refer to the same file as oldfd
+ * INPUTS: oldfd -- open descriptor to copy
+ *         newfd -- slot to copy it to, closed first if open
+ * OUTPUTS: none
+ * RETURN VALUE: newfd on success, -1 on a bad descriptor
+ * SIDE EFFECTS: this is how the shell redirects stdin and stdout
+ */
+int32_t dup2 (int32_t oldfd, int32_t newfd)
+{
+    pcb_t* pcb = get_pcb_ptr();
+    file_desc_t* file;
+
+    /* parameter validation */
+    if (oldfd < 0 || oldfd >= FILE_DESC_SIZE)
+        return FFAIL;
+    if (newfd < 0 || newfd >= FILE_DESC_SIZE)
+        return FFAIL;
+    if (pcb->file_desc_array[oldfd].flags == !IN_USE)
+        return FFAIL;
+    if (oldfd == newfd)
+        return newfd;
+
+    /* the terminal refuses to close 0 and 1, the slot is replaced anyway */
+    file = &pcb->file_desc_array[newfd];
+    if (file->flags == IN_USE && file->file_ops->close)
+        file->file_ops->close(newfd);
+
+    *file = pcb->file_desc_array[oldfd];
+    if (file->file_ops->dup)
+        file->file_ops->dup(file);
+
+    return newfd;
+}
+
+/*
+ * spawn
+ * DESCRIPTION: load a new program and run it alongside the caller
+ * INPUTS: command -- program name and arguments, as for execute
+ * OUTPUTS: none
+ * RETURN VALUE: pid of the new process, -1 on invalid input
+ * SIDE EFFECTS: the new process gets copies of stdin and stdout,
+ *               its exit status is kept until waitpid collects it
+ */
+int32_t spawn (const uint8_t* command)
+{
+    return create_process(command);
+}
+
+/*
+ * waitpid
+ * DESCRIPTION: wait for a child to halt and collect its exit status
+ * INPUTS: pid     -- child to wait for, -1 for any child
+ *         options -- WNOHANG to only check, without sleeping
+ * OUTPUTS: status -- exit status of the child, if not NULL; 256 if
+ *                    it was killed by an exception
+ * RETURN VALUE: pid of the child, 0 with WNOHANG if none has halted
+ *               yet, -1 if the caller has no such child
+ * SIDE EFFECTS: frees the child's PCB slot
+ */
+int32_t waitpid (int32_t pid, int32_t* status, int32_t options)
+{
+    /* parameter validation */
+    if (status && bad_userspace_addr(status, sizeof(int32_t)))
+        return FFAIL;
+
+    return wait_process(pid, status, options);
+}
+
+/*
+ * taskstat
+ * DESCRIPTION: read where a task's cpu time went
+ * INPUTS: pid -- task to look at, 0 for the idle task
+ * OUTPUTS: stats -- user, kernel and run queue wait time in tsc
+ *                   cycles, and how often it was switched in
+ * RETURN VALUE: 0 on success, -1 if pid is not in use
+ * SIDE EFFECTS: none
+ */
+int32_t taskstat (int32_t pid, task_stats_t* stats)
+{
+    /* parameter validation */
+    if (bad_userspace_addr(stats, sizeof(task_stats_t)))
+        return FFAIL;
+
+    return sched_task_stats(pid, stats);
+}
+
+/*
+ * schedstat
+ * DESCRIPTION: read the run queue latency histograms
+ * INPUTS: none
+ * OUTPUTS: hist -- log2 histograms of cycles from wakeup and from
+ *                  preemption until the task ran again
+ * RETURN VALUE: 0 on success, -1 on a bad pointer
+ * SIDE EFFECTS: none
+ */
+int32_t schedstat (sched_hist_t* hist)
+{
+    /* parameter validation */
+    if (bad_userspace_addr(hist, sizeof(sched_hist_t)))
+        return FFAIL;
+
+    sched_get_hist(hist);
+    return FSUCCESS;
+}
+
+/*
+ * set_periodic
+ * DESCRIPTION: schedule the caller earliest deadline first: every
+ *              period a new job is released, due by the end of that
+ *              period, and budget of it runs ahead of ordinary tasks
+ * INPUTS: period -- ticks (1ms at HZ 1000) between releases, 0 to go
+ *                   back to ordinary round robin scheduling
+ *         budget -- ticks of cpu each job needs at most
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if budget is 0 or longer than period,
+ *               or the periodic tasks would need more than the cpu
+ * SIDE EFFECTS: blocking ends the current job; missed deadlines are
+ *               counted in taskstat
+ */
+int32_t set_periodic (uint32_t period, uint32_t budget)
+{
+    return sched_set_periodic(period, budget);
+}
+
+/*
+ * getpid
+ * DESCRIPTION: get the caller's process id
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: pid of the calling process
+ * SIDE EFFECTS: none
+ */
+int32_t getpid (void)
+{
+    return get_pcb_ptr()->pid;
+}
+
+/*
+ * multicall
+ * DESCRIPTION: run a batch of syscalls in order with one kernel entry
+ * INPUTS: calls -- array of syscall numbers and arguments
+ *         count -- number of entries, at most MULTICALL_MAX
+ * OUTPUTS: calls -- result of every call that ran
+ * RETURN VALUE: number of calls that succeeded, which is count unless
+ *               one failed; -1 if the array itself is bad
+ * SIDE EFFECTS: stops at the first call that fails; entries past it
+ *               keep their old result
+ */
+int32_t multicall (multicall_t* calls, int32_t count)
+{
+    int32_t i;
+
+    /* parameter validation */
+    if (count < 0 || count > MULTICALL_MAX ||
+        bad_userspace_addr(calls, count * sizeof(multicall_t)))
+        return FFAIL;
+
+    for (i = 0; i < count; i++) {
+        /* no nesting, a batch inside a batch would recurse */
+        if (calls[i].number < SYS_HALT || calls[i].number > SYS_CALL_LAST ||
+            calls[i].number == SYS_MULTICALL)
+            calls[i].result = FFAIL;
+        else
+            calls[i].result = sys_call_table[calls[i].number](calls[i].args[0],
+                                                              calls[i].args[1],
+                                                              calls[i].args[2]);
+        if (calls[i].result < 0)
+            break;
+    }
+
+    return i;
+}
+
+/*
+ * strace
+ * DESCRIPTION: control syscall tracing
+ * INPUTS: cmd   -- STRACE_ON clears what was recorded and starts,
+ *                  STRACE_OFF stops, STRACE_READ takes records,
+ *                  STRACE_STATS copies the per syscall counters
+ *         count -- room in buf for STRACE_READ, in records
+ * OUTPUTS: buf -- records or counters
+ * RETURN VALUE: number of records for STRACE_READ, 0 for the other
+ *               commands, -1 on a bad command or buffer
+ * SIDE EFFECTS: tracing covers every process, not just the caller
+ */
+int32_t strace (int32_t cmd, void* buf, int32_t count)
+{
+    switch (cmd) {
+        case STRACE_OFF:
+            strace_stop();
+            return FSUCCESS;
+        case STRACE_ON:
+            strace_start();
+            return FSUCCESS;
+        case STRACE_READ:
+            /* parameter validation */
+            if (count < 0 || count > STRACE_RING_SIZE ||
+                bad_userspace_addr(buf, count * sizeof(strace_rec_t)))
+                return FFAIL;
+            return strace_read(buf, count);
+        case STRACE_STATS:
+            /* parameter validation */
+            if (bad_userspace_addr(buf, STRACE_NR_CALLS * sizeof(strace_stat_t)))
+                return FFAIL;
+            strace_get_stats(buf);
+            return FSUCCESS;
+        default:
+            return FFAIL;
+    }
+}
+
+/*
+ * irqstat
+ * DESCRIPTION: read how often each IRQ line fired and how long its
+ *              handlers took
+ * INPUTS: none
+ * OUTPUTS: stats -- NR_IRQS entries, indexed by IRQ number
+ * RETURN VALUE: 0 on success, -1 on a bad pointer
+ * SIDE EFFECTS: none
+ */
+int32_t irqstat (irq_stat_t* stats)
+{
+    /* parameter validation */
+    if (bad_userspace_addr(stats, NR_IRQS * sizeof(irq_stat_t)))
+        return FFAIL;
+
+    irq_get_stats(stats);
+    return FSUCCESS;
+}
+
+/*
+ * clock_gettime
+ * DESCRIPTION: read a clock with TSC resolution
+ * INPUTS: clock -- CLOCK_MONOTONIC for time since boot, CLOCK_REALTIME
+ *                  for seconds since 1970
+ * OUTPUTS: ts -- the time in seconds and nanoseconds
+ * RETURN VALUE: 0 on success, -1 on a bad clock or pointer
+ * SIDE EFFECTS: none
+ */
+int32_t clock_gettime (int32_t clock, timespec_t* ts)
+{
+    /* parameter validation */
+    if (bad_userspace_addr(ts, sizeof(timespec_t)))
+        return FFAIL;
+
+    return clock_read(clock, ts);
+}
+
+/*
+ * kbd_read
+ * DESCRIPTION: take key events straight from the keyboard ring,
+ *              bypassing the terminal's line editing
+ * INPUTS: count -- room in events
+ *         flags -- KBD_NONBLOCK to return 0 when no key is waiting
+ * OUTPUTS: events -- key downs and ups with modifiers and TSC stamps,
+ *                    oldest first
+ * RETURN VALUE: number of events, -1 on a bad buffer or flags
+ * SIDE EFFECTS: blocks until a key arrives unless KBD_NONBLOCK;
+ *               events taken here are not seen by terminal reads
+ */
+int32_t kbd_read (key_event_t* events, int32_t count, int32_t flags)
+{
+    /* parameter validation */
+    if (count < 0 || count > KEY_RING_SIZE || (flags & ~KBD_NONBLOCK) ||
+        bad_userspace_addr(events, count * sizeof(key_event_t)))
+        return FFAIL;
+
+    if (!count)
+        return 0;
+    return keyboard_read_events(events, count, flags & KBD_NONBLOCK);
+}
+
+/*
+ * profile
+ * DESCRIPTION: control the sampling profiler
+ * INPUTS: cmd   -- PROFILE_ON clears the samples and starts,
+ *                  PROFILE_OFF stops, PROFILE_READ takes samples,
+ *                  PROFILE_DROPPED counts ticks that found no room
+ *         count -- room in buf for PROFILE_READ, in samples
+ * OUTPUTS: buf -- samples
+ * RETURN VALUE: number of samples for PROFILE_READ, of lost ticks for
+ *               PROFILE_DROPPED, 0 for the other commands, -1 on a bad
+ *               command or buffer
+ * SIDE EFFECTS: samples every process, not just the caller
+ */
+int32_t profile (int32_t cmd, void* buf, int32_t count)
+{
+    switch (cmd) {
+        case PROFILE_OFF:
+            profile_stop();
+            return FSUCCESS;
+        case PROFILE_ON:
+            profile_start();
+            return FSUCCESS;
+        case PROFILE_READ:
+            /* parameter validation */
+            if (count < 0 || count > PROFILE_MAX_SAMPLES ||
+                bad_userspace_addr(buf, count * sizeof(profile_sample_t)))
+                return FFAIL;
+            return profile_read(buf, count);
+        case PROFILE_DROPPED:
+            return profile_dropped();
+        default:
+            return FFAIL;
+    }
+}
+
+/*
+ * ioctl
+ * DESCRIPTION: pass a device specific request to the driver behind fd
+ * INPUTS: fd  -- open descriptor
+ *         cmd -- request, e.g. TTY_SETMODE for the terminal
+ *         arg -- argument of the request
+ * OUTPUTS: none
+ * RETURN VALUE: whatever the driver returns, -1 on a bad fd or if the
+ *               driver takes no requests
+ * SIDE EFFECTS: depends on the request
+ */
+int32_t ioctl (int32_t fd, uint32_t cmd, uint32_t arg)
+{
+    pcb_t* pcb = get_pcb_ptr();
+
+    /* parameter validation */
+    if (fd < 0 || fd >= FILE_DESC_SIZE)
+        return FFAIL;
+    if (pcb->file_desc_array[fd].flags == !IN_USE)
+        return FFAIL;
+    if (!pcb->file_desc_array[fd].file_ops->ioctl)
+        return FFAIL;
+
+    return pcb->file_desc_array[fd].file_ops->ioctl(fd, cmd, arg);
+}
+
+/*
+ * vgamap
+ * DESCRIPTION: map the mode X graphics window into user space at a
+ *              pre-set virtual address
+ * INPUTS: screen_start -- where to store the window's address
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 on a bad pointer or if the caller has
+ *               not opened "vga"
+ * SIDE EFFECTS: writes go to the planes chosen with VGA_SET_PLANES
+ */
+int32_t vgamap (uint8_t** screen_start)
+{
+    pcb_t* pcb = get_pcb_ptr();
+
+    /* parameter validation */
+    if (!screen_start || bad_userspace_addr(screen_start, sizeof(*screen_start)))
+        return FFAIL;
+    if (!vga_held())
+        return FFAIL;
+
+    pcb->is_vgamapped = 1;
+    return map_modex(screen_start);
+}
@@ -10,6 +10,27 @@
 #define _SYSCALLS_H
 
 #include <types.h>
+#include <timer.h>
+#include "sched.h"
+#include <interrupts/interrupts.h>
+#include <drivers/keyboard.h>
+
+/* handlers.S, every entry takes up to three register arguments */
+typedef int32_t (*sys_call_t)(uint32_t arg0, uint32_t arg1, uint32_t arg2);
+extern sys_call_t sys_call_table[];
+
+/* most calls one multicall may carry */
+#define MULTICALL_MAX       64
+
+/* one entry of a multicall batch */
+typedef struct multicall_t {
+    uint32_t number;                /* syscall number, not multicall itself */
+    uint32_t args[3];               /* what would go in ebx, ecx, edx */
+    int32_t result;                 /* filled in by the kernel */
+} multicall_t;
+
+/* kbd_read flags */
+#define KBD_NONBLOCK        1       /* return 0 instead of waiting for a key */
 
 /* required syscalls */
 /* terminate a process */
@@ -35,6 +56,42 @@ int32_t set_handler (int32_t signum, void* handler_address);
 /* copy hardware context that was on user-level stack back onto processor */
 int32_t sigreturn (void);
 
+/* extensions */
+/* suspend the calling process for the given interval */
+int32_t nanosleep (const timespec_t* req, timespec_t* rem);
+/* create a pipe, read end in fds[0] and write end in fds[1] */
+int32_t pipe (int32_t* fds);
+/* make newfd a copy of oldfd */
+int32_t dup2 (int32_t oldfd, int32_t newfd);
+/* start a program running next to the caller */
+int32_t spawn (const uint8_t* command);
+/* collect the exit status of a halted child */
+int32_t waitpid (int32_t pid, int32_t* status, int32_t options);
+/* read a task's user, kernel and run queue wait time */
+int32_t taskstat (int32_t pid, task_stats_t* stats);
+/* read the scheduler's latency histograms */
+int32_t schedstat (sched_hist_t* hist);
+/* run the caller as a periodic real time task */
+int32_t set_periodic (uint32_t period, uint32_t budget);
+/* pid of the caller, also the cheapest call for timing the entry path */
+int32_t getpid (void);
+/* run a batch of syscalls in one kernel entry */
+int32_t multicall (multicall_t* calls, int32_t count);
+/* switch syscall tracing on or off and read out what it recorded */
+int32_t strace (int32_t cmd, void* buf, int32_t count);
+/* read the per line interrupt statistics */
+int32_t irqstat (irq_stat_t* stats);
+/* read a clock with nanosecond resolution */
+int32_t clock_gettime (int32_t clock, timespec_t* ts);
+/* take raw key events, many per call */
+int32_t kbd_read (key_event_t* events, int32_t count, int32_t flags);
+/* switch the sampling profiler on or off and read its samples */
+int32_t profile (int32_t cmd, void* buf, int32_t count);
+/* device specific control, e.g. the terminal's line discipline */
+int32_t ioctl (int32_t fd, uint32_t cmd, uint32_t arg);
+/* map the mode X window (all planes via VGA_SET_PLANES) at USER_MODEX */
+int32_t vgamap (uint8_t** screen_start);
+
 /* "number syscalls 1-10" */
 enum syscall_list {
     SYS_HALT = 1,
@@ -47,7 +104,27 @@ enum syscall_list {
     SYS_VIDMAP,
     SYS_SET_HANDLER,
     SYS_SIGRETURN,
+    SYS_NANOSLEEP,
+    SYS_PIPE,
+    SYS_DUP2,
+    SYS_SPAWN,
+    SYS_WAITPID,
+    SYS_TASKSTAT,
+    SYS_SCHEDSTAT,
+    SYS_SET_PERIODIC,
+    SYS_GETPID,
+    SYS_MULTICALL,
+    SYS_STRACE,
+    SYS_IRQSTAT,
+    SYS_CLOCK_GETTIME,
+    SYS_KBD_READ,
+    SYS_PROFILE,
+    SYS_IOCTL,
+    SYS_VGAMAP,
 };
 
+/* highest syscall number, handlers.S checks eax against its own copy */
+#define SYS_CALL_LAST       SYS_VGAMAP
+
 
 #endif
@@ -4,6 +4,21 @@
 #include "drivers/fs.h"
 #include "drivers/terminal.h"
 #include "drivers/rtc.h"
+#include "interrupts/tasklet.h"
+#include "timer.h"
+#include "drivers/pipe.h"
+#include "syscall/sched.h"
+#include "timepage.h"
+#include "syscall/strace.h"
+#include "syscall/syscalls.h"
+#include "interrupts/interrupts.h"
+#include "clocksource.h"
+#include "syscall/profile.h"
+#include "paging.h"
+#include "drivers/serial.h"
+#include "klog.h"
+#include "drivers/vga.h"
+#include "fpu.h"
 
 #define PASS 1
 #define FAIL 0
@@ -259,6 +274,1170 @@ int rtc_test_cp2(){
 }
 
 /* Checkpoint 3 tests */
+
+/* Tasklet Test
+ * Asserts: RTC interrupts reach their bottom half through the
+ * 			tasklet queue without dropping work, and reports the
+ * 			worst case top half / bottom half cost in cycles
+ * Inputs: None
+ * Outputs: PASS if tasklets ran and none were dropped
+ * Side Effects: opens the RTC at its default frequency
+ * Coverage: deferred interrupt work, latency accounting
+ * Files: tasklet.h/c, interrupts.c, handlers.S
+ */
+int tasklet_latency_test(){
+	TEST_HEADER;
+	tasklet_stats_t before, after;
+	int i;
+
+	tasklet_get_stats(&before);
+	(void)rtc_open(0);
+	for(i=0; i<10; i++){
+		(void)rtc_read(0, "", 0);
+	}
+	tasklet_get_stats(&after);
+
+	printf(" irq max: %u cycles, bottom half max: %u cycles\n",
+			after.irq_max_cycles, after.bh_max_cycles);
+	if(after.queued == before.queued || after.dropped != before.dropped){
+		return FAIL;
+	}
+	return PASS;
+}
+
+/* Timer Wheel Test helpers */
+#define WHEEL_TEST_TIMERS	5
+static volatile int wheel_fired[WHEEL_TEST_TIMERS];
+static volatile int wheel_order;
+
+static void wheel_test_func(uint32_t data){
+	wheel_fired[data] = ++wheel_order;
+}
+
+/* Timer Wheel Test
+ * Asserts: timers on the near level and on a cascaded level fire
+ * 			in order of expiry, and a cancelled timer never fires
+ * Inputs: None
+ * Outputs: PASS if the firing order matches the expiry order
+ * Side Effects: waits for roughly 700 PIT ticks
+ * Coverage: add_timer, del_timer, cascading, run_timers
+ * Files: timer.h/c, pit.h/c
+ */
+int timer_wheel_test(){
+	TEST_HEADER;
+	/* deliberately unsorted, 256 and 700 land past the near level */
+	static const uint32_t delay[WHEEL_TEST_TIMERS] = {700, 1, 256, 10, 255};
+	ktimer_t timers[WHEEL_TEST_TIMERS];
+	uint32_t now = jiffies;
+	int i;
+
+	wheel_order = 0;
+	for(i=0; i<WHEEL_TEST_TIMERS; i++){
+		wheel_fired[i] = 0;
+		init_timer(&timers[i], wheel_test_func, i);
+		timers[i].expires = now + delay[i];
+		add_timer(&timers[i]);
+	}
+
+	/* cancel the 10 tick timer */
+	if(!del_timer(&timers[3])){
+		return FAIL;
+	}
+
+	while(timers[0].next){
+		asm volatile("hlt");
+	}
+
+	/* expected order: 1, 255, 256, 700 */
+	if(wheel_fired[1] != 1 || wheel_fired[4] != 2 ||
+			wheel_fired[2] != 3 || wheel_fired[0] != 4 || wheel_fired[3]){
+		return FAIL;
+	}
+	return PASS;
+}
+
+/* Long Timeout Test
+ * Asserts: a sleep longer than the wheel can hold, as nanosleep asks
+ * 			for with a huge tv_sec, is clamped and stays pending
+ * 			instead of being taken as already due
+ * Inputs: None
+ * Outputs: PASS if the timer is still pending a few ticks later
+ * Side Effects: waits for a few PIT ticks
+ * Coverage: timespec_to_ticks, add_timer_in
+ * Files: timer.h/c
+ */
+int long_timeout_test(){
+	TEST_HEADER;
+	timespec_t ts = {0xFFFFFFFF, 0};
+	ktimer_t timer;
+	uint32_t ticks, start;
+
+	wheel_fired[0] = 0;
+	wheel_order = 0;
+	if(timespec_to_ticks(&ts, &ticks)){
+		return FAIL;
+	}
+	init_timer(&timer, wheel_test_func, 0);
+	add_timer_in(&timer, ticks);
+
+	start = jiffies;
+	while(jiffies - start < 5){
+		asm volatile("hlt");
+	}
+	if(!del_timer(&timer) || wheel_fired[0]){
+		return FAIL;
+	}
+	return PASS;
+}
+
+/* Pipe Test
+ * Asserts: bytes come out of a pipe in the order they went in, also
+ * 			across the end of the ring, readers see end of file once
+ * 			the write end is gone and writers fail once the read end is
+ * Inputs: None
+ * Outputs: PASS if every transfer matches
+ * Side Effects: resets the descriptors of the boot stack's PCB slot
+ * Coverage: pipe_create, pipe_read, pipe_write, pipe close
+ * Files: pipe.h/c
+ */
+int pipe_test(){
+	TEST_HEADER;
+	static uint8_t out[PIPE_BUF_SIZE], in[PIPE_BUF_SIZE];
+	pcb_t* pcb = get_pcb_ptr();
+	int32_t fds[2];
+	int i;
+
+	for(i=0; i<FILE_DESC_SIZE; i++){
+		pcb->file_desc_array[i].flags = !IN_USE;
+	}
+	for(i=0; i<PIPE_BUF_SIZE; i++){
+		out[i] = i * 7;
+	}
+
+	if(pipe_create(fds)){
+		return FAIL;
+	}
+
+	/* 3/4 full, drain a quarter, then write across the end of the page */
+	if(pipe_write(fds[1], out, 3072) != 3072 || pipe_read(fds[0], in, 1024) != 1024){
+		return FAIL;
+	}
+	for(i=0; i<1024; i++){
+		if(in[i] != out[i]) return FAIL;
+	}
+	if(pipe_write(fds[1], out, 2048) != 2048 || pipe_read(fds[0], in, PIPE_BUF_SIZE) != 4096){
+		return FAIL;
+	}
+	for(i=0; i<2048; i++){
+		if(in[i] != out[1024 + i] || in[2048 + i] != out[i]) return FAIL;
+	}
+
+	/* no writer left: end of file */
+	pipe_write_close(fds[1]);
+	if(pipe_read(fds[0], in, 1) != 0){
+		return FAIL;
+	}
+	pipe_read_close(fds[0]);
+
+	/* no reader left: write fails */
+	if(pipe_create(fds)){
+		return FAIL;
+	}
+	pipe_read_close(fds[0]);
+	if(pipe_write(fds[1], out, 1) != FFAIL){
+		return FAIL;
+	}
+	pipe_write_close(fds[1]);
+	return PASS;
+}
+
+/* Time Page Test
+ * Asserts: the time page is filled in, mapped at its user address, and
+ * 			follows jiffies
+ * Inputs: None
+ * Outputs: PASS if both views agree with the kernel
+ * Side Effects: None
+ * Coverage: init_time_page, time_page_tick, map_small_ro
+ * Files: timepage.h/c, paging.c
+ */
+int time_page_test(){
+	TEST_HEADER;
+	volatile time_page_t* user = (volatile time_page_t*)TIME_PAGE_ADDR;
+	uint32_t start = jiffies;
+
+	if(time_page->hz != HZ || user->hz != HZ || !user->wall_sec){
+		return FAIL;
+	}
+
+	/* wait for a tick, the page has to move along with jiffies */
+	while(jiffies == start);
+	if(time_after_eq(start, user->jiffies) || (user->seq & 1)){
+		return FAIL;
+	}
+	return PASS;
+}
+
+/* Strace Test
+ * Asserts: traced calls come out of the ring in order with their
+ * 			results, a full ring keeps only the newest records, and the
+ * 			counters see every call
+ * Inputs: None
+ * Outputs: PASS if the ring and counters match the calls made
+ * Side Effects: leaves tracing off with an empty ring
+ * Coverage: strace_call, strace_read, strace_get_stats
+ * Files: strace.h/c
+ */
+int strace_test(){
+	TEST_HEADER;
+	static strace_rec_t recs[STRACE_RING_SIZE];
+	static strace_stat_t stats[STRACE_NR_CALLS];
+	int i;
+
+	strace_start();
+	if(strace_call(SYS_GETPID, 1, 2, 3) != IDLE_PID || strace_read(recs, STRACE_RING_SIZE) != 1){
+		return FAIL;
+	}
+	if(recs[0].number != SYS_GETPID || recs[0].args[2] != 3 || recs[0].ret != IDLE_PID ||
+	   recs[0].tsc_exit < recs[0].tsc_enter){
+		return FAIL;
+	}
+
+	/* overflow: the oldest records are lost, the newest survive in order */
+	for(i=0; i<STRACE_RING_SIZE + 10; i++){
+		strace_call(SYS_GETPID, i, 0, 0);
+	}
+	if(strace_read(recs, STRACE_RING_SIZE) != STRACE_RING_SIZE || strace_read(recs, 1) != 0){
+		return FAIL;
+	}
+	for(i=0; i<STRACE_RING_SIZE; i++){
+		if(recs[i].args[0] != i + 10) return FAIL;
+	}
+
+	strace_get_stats(stats);
+	strace_stop();
+	if(stats[SYS_GETPID].count != STRACE_RING_SIZE + 11 || stats[SYS_GETPID].errors){
+		return FAIL;
+	}
+	return PASS;
+}
+
+/* Task Stats Test
+ * Asserts: the idle task (the boot code) has been charged kernel time
+ * 			that keeps growing, free slots and bad pids have no stats
+ * Inputs: None
+ * Outputs: PASS if the snapshots look sane
+ * Side Effects: None
+ * Coverage: sched_task_stats
+ * Files: sched.h/c
+ */
+int task_stats_test(){
+	TEST_HEADER;
+	task_stats_t first, second;
+	int i;
+
+	if(sched_task_stats(IDLE_PID, &first)){
+		return FAIL;
+	}
+	for(i=0; i<1000; i++){
+		asm volatile("" ::: "memory");
+	}
+	if(sched_task_stats(IDLE_PID, &second)){
+		return FAIL;
+	}
+	if(second.kernel_cycles <= first.kernel_cycles || second.user_cycles){
+		return FAIL;
+	}
+
+	if(sched_task_stats(MAX_PROCESS + 1, &first) != FFAIL || sched_task_stats(-1, &first) != FFAIL){
+		return FAIL;
+	}
+	for(i=1; i<=MAX_PROCESS; i++){
+		if(PCB_ADDR(i)->state == TASK_FREE && sched_task_stats(i, &first) != FFAIL){
+			return FAIL;
+		}
+	}
+	return PASS;
+}
+
+/* free PIC line (LPT2) irq_table_test plays with */
+#define IRQ_TEST_LINE	5
+
+/* handlers for irq_table_test, dev points at a call counter */
+static int32_t irq_test_handled(uint32_t irq, void* dev){
+	(*(int*)dev)++;
+	return IRQ_HANDLED;
+}
+
+static int32_t irq_test_none(uint32_t irq, void* dev){
+	(*(int*)dev)++;
+	return IRQ_NONE;
+}
+
+/* IRQ Table Test
+ * Asserts: a shared line runs every handler on its chain, an interrupt
+ * 			nobody claims is counted as unhandled, and handlers come off
+ * 			the chain again by dev
+ * Inputs: None
+ * Outputs: PASS if the chain and the counters behave
+ * Side Effects: fakes two interrupts on the unused IRQ5 and leaves it masked
+ * Coverage: request_irq, free_irq, do_IRQ, irq_get_stats
+ * Files: interrupts.h/c
+ */
+int irq_table_test(){
+	TEST_HEADER;
+	static irq_stat_t before[NR_IRQS], after[NR_IRQS];
+	int first = 0, second = 0;
+	uint32_t flags;
+
+	if(request_irq(NR_IRQS, irq_test_handled, &first) != FFAIL || request_irq(IRQ_TEST_LINE, NULL, &first) != FFAIL){
+		return FAIL;
+	}
+	if(request_irq(IRQ_TEST_LINE, irq_test_none, &first) || request_irq(IRQ_TEST_LINE, irq_test_handled, &second)){
+		return FAIL;
+	}
+
+	irq_get_stats(before);
+	cli_and_save(flags);
+	do_IRQ(-IRQ_TEST_LINE);
+	restore_flags(flags);
+	irq_get_stats(after);
+	if(first != 1 || second != 1 || after[IRQ_TEST_LINE].count != before[IRQ_TEST_LINE].count + 1 ||
+	   after[IRQ_TEST_LINE].unhandled != before[IRQ_TEST_LINE].unhandled){
+		return FAIL;
+	}
+
+	/* only the handler that never claims anything is left */
+	if(free_irq(IRQ_TEST_LINE, &second) || free_irq(IRQ_TEST_LINE, &second) != FFAIL){
+		return FAIL;
+	}
+	cli_and_save(flags);
+	do_IRQ(-IRQ_TEST_LINE);
+	restore_flags(flags);
+	irq_get_stats(after);
+	if(first != 2 || second != 1 || after[IRQ_TEST_LINE].unhandled != before[IRQ_TEST_LINE].unhandled + 1){
+		return FAIL;
+	}
+
+	if(free_irq(IRQ_TEST_LINE, &first)){
+		return FAIL;
+	}
+	return PASS;
+}
+
+/* ticks clock_test waits, long enough to compare against jiffies */
+#define CLOCK_TEST_TICKS	20
+
+/* Clock Test
+ * Asserts: the monotonic clock never goes back, keeps tv_nsec in range,
+ * 			and agrees with jiffies to within a tick; the realtime clock
+ * 			is at least the boot time
+ * Inputs: None
+ * Outputs: PASS if both clocks behave
+ * Side Effects: None
+ * Coverage: init_clocksource, clock_read, div64_32
+ * Files: clocksource.h/c, lib.h
+ */
+int clock_test(){
+	TEST_HEADER;
+	timespec_t prev, now;
+	uint32_t start, elapsed_ms;
+	int i;
+
+	if(!tsc_khz || clock_read(CLOCK_MONOTONIC + 1, &now) != FFAIL){
+		return FAIL;
+	}
+
+	if(clock_read(CLOCK_MONOTONIC, &prev)){
+		return FAIL;
+	}
+	for(i=0; i<1000; i++){
+		clock_read(CLOCK_MONOTONIC, &now);
+		if(now.tv_nsec >= NSEC_PER_SEC || now.tv_sec < prev.tv_sec ||
+		   (now.tv_sec == prev.tv_sec && now.tv_nsec < prev.tv_nsec)){
+			return FAIL;
+		}
+		prev = now;
+	}
+
+	/* line up with a tick, then time a known number of them */
+	start = jiffies;
+	while(jiffies == start);
+	start = jiffies;
+	clock_read(CLOCK_MONOTONIC, &prev);
+	while(jiffies - start < CLOCK_TEST_TICKS);
+	clock_read(CLOCK_MONOTONIC, &now);
+	elapsed_ms = (now.tv_sec - prev.tv_sec) * MSEC_PER_SEC +
+				 (now.tv_nsec / (NSEC_PER_SEC / MSEC_PER_SEC)) -
+				 (prev.tv_nsec / (NSEC_PER_SEC / MSEC_PER_SEC));
+	if(elapsed_ms + 1 < CLOCK_TEST_TICKS * MSEC_PER_SEC / HZ ||
+	   elapsed_ms > CLOCK_TEST_TICKS * MSEC_PER_SEC / HZ + 1){
+		return FAIL;
+	}
+
+	if(clock_read(CLOCK_REALTIME, &now) || now.tv_sec < time_page->wall_sec){
+		return FAIL;
+	}
+	return PASS;
+}
+
+/* ticks profile_test samples for */
+#define PROFILE_TEST_TICKS	10
+
+/* Profile Test
+ * Asserts: every tick while profiling is on leaves one kernel mode
+ * 			sample inside the kernel image, and nothing is sampled once
+ * 			it is off
+ * Inputs: None
+ * Outputs: PASS if the samples match the ticks
+ * Side Effects: leaves profiling off
+ * Coverage: profile_tick, profile_start, profile_stop, profile_read
+ * Files: profile.h/c, timer.c, handlers.S
+ */
+int profile_test(){
+	TEST_HEADER;
+	static profile_sample_t buf[2 * PROFILE_TEST_TICKS];
+	uint32_t start;
+	int32_t n, i;
+
+	start = jiffies;
+	while(jiffies == start);
+	start = jiffies;
+	profile_start();
+	while(jiffies - start < PROFILE_TEST_TICKS);
+	profile_stop();
+	start = jiffies;
+	while(jiffies - start < 2);
+
+	n = profile_read(buf, 2 * PROFILE_TEST_TICKS);
+	if(n < PROFILE_TEST_TICKS - 1 || n > PROFILE_TEST_TICKS + 1 || profile_dropped()){
+		return FAIL;
+	}
+	for(i=0; i<n; i++){
+		if(buf[i].user || buf[i].eip < KERNAL_ADDR || buf[i].eip >= MB_8){
+			return FAIL;
+		}
+	}
+	if(profile_read(buf, 2 * PROFILE_TEST_TICKS)){
+		return FAIL;
+	}
+	return PASS;
+}
+
+/* text mode geometry and CRTC ports for hw_scroll_test */
+#define SCROLL_TEST_COLS	80
+#define SCROLL_TEST_ROWS	25
+#define SCROLL_TEST_BLANK	0x0720
+#define CRTC_INDEX			0x3D4
+#define CRTC_DATA			0x3D5
+
+/* cell the CRTC shows in the top left corner */
+static uint32_t crtc_start(){
+	uint32_t start;
+
+	outb(0x0C, CRTC_INDEX);
+	start = inb(CRTC_DATA) << 8;
+	outb(0x0D, CRTC_INDEX);
+	start |= inb(CRTC_DATA);
+	return start;
+}
+
+/* Hardware Scroll Test
+ * Asserts: scrolling moves the CRTC start address down a row (or back
+ * 			to the start of video memory), the old second row becomes the
+ * 			top row and the new bottom row is blank
+ * Inputs: None
+ * Outputs: PASS if video memory and the CRTC agree after a flush
+ * Side Effects: scrolls the screen by one line
+ * Coverage: scroll_one_unit_down, console_flush
+ * Files: lib.c
+ */
+int hw_scroll_test(){
+	TEST_HEADER;
+	uint16_t* vga = (uint16_t*)VGA_BASE_ADDR;
+	uint16_t marker;
+	uint32_t before, after;
+
+	klog_flush();
+	console_flush();
+	before = crtc_start();
+	marker = vga[before + SCROLL_TEST_COLS];
+	scroll_one_unit_down();
+	console_flush();
+	after = crtc_start();
+
+	if(after != before + SCROLL_TEST_COLS && after != 0){
+		return FAIL;
+	}
+	if(vga[after] != marker || vga[after + (SCROLL_TEST_ROWS - 1) * SCROLL_TEST_COLS] != SCROLL_TEST_BLANK){
+		return FAIL;
+	}
+	return PASS;
+}
+
+/* Scrollback Test
+ * Asserts: a line that scrolled off the screen can be paged back to,
+ * 			and the view returns to the live screen afterwards
+ * Inputs: None
+ * Outputs: PASS if the scrolled back view shows the line on top
+ * Side Effects: prints a marker line and scrolls it off the screen
+ * Coverage: console_scroll_view, console_flush
+ * Files: lib.c
+ */
+int scrollback_test(){
+	TEST_HEADER;
+	uint16_t* vga = (uint16_t*)VGA_BASE_ADDR;
+	int32_t i, back;
+	uint16_t top;
+
+	printf("scrollback marker\n");
+	for(i = 0; i < SCROLL_TEST_ROWS; i++){
+		putc('\n');
+	}
+	klog_flush();
+
+	/* rows between the marker and the top of the screen */
+	back = SCROLL_TEST_ROWS + 1 - get_cursor_y();
+	console_scroll_view(back);
+	top = vga[crtc_start()];
+	console_scroll_view(CONSOLE_VIEW_LIVE);
+
+	if((top & 0xFF) != 's' || vga[crtc_start()] == top){
+		return FAIL;
+	}
+	return PASS;
+}
+
+/* ticks serial_test gives the transmitter to drain the ring */
+#define SERIAL_TEST_TICKS	100
+
+/* Serial Test
+ * Asserts: bytes written to the serial device leave the transmit ring
+ * 			through the THRE interrupt, and without a UART the device
+ * 			cannot be opened and nothing is queued
+ * Inputs: None
+ * Outputs: PASS if the ring drains in time
+ * Side Effects: sends a line out of COM1
+ * Coverage: serial_open, serial_write, handle_serial
+ * Files: drivers/serial.c
+ */
+int serial_test(){
+	TEST_HEADER;
+	int8_t msg[] = "serial test: the quick brown fox jumps over the lazy dog\n";
+	uint32_t start;
+	int32_t fd;
+
+	fd = serial_open(0);
+	if(fd == FFAIL){
+		return serial_tx_pending() ? FAIL : PASS;
+	}
+
+	if(serial_write(fd, msg, sizeof(msg) - 1) != sizeof(msg) - 1){
+		(void)serial_close(fd);
+		return FAIL;
+	}
+	start = jiffies;
+	while(serial_tx_pending() && jiffies - start < SERIAL_TEST_TICKS);
+	(void)serial_close(fd);
+
+	return serial_tx_pending() ? FAIL : PASS;
+}
+
+/* Terminal Mode Test
+ * Asserts: the terminal mode can be read back after it is set, unknown
+ * 			bits are refused, and a non-blocking read with no key
+ * 			waiting returns 0 right away in raw and canonical mode
+ * Inputs: None
+ * Outputs: PASS if every check holds
+ * Side Effects: eats any keys typed while it runs
+ * Coverage: terminal_ioctl, terminal_read
+ * Files: drivers/terminal.c
+ */
+int tty_mode_test(){
+	TEST_HEADER;
+	int8_t buf[128];
+	int32_t mode, result = PASS;
+
+	mode = terminal_ioctl(STDIN, TTY_GETMODE, 0);
+	if(mode != TTY_DEFAULT || terminal_ioctl(STDIN, TTY_SETMODE, ~0) != FFAIL){
+		result = FAIL;
+	}
+
+	(void)terminal_ioctl(STDIN, TTY_SETMODE, TTY_NONBLOCK);
+	if(terminal_ioctl(STDIN, TTY_GETMODE, 0) != TTY_NONBLOCK ||
+	   terminal_read(STDIN, buf, sizeof(buf)) != 0){
+		result = FAIL;
+	}
+
+	(void)terminal_ioctl(STDIN, TTY_SETMODE, TTY_CANON | TTY_NONBLOCK);
+	if(terminal_read(STDIN, buf, sizeof(buf)) != 0){
+		result = FAIL;
+	}
+
+	(void)terminal_ioctl(STDIN, TTY_SETMODE, mode);
+	return result;
+}
+
+/* Kernel Log Test
+ * Asserts: printf output lands in the log ring and a kmsg descriptor
+ * 			reads it back, then reports it is caught up
+ * Inputs: None
+ * Outputs: PASS if the marker is the last thing read
+ * Side Effects: prints a marker line
+ * Coverage: klog_write, klog_open, klog_read
+ * Files: klog.c
+ */
+int klog_test(){
+	TEST_HEADER;
+	static int8_t buf[KLOG_SIZE];
+	int8_t marker[] = "klog marker\n";
+	int32_t fd, n, len = sizeof(marker) - 1, total = 0;
+
+	printf("%s", marker);
+	fd = klog_open(0);
+	if(fd == FFAIL){
+		return FAIL;
+	}
+	while((n = klog_read(fd, buf, sizeof(buf))) > 0){
+		total = n;
+	}
+	(void)klog_close(fd);
+
+	if(n != 0 || total < len || strncmp(buf + total - len, marker, len)){
+		return FAIL;
+	}
+	return PASS;
+}
+
+/* Mode X Test
+ * Asserts: opening "vga" switches the graphics controller to the mode X
+ * 			window, a second open and a bad plane mask are refused, and
+ * 			closing goes back to the text window
+ * Inputs: None
+ * Outputs: PASS if every check holds
+ * Side Effects: the screen is in mode X for a moment, then redrawn
+ * Coverage: vga_open, vga_ioctl, vga_close
+ * Files: drivers/vga.c
+ */
+int vga_test(){
+	TEST_HEADER;
+	int32_t fd, result = PASS;
+
+	fd = vga_open(0);
+	if(fd == FFAIL){
+		return FAIL;
+	}
+
+	outb(0x06, VGA_GC);
+	if((inb(VGA_GC + 1) & 0x0C) != 0x04 || vga_open(0) != FFAIL){
+		result = FAIL;
+	}
+	if(vga_ioctl(fd, VGA_SET_PLANES, 0x10) != FFAIL ||
+	   vga_ioctl(fd, VGA_FLIP, MODEX_PAGE_SIZE) != FSUCCESS){
+		result = FAIL;
+	}
+	(void)vga_close(fd);
+
+	outb(0x06, VGA_GC);
+	if((inb(VGA_GC + 1) & 0x0C) != 0x0C){
+		result = FAIL;
+	}
+	return result;
+}
+
+/* Memory Benchmark helpers: two 4MB pages above every process's memory */
+#define MEM_BENCH_SRC		0x2400000
+#define MEM_BENCH_DST		0x2800000
+#define MEM_BENCH_MIN		16
+#define MEM_BENCH_MAX		(4 * 1024 * 1024)
+#define MEM_BENCH_BYTES		(16 * 1024 * 1024)	/* copied per size, in repeats */
+
+/* mem_bench_run
+ * best of the repeats in cycles, which is the run nothing interrupted;
+ * which = 0 memcpy_movsl, 1 memcpy, 2 memset_stosl, 3 memset
+ */
+static uint32_t mem_bench_run(int which, uint32_t n){
+	uint32_t reps = MEM_BENCH_BYTES / n, best = 0xFFFFFFFF, cycles;
+	uint64_t start;
+
+	if(reps > 1000){
+		reps = 1000;
+	}
+	while(reps--){
+		start = rdtsc();
+		switch(which){
+			case 0: memcpy_movsl((void*)MEM_BENCH_DST, (void*)MEM_BENCH_SRC, n); break;
+			case 1: memcpy((void*)MEM_BENCH_DST, (void*)MEM_BENCH_SRC, n); break;
+			case 2: memset_stosl((void*)MEM_BENCH_DST, 0x5A, n); break;
+			default: memset((void*)MEM_BENCH_DST, 0x5A, n); break;
+		}
+		cycles = (uint32_t)(rdtsc() - start);
+		if(cycles < best){
+			best = cycles;
+		}
+	}
+	return best;
+}
+
+/* Memory Benchmark
+ * Asserts: memcpy and memset give the same bytes as the plain rep movsl
+ * 			and rep stosl versions at every size from 16B to 4MB, and
+ * 			reports cycles for each, the best of many repeats
+ * Inputs: None
+ * Outputs: PASS if every copy and fill is right
+ * Side Effects: maps two 4MB pages above the process pages for a while
+ * Coverage: memcpy, memset, memcpy_sse2, memset_sse2, kernel_fpu_begin
+ * Files: lib.c, fpu.c
+ */
+int mem_bench_test(){
+	TEST_HEADER;
+	uint8_t* src = (uint8_t*)MEM_BENCH_SRC;
+	uint8_t* dst = (uint8_t*)MEM_BENCH_DST;
+	int32_t result = PASS;
+	uint32_t n, i;
+
+	map_large((uint32_t*)MEM_BENCH_SRC, (uint32_t*)MEM_BENCH_SRC);
+	map_large((uint32_t*)MEM_BENCH_DST, (uint32_t*)MEM_BENCH_DST);
+	for(i = 0; i < MEM_BENCH_MAX; i++){
+		src[i] = i * 7 + (i >> 12);
+	}
+
+	printf(" sse2 %d erms %d\n", cpu_has_sse2, cpu_has_erms);
+	printf(" bytes    movsl    memcpy   stosl    memset (cycles)\n");
+	for(n = MEM_BENCH_MIN; n <= MEM_BENCH_MAX; n <<= 2){
+		printf(" %d", n);
+		for(i = 0; i < 4; i++){
+			printf(" %u", mem_bench_run(i, n));
+		}
+		printf("\n");
+
+		/* an odd length at an odd offset takes every head and tail path;
+		   the last two bytes stay 0 as guards, inside the mapped page */
+		memset_stosl(dst, 0, n);
+		memcpy(dst + 1, src + 1, n - 3);
+		for(i = 1; i < n - 2; i++){
+			if(dst[i] != src[i]){
+				result = FAIL;
+			}
+		}
+		memset(dst + 3, 0xA5, n - 5);
+		if(dst[0] || dst[1] != src[1] || dst[2] != src[2] || dst[n - 2] || dst[n - 1]){
+			result = FAIL;
+		}
+		for(i = 3; i < n - 2; i++){
+			if(dst[i] != 0xA5){
+				result = FAIL;
+			}
+		}
+	}
+
+	unmap_large((uint32_t*)MEM_BENCH_DST);
+	unmap_large((uint32_t*)MEM_BENCH_SRC);
+	return result;
+}
+
+/* FPU State Test
+ * Asserts: the x87 control word and MXCSR a task set come back after
+ * 			its state was saved, the unit reset and the state restored
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None, the idle task's own state is put back at the end
+ * Coverage: fpu_save_state, fpu_restore_state
+ * Files: fpu.c
+ */
+int fpu_state_test(){
+	TEST_HEADER;
+	static uint8_t saved[FPU_STATE_SIZE] __attribute__((aligned(16)));
+	static uint8_t mine[FPU_STATE_SIZE] __attribute__((aligned(16)));
+	uint16_t cw = 0x0C7F, got_cw;	/* round toward zero, exceptions masked */
+	uint32_t csr = 0x7F80, got_csr;	/* flush to zero on top of the default */
+	uint32_t reset_csr = 0x1F80;
+	int32_t result = PASS;
+
+	fpu_save_state(saved);
+	fpu_restore_state(saved);
+
+	asm volatile("fldcw %0" : : "m"(cw));
+	if(cpu_has_sse2){
+		asm volatile("ldmxcsr %0" : : "m"(csr));
+	}
+	fpu_save_state(mine);
+	asm volatile("fninit");
+	if(cpu_has_sse2){
+		asm volatile("ldmxcsr %0" : : "m"(reset_csr));
+	}
+	fpu_restore_state(mine);
+
+	asm volatile("fnstcw %0" : "=m"(got_cw));
+	if(got_cw != cw){
+		result = FAIL;
+	}
+	if(cpu_has_sse2){
+		asm volatile("stmxcsr %0" : "=m"(got_csr));
+		if(got_csr != csr){
+			result = FAIL;
+		}
+	}
+
+	fpu_restore_state(saved);
+	return result;
+}
+
+/* String Ops helpers: the byte at a time versions lib.c had before */
+#define STR_TEST_RUNS		2000
+#define STR_TEST_LEN		300
+static uint32_t str_test_seed = 391;
+
+/* small LCG, the upper bits are the random ones */
+static uint32_t str_test_rand(){
+	str_test_seed = str_test_seed * 1103515245 + 12345;
+	return str_test_seed >> 8;
+}
+
+static uint32_t ref_strlen(const int8_t* s){
+	uint32_t len = 0;
+	while(s[len] != '\0'){
+		len++;
+	}
+	return len;
+}
+
+static int32_t ref_strncmp(const int8_t* s1, const int8_t* s2, uint32_t n){
+	uint32_t i;
+	for(i = 0; i < n; i++){
+		if((s1[i] != s2[i]) || (s1[i] == '\0')){
+			return s1[i] - s2[i];
+		}
+	}
+	return 0;
+}
+
+static void ref_memmove(uint8_t* dest, const uint8_t* src, uint32_t n){
+	uint32_t i;
+	if(dest <= src){
+		for(i = 0; i < n; i++){
+			dest[i] = src[i];
+		}
+	} else {
+		for(i = n; i-- > 0;){
+			dest[i] = src[i];
+		}
+	}
+}
+
+/* String Ops
+ * Asserts: the word at a time strlen, strncmp and memmove agree with
+ * 			the byte at a time versions on random strings and overlaps
+ * 			at every alignment, and strlen does not fault on a string
+ * 			that ends on the last byte of a mapped page
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: maps a 4MB page above the process pages for a while
+ * Coverage: strlen, strncmp, memmove
+ * Files: lib.c
+ */
+int str_word_test(){
+	TEST_HEADER;
+	static uint8_t a[STR_TEST_LEN + 16], b[STR_TEST_LEN + 16];
+	static uint8_t got[STR_TEST_LEN + 80], want[STR_TEST_LEN + 80];
+	int8_t* end = (int8_t*)(MEM_BENCH_SRC + MEM_BENCH_MAX);
+	int32_t result = PASS;
+	int32_t r1, r2;
+	uint32_t run, i, len, n, off1, off2, from, to, eflags;
+
+	for(run = 0; run < STR_TEST_RUNS; run++){
+		len = str_test_rand() % STR_TEST_LEN;
+		off1 = str_test_rand() % 8;
+		off2 = str_test_rand() % 8;
+
+		/* mostly plain text, some bytes with the high bit set */
+		for(i = 0; i < sizeof(a); i++){
+			a[i] = (str_test_rand() % 4) ? str_test_rand() % 127 + 1 : 0x80 | str_test_rand();
+		}
+		a[off1 + len] = '\0';
+		if(strlen((int8_t*)a + off1) != ref_strlen((int8_t*)a + off1)){
+			result = FAIL;
+		}
+
+		/* the same string at another alignment, maybe changed or cut short */
+		for(i = 0; i + off1 < sizeof(a) && i + off2 < sizeof(b); i++){
+			b[off2 + i] = a[off1 + i];
+		}
+		i = str_test_rand() % (len + 1);
+		switch(str_test_rand() % 3){
+			case 0: b[off2 + i] ^= 1 << (str_test_rand() % 8); break;
+			case 1: b[off2 + i] = '\0'; break;
+			default: break;
+		}
+		n = str_test_rand() % (len + 8);
+		r1 = strncmp((int8_t*)a + off1, (int8_t*)b + off2, n);
+		r2 = ref_strncmp((int8_t*)a + off1, (int8_t*)b + off2, n);
+		if(r1 != r2){
+			result = FAIL;
+		}
+
+		/* overlapping moves both ways */
+		from = str_test_rand() % 64;
+		to = str_test_rand() % 64;
+		memcpy(got, a, sizeof(a));
+		memcpy(want, a, sizeof(a));
+		memmove(got + to, got + from, len);
+		ref_memmove(want + to, want + from, len);
+		for(i = 0; i < sizeof(got); i++){
+			if(got[i] != want[i]){
+				result = FAIL;
+			}
+		}
+		asm volatile("pushfl; popl %0" : "=r"(eflags));
+		if(eflags & 0x400){
+			result = FAIL;
+		}
+	}
+
+	/* the page after this one is not mapped */
+	map_large((uint32_t*)MEM_BENCH_SRC, (uint32_t*)MEM_BENCH_SRC);
+	for(len = 0; len < 8; len++){
+		memset(end - len - 1, 'x', len);
+		end[-1] = '\0';
+		if(strlen(end - len - 1) != len){
+			result = FAIL;
+		}
+	}
+	unmap_large((uint32_t*)MEM_BENCH_SRC);
+	return result;
+}
+
+/* Multicall Test
+ * Asserts: a batch runs syscalls numbered past multicall, such as
+ * 			clock_gettime, and stops at a nested multicall or a number
+ * 			past the last syscall
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: maps the program page over a spare 4MB page for a while
+ * Coverage: multicall
+ * Files: syscall/syscalls.c
+ */
+int multicall_test(){
+	TEST_HEADER;
+	/* multicall only takes buffers inside the program page */
+	multicall_t* calls = (multicall_t*)PROGRAM_SEGMENT;
+	timespec_t* ts = (timespec_t*)(PROGRAM_SEGMENT + 3 * sizeof(multicall_t));
+	int32_t result = PASS;
+
+	map_large((uint32_t*)PROGRAM_SEGMENT, (uint32_t*)MEM_BENCH_SRC);
+	memset(calls, 0, 3 * sizeof(multicall_t));
+	calls[0].number = SYS_GETPID;
+	calls[1].number = SYS_CLOCK_GETTIME;
+	calls[1].args[0] = CLOCK_MONOTONIC;
+	calls[1].args[1] = (uint32_t)ts;
+	calls[2].number = SYS_CALL_LAST + 1;
+	if(multicall(calls, 3) != 2 || calls[0].result != IDLE_PID ||
+	   calls[1].result != FSUCCESS || calls[2].result != FFAIL){
+		result = FAIL;
+	}
+
+	calls[0].number = SYS_MULTICALL;
+	calls[0].args[0] = (uint32_t)calls;
+	calls[0].args[1] = 1;
+	if(multicall(calls, 1) != 0 || calls[0].result != FFAIL){
+		result = FAIL;
+	}
+
+	unmap_large((uint32_t*)PROGRAM_SEGMENT);
+	return result;
+}
+
+/* Benchmarks: run from launch_benchmarks when the kernel command line
+ * has bench=all or bench=name,name,...; each prints its cycle counts
+ * on the screen and one BENCH line per benchmark on COM1 */
+#define BENCH_WARMUP		10		/* untimed runs first, for caches and the TLB */
+#define BENCH_ITERS			1000
+#define BENCH_EXEC_ITERS	50
+#define BENCH_PUTC_ITERS	200
+#define BENCH_PUTC_LEN		80		/* bytes per run, a full line */
+#define BENCH_READ_LEN		4096
+#define BENCH_READ_FILE		"verylargetextwithverylongname.tx"
+#define BENCH_LOOKUP_FILE	"frame1.txt"
+#define BENCH_EXEC_PROG		"testprint"
+#define BENCH_LINE_SIZE		160
+#define BENCH_SERIAL_TICKS	100		/* longest wait for room on COM1 */
+#define BENCH_OPTION		"bench="
+
+typedef struct bench_t {
+	const char* name;
+	uint32_t iters;
+	uint32_t bytes;					/* moved per run, 0 if it means nothing */
+	int32_t (*setup)(void);			/* optional, FFAIL skips the benchmark */
+	void (*run)(void);
+} bench_t;
+
+static uint32_t bench_samples[BENCH_ITERS];
+static uint8_t bench_buf[BENCH_READ_LEN];
+static dentry_t bench_dentry;
+
+/* a null system call through the int 0x80 gate; from ring 0 there is
+ * no stack switch, so this is the entry and dispatch cost only */
+static void bench_syscall(){
+	int32_t ret;
+	asm volatile("int $0x80" : "=a"(ret) : "a"(SYS_GETPID) : "memory");
+}
+
+static int32_t bench_file_setup(){
+	return read_dentry_by_name((uint8_t*)BENCH_READ_FILE, &bench_dentry);
+}
+
+static void bench_read_data(){
+	(void)read_data(bench_dentry.inode_num, 0, bench_buf, BENCH_READ_LEN);
+}
+
+static void bench_lookup(){
+	dentry_t dentry;
+	(void)read_dentry_by_name((uint8_t*)BENCH_LOOKUP_FILE, &dentry);
+}
+
+static int32_t bench_exec_setup(){
+	dentry_t dentry;
+	return read_dentry_by_name((uint8_t*)BENCH_EXEC_PROG, &dentry);
+}
+
+/* load a program and let it run until it has halted; with the idle
+ * task as its parent the slot is freed as soon as it exits */
+static void bench_exec(){
+	int32_t pid = create_process((uint8_t*)BENCH_EXEC_PROG);
+
+	if(pid == FFAIL){
+		return;
+	}
+	while(PCB_ADDR(pid)->state != TASK_FREE){
+		cli();
+		schedule();
+		sti();
+	}
+}
+
+/* map a 4MB page and take it away again, both flush the TLB */
+static void bench_map(){
+	map_large((uint32_t*)MEM_BENCH_SRC, (uint32_t*)MEM_BENCH_SRC);
+	unmap_large((uint32_t*)MEM_BENCH_SRC);
+}
+
+/* a line through putc, logged and drawn */
+static void bench_putc(){
+	int i;
+	for(i = 0; i < BENCH_PUTC_LEN - 1; i++){
+		putc('a' + i % 26);
+	}
+	putc('\n');
+	klog_flush();
+}
+
+static bench_t benches[] = {
+	{"syscall",   BENCH_ITERS,      0,              NULL,             bench_syscall},
+	{"read_data", BENCH_ITERS,      BENCH_READ_LEN, bench_file_setup, bench_read_data},
+	{"lookup",    BENCH_ITERS,      0,              NULL,             bench_lookup},
+	{"exec",      BENCH_EXEC_ITERS, 0,              bench_exec_setup, bench_exec},
+	{"map",       BENCH_ITERS,      0,              NULL,             bench_map},
+	{"putc",      BENCH_PUTC_ITERS, BENCH_PUTC_LEN, NULL,             bench_putc},
+};
+#define NUM_BENCHES		(sizeof(benches) / sizeof(benches[0]))
+
+/* bench_selected
+ * check if the list after bench= names the benchmark, or is "all";
+ * the list ends at a space or the end of the command line
+ */
+static int bench_selected(const int8_t* list, const char* name){
+	uint32_t len;
+
+	while(*list != '\0' && *list != ' '){
+		for(len = 0; list[len] != '\0' && list[len] != ' ' && list[len] != ','; len++);
+		if((len == 3 && !strncmp(list, (int8_t*)"all", len)) ||
+		   (len == strlen((int8_t*)name) && !strncmp(list, (int8_t*)name, len))){
+			return 1;
+		}
+		list += len;
+		if(*list == ','){
+			list++;
+		}
+	}
+	return 0;
+}
+
+/* bench_append
+ * add " key=value" to a BENCH line
+ */
+static void bench_append(int8_t* line, const char* key, uint32_t value){
+	int8_t num[12];
+
+	line += strlen(line);
+	*line++ = ' ';
+	strcpy(line, (int8_t*)key);
+	line += strlen(line);
+	*line++ = '=';
+	strcpy(line, itoa(value, num, 10));
+}
+
+/* bench_emit
+ * send a finished line out of COM1 after what the console has already
+ * logged, so it never lands in the middle of another line
+ */
+static void bench_emit(int8_t* line){
+	uint32_t start = jiffies;
+	uint32_t len;
+
+	klog_flush();
+	len = strlen(line);
+	line[len++] = '\n';
+	while(serial_tx_pending() > SERIAL_TX_SIZE - BENCH_LINE_SIZE && jiffies - start < BENCH_SERIAL_TICKS);
+	serial_console_write(line, len);
+}
+
+/* bench_run
+ * time one benchmark, sort the samples and report them
+ */
+static void bench_run(bench_t* b){
+	int8_t line[BENCH_LINE_SIZE];
+	uint64_t start;
+	uint32_t i, j, sample;
+
+	strcpy(line, (int8_t*)"BENCH name=");
+	strcpy(line + strlen(line), (int8_t*)b->name);
+	if(b->setup && b->setup() == FFAIL){
+		printf(" %s: skipped\n", b->name);
+		strcpy(line + strlen(line), (int8_t*)" skipped");
+		bench_emit(line);
+		return;
+	}
+
+	for(i = 0; i < BENCH_WARMUP; i++){
+		b->run();
+	}
+	for(i = 0; i < b->iters; i++){
+		start = rdtsc();
+		b->run();
+		bench_samples[i] = (uint32_t)(rdtsc() - start);
+	}
+
+	/* insertion sort, a thousand samples at most */
+	for(i = 1; i < b->iters; i++){
+		sample = bench_samples[i];
+		for(j = i; j > 0 && bench_samples[j - 1] > sample; j--){
+			bench_samples[j] = bench_samples[j - 1];
+		}
+		bench_samples[j] = sample;
+	}
+
+	printf(" %s: min %u median %u p99 %u max %u cycles\n", b->name, bench_samples[0],
+		   bench_samples[b->iters / 2], bench_samples[b->iters * 99 / 100], bench_samples[b->iters - 1]);
+	bench_append(line, "iters", b->iters);
+	if(b->bytes){
+		bench_append(line, "bytes", b->bytes);
+	}
+	bench_append(line, "min", bench_samples[0]);
+	bench_append(line, "median", bench_samples[b->iters / 2]);
+	bench_append(line, "p99", bench_samples[b->iters * 99 / 100]);
+	bench_append(line, "max", bench_samples[b->iters - 1]);
+	bench_emit(line);
+}
+
 /* Checkpoint 4 tests */
 /* Checkpoint 5 tests */
 
@@ -292,6 +1471,26 @@ void launch_tests(){
 
 	/* test rtc */
 	TEST_OUTPUT("rtc invalid frequency", rtc_test_cp2());
+	TEST_OUTPUT("tasklet latency", tasklet_latency_test());
+	TEST_OUTPUT("timer wheel", timer_wheel_test());
+	TEST_OUTPUT("long timeout", long_timeout_test());
+	TEST_OUTPUT("pipe", pipe_test());
+	TEST_OUTPUT("task stats", task_stats_test());
+	TEST_OUTPUT("time page", time_page_test());
+	TEST_OUTPUT("strace", strace_test());
+	TEST_OUTPUT("irq table", irq_table_test());
+	TEST_OUTPUT("clock", clock_test());
+	TEST_OUTPUT("profile", profile_test());
+	TEST_OUTPUT("hardware scroll", hw_scroll_test());
+	TEST_OUTPUT("scrollback", scrollback_test());
+	TEST_OUTPUT("serial", serial_test());
+	TEST_OUTPUT("tty modes", tty_mode_test());
+	TEST_OUTPUT("kernel log", klog_test());
+	TEST_OUTPUT("mode X", vga_test());
+	TEST_OUTPUT("memory benchmark", mem_bench_test());
+	TEST_OUTPUT("fpu state", fpu_state_test());
+	TEST_OUTPUT("multicall", multicall_test());
+	TEST_OUTPUT("string ops", str_word_test());
 
 
 	// For terminal
@@ -306,3 +1505,29 @@ void launch_tests(){
 
 
 }
+
+/* Benchmark entry point, does nothing unless the command line asks */
+void launch_benchmarks(const int8_t* cmdline){
+	int8_t line[BENCH_LINE_SIZE];
+	uint32_t len = strlen((int8_t*)BENCH_OPTION);
+	const int8_t* p;
+	uint32_t i;
+
+	for(p = cmdline; *p != '\0'; p++){
+		if((p == cmdline || p[-1] == ' ') && !strncmp(p, (int8_t*)BENCH_OPTION, len)){
+			break;
+		}
+	}
+	if(*p == '\0'){
+		return;
+	}
+
+	printf("Running benchmarks\n");
+	for(i = 0; i < NUM_BENCHES; i++){
+		if(bench_selected(p + len, benches[i].name)){
+			bench_run(&benches[i]);
+		}
+	}
+	strcpy(line, (int8_t*)"BENCH done");
+	bench_emit(line);
+}
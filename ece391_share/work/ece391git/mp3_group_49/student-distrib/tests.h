@@ -8,8 +8,13 @@
 #ifndef TESTS_H
 #define TESTS_H
 
+#include "types.h"
+
 /* run all tests */
 //TODO: run tests for specific checkpoints
 void launch_tests();
 
+/* run the benchmarks a bench= option on the command line names */
+void launch_benchmarks(const int8_t* cmdline);
+
 #endif /* TESTS_H */
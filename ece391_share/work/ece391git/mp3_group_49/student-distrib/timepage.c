@@ -0,0 +1,59 @@
+#include "timepage.h"
+#include "lib.h"
+#include "paging.h"
+#include "timer.h"
+#include "clocksource.h"
+
+#include "drivers/rtc.h"
+
+#define PAGE_SIZE           4096
+
+/* a whole page of its own, nothing else may leak to user space */
+static uint8_t time_page_mem[PAGE_SIZE] __attribute__((aligned(PAGE_SIZE)));
+
+time_page_t* const time_page = (time_page_t*)time_page_mem;
+
+/*
+ * init_time_page
+ * DESCRIPTION: fill in the time page and map it read-only at
+ *              TIME_PAGE_ADDR for every process
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: reads the CMOS clock; call after init_clocksource
+ *               and before the tick starts
+ */
+void init_time_page()
+{
+    memset(time_page_mem, 0, PAGE_SIZE);
+
+    time_page->hz = HZ;
+    time_page->jiffies = jiffies;
+    time_page->tsc_khz = tsc_khz;
+    time_page->tsc_stamp = rdtsc();
+    time_page->wall_sec = rtc_get_time();
+
+    map_small_ro((uint32_t*)TIME_PAGE_ADDR, (uint32_t*)time_page_mem);
+}
+
+/*
+ * time_page_tick
+ * DESCRIPTION: publish the new tick count and the TSC it arrived at
+ * INPUTS: ticks -- jiffies after this tick
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: runs in the timer top half with interrupts off
+ */
+void time_page_tick(uint32_t ticks)
+{
+    uint64_t now = rdtsc();
+
+    time_page->seq++;
+    barrier();
+
+    time_page->jiffies = ticks;
+    time_page->tsc_stamp = now;
+
+    barrier();
+    time_page->seq++;
+}
@@ -0,0 +1,43 @@
+/*
+ * Time page shared read-only with every process
+ *
+ * One kernel page holds the tick count, the TSC at the last tick, the
+ * TSC rate and the wall clock at boot.  The timer interrupt refreshes
+ * it and every process sees it at TIME_PAGE_ADDR, so reading the time
+ * costs no syscall.  Updates are bracketed by a sequence count: it is
+ * odd while the kernel is writing, and a reader that sees it odd or
+ * changed across its copy simply reads again (a seqlock).
+ *
+ * References Used:
+ *      Linux arch/x86/vdso/vclock_gettime.c
+ *      Linux include/linux/seqlock.h
+ */
+
+#ifndef TIMEPAGE_H
+#define TIMEPAGE_H
+
+#include "types.h"
+
+/* user address of the page, right after the vidmap page */
+#define TIME_PAGE_ADDR      0x8401000
+
+/* layout shared with user space, see ece391syscall.h */
+typedef struct time_page_t {
+    volatile uint32_t seq;          /* odd while an update is in progress */
+    uint32_t hz;                    /* ticks per second */
+    uint32_t jiffies;               /* ticks since boot, never goes back */
+    uint32_t tsc_khz;               /* TSC cycles per millisecond, 0 if unknown */
+    uint64_t tsc_stamp;             /* TSC at the tick in jiffies */
+    uint32_t wall_sec;              /* seconds since 1970 at jiffies 0 */
+} time_page_t;
+
+/* the kernel's view of the page */
+extern time_page_t* const time_page;
+
+/* fill in the page and map it into the user address space */
+void init_time_page(void);
+
+/* publish a new tick, called from the timer interrupt */
+void time_page_tick(uint32_t ticks);
+
+#endif /* TIMEPAGE_H */
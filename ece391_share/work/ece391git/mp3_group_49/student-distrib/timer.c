@@ -0,0 +1,383 @@
+#include "timer.h"
+#include "lib.h"
+
+#include "timepage.h"
+#include "interrupts/tasklet.h"
+#include "syscall/sched.h"
+#include "syscall/profile.h"
+
+/* largest sleep we accept, keeps expires within time_after_eq range */
+#define MAX_TIMEOUT         0x7FFFFFFF
+
+/* ticks between console flushes, about 60 frames a second */
+#define CONSOLE_FLUSH_TICKS (HZ / 60)
+
+/* the wheel: slot list heads for the near level and the cascading levels */
+static ktimer_t tv1[TVR_SIZE];
+static ktimer_t tvn[TVN_LEVELS][TVN_SIZE];
+
+/* tick the wheel has been processed up to, trails jiffies */
+static uint32_t timer_jiffies;
+
+/* set while run_timers is queued so ticks do not flood the tasklet queue */
+static volatile int32_t timer_bh_pending = 0;
+
+/* same for console_flush_bh */
+static volatile int32_t console_bh_pending = 0;
+
+volatile uint32_t jiffies = 0;
+
+/* slot of level n that timer_jiffies currently points at */
+#define TVN_INDEX(n)    ((timer_jiffies >> (TVR_BITS + (n) * TVN_BITS)) & TVN_MASK)
+
+/* helpers for the circular slot lists */
+static void list_init(ktimer_t* head)
+{
+    head->next = head;
+    head->prev = head;
+}
+
+static void list_add_tail(ktimer_t* head, ktimer_t* timer)
+{
+    timer->next = head;
+    timer->prev = head->prev;
+    head->prev->next = timer;
+    head->prev = timer;
+}
+
+static void list_del(ktimer_t* timer)
+{
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->next = NULL;
+    timer->prev = NULL;
+}
+
+/*
+ * internal_add_timer
+ * DESCRIPTION: file a timer in the slot matching its distance from
+ *              timer_jiffies
+ * INPUTS: timer -- timer with expires filled in
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: call with interrupts disabled
+ */
+static void internal_add_timer(ktimer_t* timer)
+{
+    uint32_t expires = timer->expires;
+    uint32_t idx = expires - timer_jiffies;
+    ktimer_t* vec;
+    int level;
+
+    if ((int32_t)idx < 0) {
+        /* already due, run it on the next pass */
+        vec = &tv1[timer_jiffies & TVR_MASK];
+    } else if (idx < TVR_SIZE) {
+        vec = &tv1[expires & TVR_MASK];
+    } else {
+        /* find the first level wide enough, the last one takes the rest */
+        for (level = 0; level < TVN_LEVELS - 1; level++) {
+            if (idx < (1U << (TVR_BITS + (level + 1) * TVN_BITS)))
+                break;
+        }
+        vec = &tvn[level][(expires >> (TVR_BITS + level * TVN_BITS)) & TVN_MASK];
+    }
+
+    list_add_tail(vec, timer);
+}
+
+/*
+ * cascade
+ * DESCRIPTION: move every timer in one slot of an upper level down
+ *              to where it belongs now
+ * INPUTS: level -- upper level to take the slot from
+ *         index -- slot of that level
+ * OUTPUTS: none
+ * RETURN VALUE: index, so the caller knows if this level wrapped too
+ * SIDE EFFECTS: call with interrupts disabled
+ */
+static int cascade(int level, int index)
+{
+    ktimer_t head;
+    ktimer_t* timer;
+
+    /* detach the whole slot first, re-filing may put timers back in it */
+    if (tvn[level][index].next == &tvn[level][index])
+        return index;
+    head.next = tvn[level][index].next;
+    head.prev = tvn[level][index].prev;
+    head.next->prev = &head;
+    head.prev->next = &head;
+    list_init(&tvn[level][index]);
+
+    while (head.next != &head) {
+        timer = head.next;
+        list_del(timer);
+        internal_add_timer(timer);
+    }
+
+    return index;
+}
+
+/*
+ * run_timers
+ * DESCRIPTION: bring the wheel up to jiffies and fire everything due
+ * INPUTS: data -- not used
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: runs as a tasklet; callbacks run with interrupts on
+ */
+static void run_timers(uint32_t data)
+{
+    uint32_t flags;
+    ktimer_t* timer;
+    int index;
+
+    cli_and_save(flags);
+    timer_bh_pending = 0;
+
+    while (time_after_eq(jiffies, timer_jiffies)) {
+        index = timer_jiffies & TVR_MASK;
+
+        /* the near level wrapped, pull the next slot of each level down */
+        if (!index &&
+            !cascade(0, TVN_INDEX(0)) &&
+            !cascade(1, TVN_INDEX(1)) &&
+            !cascade(2, TVN_INDEX(2)))
+            cascade(3, TVN_INDEX(3));
+
+        timer_jiffies++;
+
+        while (tv1[index].next != &tv1[index]) {
+            timer = tv1[index].next;
+            list_del(timer);
+
+            restore_flags(flags);
+            timer->func(timer->data);
+            cli_and_save(flags);
+        }
+    }
+
+    restore_flags(flags);
+}
+
+/*
+ * init_timers
+ * DESCRIPTION: empty every slot of the wheel
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: resets jiffies
+ */
+void init_timers()
+{
+    int i, j;
+
+    for (i = 0; i < TVR_SIZE; i++)
+        list_init(&tv1[i]);
+    for (i = 0; i < TVN_LEVELS; i++)
+        for (j = 0; j < TVN_SIZE; j++)
+            list_init(&tvn[i][j]);
+
+    jiffies = 0;
+    timer_jiffies = 0;
+}
+
+/*
+ * init_timer
+ * DESCRIPTION: set the callback of a timer and mark it idle
+ * INPUTS: timer -- timer to set up
+ *         func  -- called when the timer fires
+ *         data  -- argument handed to func
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: none
+ */
+void init_timer(ktimer_t* timer, void (*func)(uint32_t data), uint32_t data)
+{
+    timer->next = NULL;
+    timer->prev = NULL;
+    timer->expires = 0;
+    timer->func = func;
+    timer->data = data;
+}
+
+/*
+ * add_timer
+ * DESCRIPTION: arm a timer for the tick in timer->expires
+ * INPUTS: timer -- idle timer set up with init_timer
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: re-arms the timer if it was already pending
+ */
+void add_timer(ktimer_t* timer)
+{
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if (timer->next)
+        list_del(timer);
+    internal_add_timer(timer);
+    restore_flags(flags);
+}
+
+/*
+ * add_timer_in
+ * DESCRIPTION: arm a timer to fire once ticks whole ticks have passed
+ * INPUTS: timer -- idle timer set up with init_timer
+ *         ticks -- ticks to wait, clamped to what the wheel can hold
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: re-arms the timer if it was already pending
+ */
+void add_timer_in(ktimer_t* timer, uint32_t ticks)
+{
+    uint32_t flags;
+    uint32_t room;
+
+    cli_and_save(flags);
+
+    /* expires has to stay less than MAX_TIMEOUT past timer_jiffies,
+       which trails jiffies, or the wheel takes the timer as due */
+    room = MAX_TIMEOUT - 1 - (jiffies - timer_jiffies);
+    if (ticks > room)
+        ticks = room;
+
+    /* one extra tick, the current one is already partly over */
+    timer->expires = jiffies + ticks + 1;
+    add_timer(timer);
+    restore_flags(flags);
+}
+
+/*
+ * del_timer
+ * DESCRIPTION: cancel a timer
+ * INPUTS: timer -- timer to cancel
+ * OUTPUTS: none
+ * RETURN VALUE: 1 if the timer was pending, 0 if it already fired
+ * SIDE EFFECTS: none
+ */
+int32_t del_timer(ktimer_t* timer)
+{
+    uint32_t flags;
+    int32_t pending = 0;
+
+    cli_and_save(flags);
+    if (timer->next) {
+        list_del(timer);
+        pending = 1;
+    }
+    restore_flags(flags);
+
+    return pending;
+}
+
+/* copy a frame of console output to the screen, runs as a tasklet */
+static void console_flush_bh(uint32_t data)
+{
+    console_bh_pending = 0;
+    console_flush();
+}
+
+/*
+ * timer_tick
+ * DESCRIPTION: account for one PIT interrupt
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: queues run_timers if it is not queued already,
+ *               refreshes the user time page, feeds the profiler and
+ *               queues a console flush once a frame
+ */
+void timer_tick()
+{
+    jiffies++;
+    time_page_tick(jiffies);
+    profile_tick();
+
+    /* a flush copies up to a screen to VIDEO, too slow for the top half */
+    if (!(jiffies % CONSOLE_FLUSH_TICKS) && !console_bh_pending) {
+        console_bh_pending = 1;
+        if (tasklet_schedule(console_flush_bh, 0))
+            console_bh_pending = 0;
+    }
+
+    if (!timer_bh_pending) {
+        timer_bh_pending = 1;
+        if (tasklet_schedule(run_timers, 0))
+            timer_bh_pending = 0;
+    }
+}
+
+/* callback for timer_sleep, data is the sleeping task */
+static void sleep_timeout(uint32_t data)
+{
+    sched_wakeup((pcb_t*)data);
+}
+
+/*
+ * timer_sleep
+ * DESCRIPTION: block the calling task until ticks have passed
+ * INPUTS: timer -- the task's own sleep timer
+ *         ticks -- number of whole ticks to wait
+ * OUTPUTS: none
+ * RETURN VALUE: ticks left if woken early, 0 otherwise
+ * SIDE EFFECTS: other tasks run in the meantime
+ */
+uint32_t timer_sleep(ktimer_t* timer, uint32_t ticks)
+{
+    uint32_t flags;
+    uint32_t left = 0;
+
+    if (!ticks)
+        return 0;
+
+    init_timer(timer, sleep_timeout, (uint32_t)get_pcb_ptr());
+
+    cli_and_save(flags);
+    add_timer_in(timer, ticks);
+    while (timer->next)
+        sched_block();
+    restore_flags(flags);
+
+    if (del_timer(timer) && !time_after_eq(jiffies, timer->expires))
+        left = timer->expires - jiffies;
+
+    return left;
+}
+
+/*
+ * timespec_to_ticks
+ * DESCRIPTION: convert an interval to ticks, rounding up
+ * INPUTS: ts -- interval to convert
+ * OUTPUTS: ticks -- number of ticks, capped at MAX_TIMEOUT
+ * RETURN VALUE: 0 on success, -1 if tv_nsec is out of range
+ * SIDE EFFECTS: none
+ */
+int32_t timespec_to_ticks(const timespec_t* ts, uint32_t* ticks)
+{
+    if (ts->tv_nsec >= NSEC_PER_SEC)
+        return FFAIL;
+
+    if (ts->tv_sec >= MAX_TIMEOUT / HZ) {
+        *ticks = MAX_TIMEOUT;
+        return FSUCCESS;
+    }
+
+    *ticks = ts->tv_sec * HZ + (ts->tv_nsec + NSEC_PER_TICK - 1) / NSEC_PER_TICK;
+    return FSUCCESS;
+}
+
+/*
+ * ticks_to_timespec
+ * DESCRIPTION: convert ticks to an interval
+ * INPUTS: ticks -- number of ticks
+ * OUTPUTS: ts -- the same interval in seconds and nanoseconds
+ * RETURN VALUE: none
+ * SIDE EFFECTS: none
+ */
+void ticks_to_timespec(uint32_t ticks, timespec_t* ts)
+{
+    ts->tv_sec = ticks / HZ;
+    ts->tv_nsec = (ticks % HZ) * NSEC_PER_TICK;
+}
@@ -0,0 +1,85 @@
+/*
+ * Kernel timers kept in a hierarchical timing wheel
+ *
+ * The wheel has one 256 slot level for the next 256 ticks and four
+ * 64 slot levels covering the rest of the 32 bit tick range.  A
+ * timer is filed in the slot of the level its distance falls into;
+ * whenever the low level wraps, the next slot of the level above is
+ * cascaded down.  Adding, cancelling and firing a timer are all
+ * constant time list operations.
+ *
+ * References Used:
+ *      Varghese & Lauck, "Hashed and Hierarchical Timing Wheels"
+ *      Linux 2.6 kernel/timer.c
+ */
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#include "types.h"
+
+/* timer interrupts per second, driven by the PIT */
+#define HZ                  1000
+
+#define MSEC_PER_SEC        1000
+#define NSEC_PER_SEC        1000000000
+#define NSEC_PER_TICK       (NSEC_PER_SEC / HZ)
+
+/* wheel geometry */
+#define TVR_BITS            8
+#define TVN_BITS            6
+#define TVR_SIZE            (1 << TVR_BITS)
+#define TVN_SIZE            (1 << TVN_BITS)
+#define TVR_MASK            (TVR_SIZE - 1)
+#define TVN_MASK            (TVN_SIZE - 1)
+#define TVN_LEVELS          4
+
+/* wrap-safe "a is at or after b" for tick counts */
+#define time_after_eq(a, b) ((int32_t)((a) - (b)) >= 0)
+
+/* a single timer; embed it wherever the owner lives (e.g. the PCB) */
+typedef struct ktimer_t {
+    struct ktimer_t* next;
+    struct ktimer_t* prev;
+    uint32_t expires;               /* absolute tick to fire at */
+    void (*func)(uint32_t data);    /* called with interrupts enabled */
+    uint32_t data;
+} ktimer_t;
+
+/* time interval handed to nanosleep */
+typedef struct timespec_t {
+    uint32_t tv_sec;
+    uint32_t tv_nsec;
+} timespec_t;
+
+/* ticks since init_timers */
+extern volatile uint32_t jiffies;
+
+/* set up the empty wheel */
+void init_timers(void);
+
+/* prepare a timer before its first use */
+void init_timer(ktimer_t* timer, void (*func)(uint32_t data), uint32_t data);
+
+/* file a timer to fire at timer->expires */
+void add_timer(ktimer_t* timer);
+
+/* file a timer to fire after ticks whole ticks, however large */
+void add_timer_in(ktimer_t* timer, uint32_t ticks);
+
+/* cancel a timer, returns 1 if it was still pending */
+int32_t del_timer(ktimer_t* timer);
+
+/* called from the PIT top half once per tick */
+void timer_tick(void);
+
+/* block the calling task for at least ticks, returns ticks left unslept */
+uint32_t timer_sleep(ktimer_t* timer, uint32_t ticks);
+
+/* convert a timespec to ticks, rounding up; -1 on a malformed value */
+int32_t timespec_to_ticks(const timespec_t* ts, uint32_t* ticks);
+
+/* convert ticks back to a timespec */
+void ticks_to_timespec(uint32_t ticks, timespec_t* ts);
+
+#endif /* TIMER_H */
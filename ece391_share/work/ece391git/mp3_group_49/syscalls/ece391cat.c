@@ -13,7 +13,10 @@ int main ()
 	return 3;
     }
 
-    if (-1 == (fd = ece391_open (buf))) {
+    /* no file named, copy stdin (e.g. the read end of a pipe) */
+    if ('\0' == buf[0])
+        fd = 0;
+    else if (-1 == (fd = ece391_open (buf))) {
         ece391_fdputs (1, (uint8_t*)"file not found\n");
 	return 2;
     }
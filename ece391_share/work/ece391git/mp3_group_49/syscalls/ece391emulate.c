@@ -49,6 +49,7 @@ DO_CALL(ece391_halt,1 /* SYS_HALT */);
 DO_CALL(__ece391_read,3 /* SYS_READ */);
 DO_CALL(__ece391_write,4 /* SYS_WRITE */);
 DO_CALL(__ece391_close,6 /* SYS_CLOSE */);
+DO_CALL(ece391_nanosleep,162 /* Linux nanosleep, same timespec layout */);
 
 /* Call the main() function, then halt with its return value. */
 
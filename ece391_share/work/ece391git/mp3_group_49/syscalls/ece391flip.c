@@ -0,0 +1,53 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define ROW_BYTES   (320 / 4)
+#define ROWS        200
+#define BAR_BYTES   8           /* 32 pixels, whole addresses cover all planes */
+#define FRAMES      600
+#define BG_COLOR    1
+#define BAR_COLOR   2
+
+/*
+ * Bounces a bar across the screen in mode X, drawing every frame into
+ * the page that is not shown and flipping to it at the retrace.
+ */
+int main ()
+{
+    uint8_t* mem;
+    uint8_t* page;
+    int32_t fd, frame, x = 0, dx = 1, i, y;
+
+    if (-1 == (fd = ece391_open ((uint8_t*)"vga"))) {
+        ece391_fdputs (1, (uint8_t*)"could not open vga\n");
+        return 2;
+    }
+    if (-1 == ece391_vgamap (&mem)) {
+        ece391_close (fd);
+        ece391_fdputs (1, (uint8_t*)"vgamap failed\n");
+        return 3;
+    }
+
+    (void)ece391_ioctl (fd, ECE391_VGA_SET_COLOR, (BG_COLOR << 24) | 0x000010);
+    (void)ece391_ioctl (fd, ECE391_VGA_SET_COLOR, (BAR_COLOR << 24) | 0x3F3F00);
+    (void)ece391_ioctl (fd, ECE391_VGA_SET_PLANES, 0x0F);
+
+    for (frame = 0; frame < FRAMES; frame++) {
+        /* pages 0 and 1 take turns, the other one is on screen */
+        page = mem + (frame & 1) * ECE391_MODEX_PAGE_SIZE;
+        for (y = 0; y < ROWS; y++) {
+            for (i = 0; i < ROW_BYTES; i++)
+                page[y * ROW_BYTES + i] = (i >= x && i < x + BAR_BYTES) ? BAR_COLOR : BG_COLOR;
+        }
+        (void)ece391_ioctl (fd, ECE391_VGA_FLIP, (frame & 1) * ECE391_MODEX_PAGE_SIZE);
+
+        x += dx;
+        if (x == 0 || x == ROW_BYTES - BAR_BYTES)
+            dx = -dx;
+    }
+
+    ece391_close (fd);
+    return 0;
+}
@@ -0,0 +1,56 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define NUMBUFSIZE  12
+#define COLWIDTH    10
+
+/* average of a 64 bit total without a 64 bit divide */
+static uint32_t average (uint64_t total, uint32_t n)
+{
+    /* scale both down until the total fits, the ratio stays about the same */
+    while (total >> 32) {
+        total >>= 1;
+        n >>= 1;
+    }
+    return n ? (uint32_t)total / n : 0;
+}
+
+/* print v right aligned in a column */
+static void put_col (uint32_t v)
+{
+    uint8_t buf[NUMBUFSIZE];
+    uint32_t len;
+
+    ece391_itoa(v, buf, 10);
+    for (len = ece391_strlen(buf); len < COLWIDTH; len++)
+        ece391_fdputs(1, (uint8_t*)" ");
+    ece391_fdputs(1, buf);
+}
+
+int main ()
+{
+    ece391_irq_stat_t stats[ECE391_NR_IRQS];
+    int32_t irq;
+
+    if (-1 == ece391_irqstat(stats)) {
+        ece391_fdputs(1, (uint8_t*)"irqstat failed\n");
+        return 3;
+    }
+
+    ece391_fdputs(1, (uint8_t*)"       irq     count  spurious unhandled   avg cyc   max cyc\n");
+    for (irq = 0; irq < ECE391_NR_IRQS; irq++) {
+        if (!stats[irq].count && !stats[irq].spurious)
+            continue;
+        put_col(irq);
+        put_col(stats[irq].count);
+        put_col(stats[irq].spurious);
+        put_col(stats[irq].unhandled);
+        put_col(average(stats[irq].cycles, stats[irq].count));
+        put_col(stats[irq].max_cycles);
+        ece391_fdputs(1, (uint8_t*)"\n");
+    }
+
+    return 0;
+}
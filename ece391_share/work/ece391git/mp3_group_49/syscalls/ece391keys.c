@@ -0,0 +1,68 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BATCH       32
+#define NUMBUFSIZE  12
+#define SCAN_ESCAPE 0x01
+
+/* gaps between events are printed in units of 2^10 cycles */
+#define KCYC_SHIFT  10
+
+static void put_num (uint32_t v, int32_t radix)
+{
+    uint8_t buf[NUMBUFSIZE];
+
+    ece391_itoa(v, buf, radix);
+    ece391_fdputs(1, buf);
+}
+
+/* scancode, character, modifiers and the gap since the last event */
+static void put_event (const ece391_key_event_t* ev, uint64_t prev)
+{
+    uint8_t c[2];
+
+    ece391_fdputs(1, (uint8_t*)(ev->flags & ECE391_KEY_RELEASE ? "up   0x" : "down 0x"));
+    put_num(ev->scancode, 16);
+    if (ev->ascii > ' ') {
+        c[0] = ev->ascii;
+        c[1] = '\0';
+        ece391_fdputs(1, (uint8_t*)" '");
+        ece391_fdputs(1, c);
+        ece391_fdputs(1, (uint8_t*)"'");
+    }
+    if (ev->flags & (ECE391_KEY_LSHIFT | ECE391_KEY_RSHIFT))
+        ece391_fdputs(1, (uint8_t*)" shift");
+    if (ev->flags & ECE391_KEY_LCTRL)
+        ece391_fdputs(1, (uint8_t*)" ctrl");
+    if (ev->flags & ECE391_KEY_CAPS)
+        ece391_fdputs(1, (uint8_t*)" caps");
+    if (ev->flags & ECE391_KEY_EXTENDED)
+        ece391_fdputs(1, (uint8_t*)" ext");
+    ece391_fdputs(1, (uint8_t*)" +");
+    put_num(prev ? (uint32_t)((ev->tsc - prev) >> KCYC_SHIFT) : 0, 10);
+    ece391_fdputs(1, (uint8_t*)" Kcyc\n");
+}
+
+int main ()
+{
+    ece391_key_event_t ev[BATCH];
+    uint64_t prev = 0;
+    int32_t n, i;
+
+    ece391_fdputs(1, (uint8_t*)"printing key events, escape quits\n");
+    for (;;) {
+        n = ece391_kbd_read(ev, BATCH, 0);
+        if (n < 0) {
+            ece391_fdputs(1, (uint8_t*)"kbd_read failed\n");
+            return 3;
+        }
+        for (i = 0; i < n; i++) {
+            put_event(&ev[i], prev);
+            prev = ev[i].tsc;
+            if (ev[i].scancode == SCAN_ESCAPE && !(ev[i].flags & ECE391_KEY_RELEASE))
+                return 0;
+        }
+    }
+}
@@ -4,26 +4,36 @@
 #include "ece391syscall.h"
 
 #define SBUFSIZE 33
+#define BATCH 8
 
 int main ()
 {
-    int32_t fd, cnt;
-    uint8_t buf[SBUFSIZE];
+    int32_t fd, n;
+    uint8_t buf[BATCH][SBUFSIZE];
+    ece391_multicall_t calls[BATCH];
 
     if (-1 == (fd = ece391_open ((uint8_t*)"."))) {
         ece391_fdputs (1, (uint8_t*)"directory open failed\n");
         return 2;
     }
 
-    while (0 != (cnt = ece391_read (fd, buf, SBUFSIZE-1))) {
-        if (-1 == cnt) {
+    do {
+        /* read a batch of entries with one kernel entry... */
+        for (n = 0; n < BATCH; n++)
+            ece391_mc_read (&calls[n], fd, buf[n], SBUFSIZE-1);
+        if (BATCH != ece391_multicall (calls, BATCH)) {
 	        ece391_fdputs (1, (uint8_t*)"directory entry read failed\n");
 	        return 3;
 	    }
-	    buf[cnt] = '\n';
-	    if (-1 == ece391_write (1, buf, cnt + 1))
+
+        /* ...and print them with another, stopping at the end of the list */
+        for (n = 0; n < BATCH && 0 != calls[n].result; n++) {
+	        buf[n][calls[n].result] = '\n';
+	        ece391_mc_write (&calls[n], 1, buf[n], calls[n].result + 1);
+        }
+        if (n != ece391_multicall (calls, n))
 	        return 3;
-    }
+    } while (BATCH == n);
 
     return 0;
 }
@@ -11,6 +11,9 @@
 #define LOOPMAX BUFMAX-ENDING-1
 #define STARTCHAR 'A'
 #define ENDCHAR 'Z'
+#define FRAME_NSEC (1000000000/32)
+#define FRAME_MSEC (1000/32)
+#define FRAME_BUDGET 2
 
 int main ()
 {
@@ -18,9 +21,7 @@ int main ()
     int32_t j = 0;
     uint8_t curchar = STARTCHAR;
     uint8_t update = 1;
-    int ret_val;
-    int garbage;
-    int rtc_fd;
+    ece391_timespec_t frame;
     uint8_t buf[BUFMAX];
     
     // Clear buffer
@@ -33,10 +34,12 @@ int main ()
     buf[BUFMAX-3]='|';
     buf[START]='|';
 
-    // Open and set RTC Frequency
-    rtc_fd = ece391_open((uint8_t*)"rtc");
-    ret_val = 32;
-    ret_val = ece391_write(rtc_fd, &ret_val, 4);
+    // Pace frames at 32Hz with our own timer instead of the shared RTC
+    frame.tv_sec = 0;
+    frame.tv_nsec = FRAME_NSEC;
+
+    // Each frame is a small periodic job, so busy tasks cannot delay it
+    ece391_set_periodic(FRAME_MSEC, FRAME_BUDGET);
 
     while(1)
     {
@@ -53,8 +56,8 @@ int main ()
 		buf[j] = curchar;
 		ece391_fdputs (1, buf);
 
-		// Wait for RTC tick
-		ece391_read(rtc_fd, &garbage, 4);
+		// Wait for the next frame
+		ece391_nanosleep(&frame, 0);
 	}
 	
 	// Bounce back
@@ -70,8 +73,8 @@ int main ()
 		buf[j] = curchar;
 		ece391_fdputs (1, buf);
 
-		// Wait for RTC tick
-		ece391_read(rtc_fd, &garbage, 4);
+		// Wait for the next frame
+		ece391_nanosleep(&frame, 0);
     	}
 
 	// Edge case on characters
@@ -0,0 +1,108 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE     1024
+#define BATCH       256
+#define NUMBUFSIZE  12
+
+/* distinct (pid, mode, eip) triples kept, a power of two */
+#define HASH_SIZE   2048
+#define HASH_MASK   (HASH_SIZE - 1)
+
+/* one line of the output */
+typedef struct hit {
+    uint32_t eip;
+    uint16_t pid;
+    uint16_t user;
+    uint32_t count;             /* 0 while the slot is free */
+} hit_t;
+
+static hit_t hits[HASH_SIZE];
+
+/* samples that found the table full */
+static uint32_t overflow;
+
+static void put_num (uint32_t v, int32_t radix)
+{
+    uint8_t buf[NUMBUFSIZE];
+
+    ece391_itoa(v, buf, radix);
+    ece391_fdputs(1, buf);
+}
+
+/* count a sample under its (pid, mode, eip), open addressing */
+static void add_sample (const ece391_profile_sample_t* s)
+{
+    uint32_t i, slot;
+
+    slot = (s->eip ^ (s->eip >> 12) ^ s->pid) & HASH_MASK;
+    for (i = 0; i < HASH_SIZE; i++, slot = (slot + 1) & HASH_MASK) {
+        if (!hits[slot].count) {
+            hits[slot].eip = s->eip;
+            hits[slot].pid = s->pid;
+            hits[slot].user = s->user;
+        } else if (hits[slot].eip != s->eip || hits[slot].pid != s->pid ||
+                   hits[slot].user != s->user) {
+            continue;
+        }
+        hits[slot].count++;
+        return;
+    }
+    overflow++;
+}
+
+/*
+ * Run a command with the profiler on and print one "prof" line per
+ * sampled address; profsym.py turns the lines into a flat profile.
+ */
+int main ()
+{
+    uint8_t cmd[BUFSIZE];
+    ece391_profile_sample_t samples[BATCH];
+    uint32_t total = 0;
+    int32_t pid, status, n, i;
+
+    if (0 != ece391_getargs (cmd, BUFSIZE)) {
+        ece391_fdputs (1, (uint8_t*)"usage: prof <command>\n");
+        return 3;
+    }
+
+    ece391_profile(PROFILE_ON, 0, 0);
+    if (-1 == (pid = ece391_spawn(cmd))) {
+        ece391_profile(PROFILE_OFF, 0, 0);
+        ece391_fdputs (1, (uint8_t*)"no such command\n");
+        return 2;
+    }
+    ece391_waitpid(pid, &status, 0);
+    ece391_profile(PROFILE_OFF, 0, 0);
+
+    while (0 < (n = ece391_profile(PROFILE_READ, samples, BATCH))) {
+        for (i = 0; i < n; i++)
+            add_sample(&samples[i]);
+        total += n;
+    }
+
+    /* prof <count> <pid> <u|k> <eip> */
+    for (i = 0; i < HASH_SIZE; i++) {
+        if (!hits[i].count)
+            continue;
+        ece391_fdputs(1, (uint8_t*)"prof ");
+        put_num(hits[i].count, 10);
+        ece391_fdputs(1, (uint8_t*)" ");
+        put_num(hits[i].pid, 10);
+        ece391_fdputs(1, (uint8_t*)(hits[i].user ? " u " : " k "));
+        put_num(hits[i].eip, 16);
+        ece391_fdputs(1, (uint8_t*)"\n");
+    }
+
+    ece391_fdputs(1, (uint8_t*)"prof total ");
+    put_num(total, 10);
+    ece391_fdputs(1, (uint8_t*)" dropped ");
+    put_num(ece391_profile(PROFILE_DROPPED, 0, 0) + overflow, 10);
+    ece391_fdputs(1, (uint8_t*)" command pid ");
+    put_num(pid, 10);
+    ece391_fdputs(1, (uint8_t*)"\n");
+    return 0;
+}
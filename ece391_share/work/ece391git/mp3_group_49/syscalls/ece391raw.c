@@ -0,0 +1,58 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define NUMBUFSIZE  12
+#define QUIT_KEY    'q'
+
+static void put_num (uint32_t v)
+{
+    uint8_t buf[NUMBUFSIZE];
+
+    ece391_itoa(v, buf, 10);
+    ece391_fdputs(1, buf);
+}
+
+/*
+ * Puts the terminal in raw non-blocking mode and spins on read, the
+ * way a game loop polls for input between frames.  Every key is
+ * printed with the number of empty polls before it.
+ */
+int main ()
+{
+    uint32_t polls = 0;
+    int32_t mode, n;
+    uint8_t c[2];
+
+    mode = ece391_ioctl(0, ECE391_TTY_GETMODE, 0);
+    if (mode < 0 || ece391_ioctl(0, ECE391_TTY_SETMODE, ECE391_TTY_NONBLOCK) < 0) {
+        ece391_fdputs(1, (uint8_t*)"ioctl failed\n");
+        return 3;
+    }
+
+    ece391_fdputs(1, (uint8_t*)"polling for keys, q quits\n");
+    c[1] = '\0';
+    for (;;) {
+        n = ece391_read(0, c, 1);
+        if (n < 0) {
+            ece391_fdputs(1, (uint8_t*)"read failed\n");
+            break;
+        }
+        if (!n) {
+            polls++;
+            continue;
+        }
+        ece391_fdputs(1, (uint8_t*)"key '");
+        ece391_fdputs(1, c[0] == '\n' ? (uint8_t*)"\\n" : c);
+        ece391_fdputs(1, (uint8_t*)"' after ");
+        put_num(polls);
+        ece391_fdputs(1, (uint8_t*)" empty reads\n");
+        polls = 0;
+        if (c[0] == QUIT_KEY)
+            break;
+    }
+
+    (void)ece391_ioctl(0, ECE391_TTY_SETMODE, mode);
+    return 0;
+}
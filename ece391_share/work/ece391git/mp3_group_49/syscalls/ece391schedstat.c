@@ -0,0 +1,73 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define MAX_PID     6
+#define NUMBUFSIZE  12
+#define COLWIDTH    10
+
+/* cycles are printed in units of 2^20 */
+#define MCYC_SHIFT  20
+
+/* print v right aligned in a column */
+static void put_col (uint32_t v)
+{
+    uint8_t buf[NUMBUFSIZE];
+    uint32_t len;
+
+    ece391_itoa(v, buf, 10);
+    for (len = ece391_strlen(buf); len < COLWIDTH; len++)
+        ece391_fdputs(1, (uint8_t*)" ");
+    ece391_fdputs(1, buf);
+}
+
+/* print the non-empty buckets of one histogram */
+static void put_hist (const uint8_t* name, const uint32_t* hist)
+{
+    uint8_t buf[NUMBUFSIZE];
+    int32_t i;
+
+    ece391_fdputs(1, (uint8_t*)name);
+    ece391_fdputs(1, (uint8_t*)" latency (cycles >= 2^n: count)\n");
+    for (i = 0; i < ECE391_HIST_BUCKETS; i++) {
+        if (!hist[i])
+            continue;
+        ece391_fdputs(1, (uint8_t*)"  2^");
+        ece391_itoa(i, buf, 10);
+        ece391_fdputs(1, buf);
+        ece391_fdputs(1, (uint8_t*)": ");
+        ece391_itoa(hist[i], buf, 10);
+        ece391_fdputs(1, buf);
+        ece391_fdputs(1, (uint8_t*)"\n");
+    }
+}
+
+int main ()
+{
+    ece391_task_stats_t stats;
+    ece391_sched_hist_t hist;
+    int32_t pid;
+
+    ece391_fdputs(1, (uint8_t*)"       pid user Mcyc kern Mcyc wait Mcyc  switches    misses\n");
+    for (pid = 0; pid <= MAX_PID; pid++) {
+        if (-1 == ece391_taskstat(pid, &stats))
+            continue;
+        put_col(pid);
+        put_col((uint32_t)(stats.user_cycles >> MCYC_SHIFT));
+        put_col((uint32_t)(stats.kernel_cycles >> MCYC_SHIFT));
+        put_col((uint32_t)(stats.wait_cycles >> MCYC_SHIFT));
+        put_col(stats.nr_switches);
+        put_col(stats.deadline_misses);
+        ece391_fdputs(1, (uint8_t*)"\n");
+    }
+
+    if (-1 == ece391_schedstat(&hist)) {
+        ece391_fdputs(1, (uint8_t*)"schedstat failed\n");
+        return 3;
+    }
+    put_hist((uint8_t*)"wakeup", hist.wakeup);
+    put_hist((uint8_t*)"preempt", hist.preempt);
+
+    return 0;
+}
@@ -5,13 +5,126 @@
 
 #define BUFSIZE 1024
 
+/* where the shell parks its own stdin/stdout while redirecting */
+#define SAVED_STDIN  6
+#define SAVED_STDOUT 7
+
+/* drop leading and trailing spaces of a command */
+static uint8_t*
+trim (uint8_t* cmd)
+{
+    int32_t len;
+
+    while (' ' == *cmd)
+        cmd++;
+    len = ece391_strlen (cmd);
+    while (len > 0 && ' ' == cmd[len - 1])
+        cmd[--len] = '\0';
+    return cmd;
+}
+
+/* index of the first '|' in cmd, -1 if there is none */
+static int32_t
+find_bar (const uint8_t* cmd)
+{
+    int32_t i;
+
+    for (i = 0; '\0' != cmd[i]; i++) {
+        if ('|' == cmd[i])
+	    return i;
+    }
+    return -1;
+}
+
+/* there are never more stages than process slots */
+#define MAX_STAGES 6
+
+/*
+ * Spawn every stage of "a | b | c".  Each stage's stdout goes into a
+ * fresh pipe whose read end becomes the next stage's stdin.  The pids
+ * of the stages that did start are left in pids[0..*n-1].
+ */
+static int32_t
+spawn_pipeline (uint8_t* cmd, int32_t* pids, int32_t* n)
+{
+    int32_t bar;
+    int32_t fds[2];
+    int32_t in = -1;
+    int32_t rval = 0;
+
+    ece391_dup2 (0, SAVED_STDIN);
+    ece391_dup2 (1, SAVED_STDOUT);
+
+    for (*n = 0; *n < MAX_STAGES; (*n)++) {
+        if (-1 != (bar = find_bar (cmd))) {
+	    cmd[bar] = '\0';
+	    if (-1 == ece391_pipe (fds)) {
+	        rval = -1;
+		break;
+	    }
+	    ece391_dup2 (fds[1], 1);
+	    ece391_close (fds[1]);
+	}
+	if (-1 != in) {
+	    ece391_dup2 (in, 0);
+	    ece391_close (in);
+	    in = -1;
+	}
+	pids[*n] = ece391_spawn (trim (cmd));
+	ece391_dup2 (SAVED_STDIN, 0);
+	ece391_dup2 (SAVED_STDOUT, 1);
+	if (-1 != bar)
+	    in = fds[0];
+	if (-1 == pids[*n]) {
+	    rval = -1;
+	    break;
+	}
+	if (-1 == bar) {
+	    (*n)++;
+	    break;
+	}
+	cmd += bar + 1;
+    }
+
+    if (-1 != in)
+        ece391_close (in);
+    ece391_close (SAVED_STDIN);
+    ece391_close (SAVED_STDOUT);
+    return rval;
+}
+
+/* print "[pid] msg" */
+static void
+print_job (int32_t pid, const char* msg)
+{
+    uint8_t num[12];
+
+    ece391_fdputs (1, (uint8_t*)"[");
+    ece391_fdputs (1, ece391_itoa (pid, num, 10));
+    ece391_fdputs (1, (uint8_t*)"] ");
+    ece391_fdputs (1, (uint8_t*)msg);
+}
+
+/* report background jobs that have finished since the last prompt */
+static void
+reap_jobs ()
+{
+    int32_t pid, status;
+
+    while (0 < (pid = ece391_waitpid (-1, &status, WNOHANG)))
+        print_job (pid, "done\n");
+}
+
 int main ()
 {
-    int32_t cnt, rval;
+    int32_t cnt, rval, background, n, i, status;
+    int32_t pids[MAX_STAGES];
     uint8_t buf[BUFSIZE];
+    uint8_t* cmd;
     ece391_fdputs (1, (uint8_t*)"Starting 391 Shell\n");
 
     while (1) {
+        reap_jobs ();
         ece391_fdputs (1, (uint8_t*)"391OS> ");
 	if (-1 == (cnt = ece391_read (0, buf, BUFSIZE-1))) {
 	    ece391_fdputs (1, (uint8_t*)"read from keyboard failed\n");
@@ -22,9 +135,34 @@ int main ()
 	buf[cnt] = '\0';
 	if (0 == ece391_strcmp (buf, (uint8_t*)"exit"))
 	    return 0;
-	if ('\0' == buf[0])
+
+	/* a trailing '&' runs the command without waiting for it */
+	cmd = trim (buf);
+	cnt = ece391_strlen (cmd);
+	background = (cnt > 0 && '&' == cmd[cnt - 1]);
+	if (background) {
+	    cmd[cnt - 1] = '\0';
+	    cmd = trim (cmd);
+	}
+
+	if ('\0' == cmd[0])
 	    continue;
-	rval = ece391_execute (buf);
+	if (!background && -1 == find_bar (cmd)) {
+	    rval = ece391_execute (cmd);
+	} else {
+	    rval = spawn_pipeline (cmd, pids, &n);
+	    if (background) {
+	        if (n > 0)
+		    print_job (pids[n - 1], "started\n");
+	    } else {
+	        /* the pipeline's status is that of its last stage */
+	        for (i = 0; i < n; i++) {
+		    ece391_waitpid (pids[i], &status, 0);
+		    if (-1 != rval)
+		        rval = status;
+		}
+	    }
+	}
 	if (-1 == rval)
 	    ece391_fdputs (1, (uint8_t*)"no such command\n");
 	else if (256 == rval)
@@ -33,4 +171,3 @@ int main ()
 	    ece391_fdputs (1, (uint8_t*)"program terminated abnormally\n");
     }
 }
-
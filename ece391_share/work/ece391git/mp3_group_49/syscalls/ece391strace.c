@@ -0,0 +1,145 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+#include "ece391sysnum.h"
+
+#define BUFSIZE 1024
+#define BATCH 16
+#define NUMBUFSIZE 12
+#define COLWIDTH 10
+#define NAMEWIDTH 12
+
+static const char* names[ECE391_STRACE_NR_CALLS] = {
+    "?", "halt", "execute", "read", "write", "open", "close", "getargs",
+    "vidmap", "set_handler", "sigreturn", "nanosleep", "pipe", "dup2",
+    "spawn", "waitpid", "taskstat", "schedstat", "set_periodic", "getpid",
+    "multicall", "strace", "irqstat", "clock_gettime", "kbd_read",
+    "profile", "ioctl", "vgamap"
+};
+
+static void put_num (uint32_t v, int32_t radix)
+{
+    uint8_t buf[NUMBUFSIZE];
+
+    ece391_itoa(v, buf, radix);
+    ece391_fdputs(1, buf);
+}
+
+/* print v right aligned in a column */
+static void put_col (uint32_t v)
+{
+    uint8_t buf[NUMBUFSIZE];
+    uint32_t len;
+
+    ece391_itoa(v, buf, 10);
+    for (len = ece391_strlen(buf); len < COLWIDTH; len++)
+        ece391_fdputs(1, (uint8_t*)" ");
+    ece391_fdputs(1, buf);
+}
+
+static const uint8_t* name_of (uint32_t number)
+{
+    if (number >= ECE391_STRACE_NR_CALLS || !names[number])
+        return (uint8_t*)"?";
+    return (uint8_t*)names[number];
+}
+
+/* print a syscall name padded to NAMEWIDTH */
+static void put_name (const uint8_t* name)
+{
+    uint32_t len;
+
+    ece391_fdputs(1, name);
+    for (len = ece391_strlen(name); len < NAMEWIDTH; len++)
+        ece391_fdputs(1, (uint8_t*)" ");
+}
+
+/* [pid] name(0xa, 0xb, 0xc) = ret <cycles> */
+static void put_rec (const ece391_strace_rec_t* rec)
+{
+    int32_t i;
+
+    ece391_fdputs(1, (uint8_t*)"[");
+    put_num(rec->pid, 10);
+    ece391_fdputs(1, (uint8_t*)"] ");
+    ece391_fdputs(1, name_of(rec->number));
+    for (i = 0; i < 3; i++) {
+        ece391_fdputs(1, (uint8_t*)(i ? ", 0x" : "(0x"));
+        put_num(rec->args[i], 16);
+    }
+    ece391_fdputs(1, (uint8_t*)") = ");
+    if (rec->ret < 0) {
+        ece391_fdputs(1, (uint8_t*)"-");
+        put_num(-rec->ret, 10);
+    } else {
+        put_num(rec->ret, 10);
+    }
+    ece391_fdputs(1, (uint8_t*)" <");
+    put_num((uint32_t)(rec->tsc_exit - rec->tsc_enter), 10);
+    ece391_fdputs(1, (uint8_t*)">\n");
+}
+
+/* average without 64 bit division, which has no library here */
+static uint32_t average (uint64_t cycles, uint32_t count)
+{
+    while (cycles >> 32) {
+        cycles >>= 1;
+        count >>= 1;
+    }
+    return count ? (uint32_t)cycles / count : 0;
+}
+
+static void put_stats (void)
+{
+    ece391_strace_stat_t stats[ECE391_STRACE_NR_CALLS];
+    int32_t i;
+
+    if (-1 == ece391_strace(STRACE_STATS, stats, 0))
+        return;
+
+    ece391_fdputs(1, (uint8_t*)"syscall          calls    errors   avg cyc   max cyc\n");
+    for (i = 0; i < ECE391_STRACE_NR_CALLS; i++) {
+        if (!stats[i].count)
+            continue;
+        put_name(name_of(i));
+        put_col(stats[i].count);
+        put_col(stats[i].errors);
+        put_col(average(stats[i].cycles, stats[i].count));
+        put_col(stats[i].max_cycles);
+        ece391_fdputs(1, (uint8_t*)"\n");
+    }
+}
+
+int main ()
+{
+    uint8_t cmd[BUFSIZE];
+    ece391_strace_rec_t recs[BATCH];
+    int32_t self, pid, status, n, i;
+
+    if (0 != ece391_getargs (cmd, BUFSIZE)) {
+        ece391_fdputs (1, (uint8_t*)"usage: strace <command>\n");
+        return 3;
+    }
+
+    self = ece391_getpid();
+    ece391_strace(STRACE_ON, 0, 0);
+    if (-1 == (pid = ece391_spawn(cmd))) {
+        ece391_strace(STRACE_OFF, 0, 0);
+        ece391_fdputs (1, (uint8_t*)"no such command\n");
+        return 2;
+    }
+    ece391_waitpid(pid, &status, 0);
+    ece391_strace(STRACE_OFF, 0, 0);
+
+    /* everything but our own calls, so children of the command show up too */
+    while (0 < (n = ece391_strace(STRACE_READ, recs, BATCH))) {
+        for (i = 0; i < n; i++) {
+            if (recs[i].pid != self)
+                put_rec(&recs[i]);
+        }
+    }
+
+    put_stats();
+    return 0;
+}
@@ -2,6 +2,7 @@
 
 #include "ece391support.h"
 #include "ece391syscall.h"
+#include "ece391sysnum.h"
 
 uint32_t ece391_strlen(const uint8_t* s)
 {
@@ -80,6 +81,70 @@ uint8_t* ece391_itoa(uint32_t value, uint8_t* buf, int32_t radix)
         return ece391_strrev(buf);
 }
 
+/* Sleep for at least ms milliseconds */
+int32_t ece391_msleep(uint32_t ms)
+{
+    ece391_timespec_t req;
+
+    req.tv_sec = ms / 1000;
+    req.tv_nsec = (ms % 1000) * 1000000;
+    return ece391_nanosleep (&req, 0);
+}
+
+/* Copy the time page, retrying if the timer interrupt updated it meanwhile */
+void ece391_time_read(ece391_time_page_t* snap)
+{
+    volatile ece391_time_page_t* page = (volatile ece391_time_page_t*)ECE391_TIME_PAGE;
+    uint32_t seq;
+
+    do {
+        while ((seq = page->seq) & 1);
+        snap->hz = page->hz;
+        snap->jiffies = page->jiffies;
+        snap->tsc_khz = page->tsc_khz;
+        snap->tsc_stamp = page->tsc_stamp;
+        snap->wall_sec = page->wall_sec;
+    } while (seq != page->seq);
+
+    snap->seq = seq;
+}
+
+/* Milliseconds since boot, with tick resolution */
+uint32_t ece391_uptime_ms(void)
+{
+    ece391_time_page_t snap;
+
+    ece391_time_read (&snap);
+    return (snap.jiffies / snap.hz) * 1000 + (snap.jiffies % snap.hz) * 1000 / snap.hz;
+}
+
+/* Fill in one multicall entry */
+void ece391_mc_set(ece391_multicall_t* mc, uint32_t number,
+                   uint32_t arg0, uint32_t arg1, uint32_t arg2)
+{
+    mc->number = number;
+    mc->args[0] = arg0;
+    mc->args[1] = arg1;
+    mc->args[2] = arg2;
+    mc->result = -1;
+}
+
+void ece391_mc_read(ece391_multicall_t* mc, int32_t fd, void* buf, int32_t nbytes)
+{
+    ece391_mc_set (mc, SYS_READ, fd, (uint32_t)buf, nbytes);
+}
+
+void ece391_mc_write(ece391_multicall_t* mc, int32_t fd, const void* buf, int32_t nbytes)
+{
+    ece391_mc_set (mc, SYS_WRITE, fd, (uint32_t)buf, nbytes);
+}
+
+/* Batched ece391_fdputs; s has to stay put until the batch has run */
+void ece391_mc_fdputs(ece391_multicall_t* mc, int32_t fd, const uint8_t* s)
+{
+    ece391_mc_write (mc, fd, s, ece391_strlen(s));
+}
+
 /* In-place string reversal */
 uint8_t* ece391_strrev(uint8_t* s)
 {
@@ -8,6 +8,20 @@ extern int32_t ece391_strcmp(const uint8_t* s1, const uint8_t* s2);
 extern int32_t ece391_strncmp(const uint8_t* s1, const uint8_t* s2, uint32_t n);
 extern uint8_t *ece391_itoa(uint32_t value, uint8_t* buf, int32_t radix);
 extern uint8_t *ece391_strrev(uint8_t* s);
+extern int32_t ece391_msleep(uint32_t ms);
+
+/* consistent copy of the kernel time page, no syscall involved */
+struct ece391_time_page;
+extern void ece391_time_read(struct ece391_time_page* snap);
+extern uint32_t ece391_uptime_ms(void);
+
+/* fill in entries of an ece391_multicall batch */
+struct ece391_multicall;
+extern void ece391_mc_set(struct ece391_multicall* mc, uint32_t number,
+                          uint32_t arg0, uint32_t arg1, uint32_t arg2);
+extern void ece391_mc_read(struct ece391_multicall* mc, int32_t fd, void* buf, int32_t nbytes);
+extern void ece391_mc_write(struct ece391_multicall* mc, int32_t fd, const void* buf, int32_t nbytes);
+extern void ece391_mc_fdputs(struct ece391_multicall* mc, int32_t fd, const uint8_t* s);
 
 #endif /* ECE391SUPPORT_H */
 
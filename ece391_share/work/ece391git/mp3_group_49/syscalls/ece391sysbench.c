@@ -0,0 +1,54 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define ITERATIONS 10000
+#define NUMBUFSIZE 12
+
+/* low half of the time-stamp counter, plenty for one run */
+static uint32_t rdtsc_low (void)
+{
+    uint32_t low, high;
+
+    asm volatile ("rdtsc" : "=a"(low), "=d"(high));
+    return low;
+}
+
+/* time ITERATIONS null syscalls and print the average and best */
+static void bench (const uint8_t* name, int32_t (*call)(void))
+{
+    uint8_t buf[NUMBUFSIZE];
+    uint32_t start, one, best = 0xFFFFFFFF, total = 0;
+    int32_t i;
+
+    for (i = 0; i < ITERATIONS; i++) {
+        start = rdtsc_low();
+        call();
+        one = rdtsc_low() - start;
+        total += one;
+        if (one < best)
+            best = one;
+    }
+
+    ece391_fdputs(1, (uint8_t*)name);
+    ece391_fdputs(1, (uint8_t*)": avg ");
+    ece391_itoa(total / ITERATIONS, buf, 10);
+    ece391_fdputs(1, buf);
+    ece391_fdputs(1, (uint8_t*)" cycles, best ");
+    ece391_itoa(best, buf, 10);
+    ece391_fdputs(1, buf);
+    ece391_fdputs(1, (uint8_t*)"\n");
+}
+
+int main ()
+{
+    /* warm up the caches and TLB for both paths */
+    ece391_getpid_int80();
+    ece391_getpid();
+
+    bench((uint8_t*)"int 0x80", ece391_getpid_int80);
+    bench((uint8_t*)"sysenter", ece391_getpid);
+
+    return 0;
+}
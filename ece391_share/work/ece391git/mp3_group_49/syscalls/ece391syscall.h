@@ -5,6 +5,149 @@
 
 /* All calls return >= 0 on success or -1 on failure. */
 
+/* interval for ece391_nanosleep, or a time from ece391_clock_gettime */
+typedef struct ece391_timespec {
+    uint32_t tv_sec;
+    uint32_t tv_nsec;
+} ece391_timespec_t;
+
+/* clocks for ece391_clock_gettime */
+#define ECE391_CLOCK_REALTIME   0       /* seconds since 1970 */
+#define ECE391_CLOCK_MONOTONIC  1       /* time since boot */
+
+/* cpu time of one task in tsc cycles, filled in by ece391_taskstat */
+typedef struct ece391_task_stats {
+    uint64_t user_cycles;
+    uint64_t kernel_cycles;     /* idle time for pid 0 */
+    uint64_t wait_cycles;       /* runnable but not running */
+    uint32_t nr_switches;
+    uint32_t deadline_misses;   /* see ece391_set_periodic */
+} ece391_task_stats_t;
+
+/* bucket i counts latencies of [2^i, 2^(i+1)) cycles */
+#define ECE391_HIST_BUCKETS 32
+
+/* one entry of an ece391_multicall batch, see ece391_mc_* in ece391support.h */
+typedef struct ece391_multicall {
+    uint32_t number;            /* SYS_* from ece391sysnum.h */
+    uint32_t args[3];
+    int32_t result;             /* what the call returned */
+} ece391_multicall_t;
+
+/* most entries one ece391_multicall takes */
+#define ECE391_MULTICALL_MAX 64
+
+/*
+ * Read-only page the kernel keeps current on every timer tick, mapped
+ * into every program.  Read it through ece391_time_read, which retries
+ * while the kernel is in the middle of an update.
+ */
+#define ECE391_TIME_PAGE 0x8401000
+
+typedef struct ece391_time_page {
+    uint32_t seq;               /* odd while the kernel is writing */
+    uint32_t hz;                /* ticks per second */
+    uint32_t jiffies;           /* ticks since boot */
+    uint32_t tsc_khz;           /* TSC cycles per ms, 0 if unknown */
+    uint64_t tsc_stamp;         /* TSC at the last tick */
+    uint32_t wall_sec;          /* seconds since 1970 at boot */
+} ece391_time_page_t;
+
+/* ece391_strace commands */
+#define STRACE_OFF      0       /* stop tracing */
+#define STRACE_ON       1       /* forget earlier records and counters, start */
+#define STRACE_READ     2       /* take up to count records, returns how many */
+#define STRACE_STATS    3       /* copy ECE391_STRACE_NR_CALLS counters */
+
+/* counters are indexed by syscall number */
+#define ECE391_STRACE_NR_CALLS 32
+
+/* one traced call */
+typedef struct ece391_strace_rec {
+    uint32_t seq;
+    int32_t pid;
+    uint32_t number;
+    uint32_t args[3];
+    int32_t ret;
+    uint64_t tsc_enter;
+    uint64_t tsc_exit;
+} ece391_strace_rec_t;
+
+/* totals of one syscall number while tracing was on */
+typedef struct ece391_strace_stat {
+    uint64_t cycles;
+    uint32_t count;
+    uint32_t errors;
+    uint32_t max_cycles;
+} ece391_strace_stat_t;
+
+/* ece391_profile commands */
+#define PROFILE_OFF     0       /* stop sampling */
+#define PROFILE_ON      1       /* forget earlier samples, start */
+#define PROFILE_READ    2       /* take up to count samples, returns how many */
+#define PROFILE_DROPPED 3       /* returns ticks missed with the buffer full */
+
+/* where one timer tick found the cpu */
+typedef struct ece391_profile_sample {
+    uint32_t eip;
+    uint16_t pid;
+    uint16_t user;              /* 1 if it was in user mode */
+} ece391_profile_sample_t;
+
+/* ece391_kbd_read flags */
+#define ECE391_KBD_NONBLOCK 1
+
+/* ece391_ioctl requests on the terminal (stdin or stdout) */
+#define ECE391_TTY_GETMODE  1       /* returns the mode bits */
+#define ECE391_TTY_SETMODE  2       /* arg is the new mode bits */
+
+/* terminal mode bits, the shell starts out with CANON | ECHO */
+#define ECE391_TTY_CANON    0x1     /* line editing, read returns whole lines */
+#define ECE391_TTY_ECHO     0x2     /* show keys as they are read */
+#define ECE391_TTY_NONBLOCK 0x4     /* read returns 0 instead of waiting */
+
+/* ece391_ioctl requests on "vga", which switches to mode X while open */
+#define ECE391_VGA_SET_PLANES 1     /* arg is the mask of planes written */
+#define ECE391_VGA_FLIP     2       /* arg is the offset of the page to show */
+#define ECE391_VGA_SET_COLOR 3      /* arg is index << 24 | r << 16 | g << 8 | b */
+
+/* mode X is 320x200, each page takes this much of every plane */
+#define ECE391_MODEX_PAGE_SIZE (320 / 4 * 200)
+
+/* ece391_key_event_t flags */
+#define ECE391_KEY_LSHIFT   0x01
+#define ECE391_KEY_RSHIFT   0x02
+#define ECE391_KEY_LCTRL    0x04
+#define ECE391_KEY_CAPS     0x08
+#define ECE391_KEY_RELEASE  0x10
+#define ECE391_KEY_EXTENDED 0x20
+
+/* one key going down or up */
+typedef struct ece391_key_event {
+    uint64_t tsc;               /* when the scancode arrived */
+    uint8_t scancode;           /* scan set 1 make code */
+    int8_t ascii;               /* character typed, 0 if none */
+    uint16_t flags;             /* ECE391_KEY_* */
+} ece391_key_event_t;
+
+/* lines of the two PICs and the APIC timer, ece391_irqstat fills in one entry each */
+#define ECE391_NR_IRQS 17
+
+/* how often one IRQ line fired and how long its handlers took */
+typedef struct ece391_irq_stat {
+    uint64_t cycles;
+    uint32_t count;
+    uint32_t max_cycles;
+    uint32_t spurious;
+    uint32_t unhandled;
+} ece391_irq_stat_t;
+
+/* run queue latency histograms, filled in by ece391_schedstat */
+typedef struct ece391_sched_hist {
+    uint32_t wakeup[ECE391_HIST_BUCKETS];
+    uint32_t preempt[ECE391_HIST_BUCKETS];
+} ece391_sched_hist_t;
+
 /*  
  * Note that the system call for halt will have to make sure that only
  * the low byte of EBX (the status argument) is returned to the calling
@@ -21,6 +164,52 @@ extern int32_t ece391_getargs (uint8_t* buf, int32_t nbytes);
 extern int32_t ece391_vidmap (uint8_t** screen_start);
 extern int32_t ece391_set_handler (int32_t signum, void* handler);
 extern int32_t ece391_sigreturn (void);
+extern int32_t ece391_nanosleep (const ece391_timespec_t* req, ece391_timespec_t* rem);
+extern int32_t ece391_pipe (int32_t fds[2]);
+extern int32_t ece391_dup2 (int32_t oldfd, int32_t newfd);
+/* like execute, but returns the new pid right away instead of waiting */
+extern int32_t ece391_spawn (const uint8_t* command);
+/*
+ * Collect a halted child (pid -1 for any); status gets its exit value.
+ * Returns the child's pid, or 0 under WNOHANG if none has halted yet.
+ */
+extern int32_t ece391_waitpid (int32_t pid, int32_t* status, int32_t options);
+/* pid 0 is the idle task; -1 if pid is not in use */
+extern int32_t ece391_taskstat (int32_t pid, ece391_task_stats_t* stats);
+extern int32_t ece391_schedstat (ece391_sched_hist_t* hist);
+/*
+ * Run ahead of ordinary tasks, earliest deadline first, for up to budget
+ * ms of every period ms; period 0 goes back to round robin.  A job ends
+ * when the caller blocks, one still running at the end of its period is
+ * a deadline miss.  Fails if all periodic tasks would need over 100%.
+ */
+extern int32_t ece391_set_periodic (uint32_t period, uint32_t budget);
+extern int32_t ece391_getpid (void);
+/* ece391_getpid through int 0x80 instead of sysenter */
+extern int32_t ece391_getpid_int80 (void);
+/*
+ * Run count calls in one kernel entry, in order, filling in each result.
+ * Stops at the first one that fails and returns how many succeeded.
+ */
+extern int32_t ece391_multicall (ece391_multicall_t* calls, int32_t count);
+/* trace the syscalls of every process, see STRACE_* */
+extern int32_t ece391_strace (int32_t cmd, void* buf, int32_t count);
+extern int32_t ece391_irqstat (ece391_irq_stat_t* stats);
+/* nanosecond resolution, from the TSC */
+extern int32_t ece391_clock_gettime (int32_t clock, ece391_timespec_t* ts);
+/*
+ * Take up to count key events, oldest first, waiting for at least one
+ * unless ECE391_KBD_NONBLOCK.  Events taken here never reach the terminal.
+ */
+extern int32_t ece391_kbd_read (ece391_key_event_t* events, int32_t count, int32_t flags);
+/* sample every process on each timer tick, see PROFILE_* */
+extern int32_t ece391_profile (int32_t cmd, void* buf, int32_t count);
+/* device specific requests, e.g. ECE391_TTY_SETMODE on the terminal */
+extern int32_t ece391_ioctl (int32_t fd, uint32_t cmd, uint32_t arg);
+/* map the 64 KB mode X window, "vga" has to be open */
+extern int32_t ece391_vgamap (uint8_t** screen_start);
+
+#define WNOHANG 1
 
 enum signums {
 	DIV_ZERO = 0,
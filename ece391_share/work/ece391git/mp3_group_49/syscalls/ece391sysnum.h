@@ -11,5 +11,22 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_NANOSLEEP  11
+#define SYS_PIPE       12
+#define SYS_DUP2       13
+#define SYS_SPAWN      14
+#define SYS_WAITPID    15
+#define SYS_TASKSTAT   16
+#define SYS_SCHEDSTAT  17
+#define SYS_SET_PERIODIC 18
+#define SYS_GETPID     19
+#define SYS_MULTICALL  20
+#define SYS_STRACE     21
+#define SYS_IRQSTAT    22
+#define SYS_CLOCK_GETTIME 23
+#define SYS_KBD_READ   24
+#define SYS_PROFILE    25
+#define SYS_IOCTL      26
+#define SYS_VGAMAP     27
 
 #endif /* ECE391SYSNUM_H */